@@ -0,0 +1,56 @@
+#!/bin/bash
+DISABLE_RTTI_EXCEPTIONS="-fno-exceptions -fno-rtti -O2"
+DISABLED_WARNINGS="-Wno-write-strings -Wno-sign-compare -Wno-writable-strings -Wno-missing-braces -Wno-unused-function -Wno-format -Wno-switch -Wno-char-subscripts"
+
+INCLUDE_DIR="-I src -I src/irlibs"
+
+#./bench.sh avx2 builds every benchmark with the 32 byte scans and the AVX2 UTF-8 validation and
+#checks that an AVX2 and an SSE2 build of mc print the same AST, the default build uses SSE2
+SIMD_FLAGS=""
+if [ "$1" == "avx2" ]; then
+    SIMD_FLAGS="-mavx2"
+fi
+
+mkdir -p bench/bin
+
+clang++ bench/bench_keywords.cpp -o bench/bin/bench_keywords -g -Wall $SIMD_FLAGS $INCLUDE_DIR $DISABLE_RTTI_EXCEPTIONS $DISABLED_WARNINGS
+
+echo "KEYWORDS"
+./bench/bin/bench_keywords
+
+clang++ bench/bench_bucket_array.cpp -o bench/bin/bench_bucket_array -g -Wall $SIMD_FLAGS $INCLUDE_DIR $DISABLE_RTTI_EXCEPTIONS $DISABLED_WARNINGS
+
+echo "BUCKET ARRAY"
+./bench/bin/bench_bucket_array
+
+clang++ bench/bench_tokenize_parallel.cpp -o bench/bin/bench_tokenize_parallel -g -Wall -pthread $SIMD_FLAGS $INCLUDE_DIR $DISABLE_RTTI_EXCEPTIONS $DISABLED_WARNINGS
+
+echo "TOKENIZE PARALLEL"
+./bench/bin/bench_tokenize_parallel
+
+clang++ bench/bench_retokenize.cpp -o bench/bin/bench_retokenize -g -Wall $SIMD_FLAGS $INCLUDE_DIR $DISABLE_RTTI_EXCEPTIONS $DISABLED_WARNINGS
+
+echo "RETOKENIZE"
+./bench/bin/bench_retokenize
+
+clang++ bench/bench_frontend.cpp -o bench/bin/bench_frontend -g -Wall -pthread $SIMD_FLAGS $INCLUDE_DIR $DISABLE_RTTI_EXCEPTIONS $DISABLED_WARNINGS
+
+echo "FRONTEND"
+./bench/bin/bench_frontend commit=$(git rev-parse --short HEAD 2>/dev/null) json=bench/bin/frontend.json
+
+if [ -n "$SIMD_FLAGS" ]; then
+    echo "SSE2 vs AVX2"
+    clang++ src/main.cpp -o bench/bin/mc_sse2 -pthread $INCLUDE_DIR $DISABLE_RTTI_EXCEPTIONS $DISABLED_WARNINGS
+    clang++ src/main.cpp -o bench/bin/mc_avx2 -pthread $SIMD_FLAGS $INCLUDE_DIR $DISABLE_RTTI_EXCEPTIONS $DISABLED_WARNINGS
+    ./bench/bin/bench_frontend size=1 runs=1 json=/dev/null emit=bench/bin/simd_ascii.m > /dev/null
+    #Unicode identifiers, so the UTF-8 validation leaves its ASCII path
+    sed 's/fun/fün/g' bench/bin/simd_ascii.m > bench/bin/simd.m
+    ./bench/bin/mc_sse2 bench/bin/simd.m > bench/bin/simd_sse2.txt 2>&1
+    ./bench/bin/mc_avx2 bench/bin/simd.m > bench/bin/simd_avx2.txt 2>&1
+    if cmp -s bench/bin/simd_sse2.txt bench/bin/simd_avx2.txt; then
+        echo "same AST from both builds"
+    else
+        echo "AVX2 and SSE2 builds print different ASTs!"
+        exit 1
+    fi
+fi
@@ -0,0 +1,159 @@
+/*
+   Microbenchmark for Bucket_Array: pushing, BA_GET in order and at random and the
+   bucket wise iteration, for the old layout of the AST (fixed buckets of 2), fixed
+   buckets of 64 and geometric buckets starting at 16.
+   The / and % split ba_get_helper did before power of two buckets is timed as a reference.
+   Build and run with ./bench.sh
+*/
+#include "ir_assert.h"
+#include "tokens.h"
+
+#include <time.h>
+
+static
+f64 bench_now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+static
+f64 bench_min_time(f64 best, f64 seconds)
+{
+    return (best == 0 || seconds < best) ? seconds : best;
+}
+
+//Same size as Variable
+struct Bench_Element
+{
+    u64 value;
+    u64 pad[4];
+};
+
+//NOTE(Michael): ba_get_helper before power of two buckets, only valid for fixed buckets
+static
+Bench_Element* ba_get_div_mod(Bench_Element* ba, msi index)
+{
+    Bucket_Array_Header* header = ba_header(ba);
+    msi bucket_index = index / header->bucket_size;
+    msi in_bucket_index = index % header->bucket_size;
+    return &((Bench_Element*)header->buckets[bucket_index])[in_bucket_index];
+}
+
+static
+void bench_layout(const c8* name, msi bucket_size, b8 geometric, msi count, u32* random_indices, Heap_Allocator* heap)
+{
+    Bench_Element* ba = nullptr;
+    f64 start = bench_now();
+    if(geometric)
+    {
+        BA_INIT_GEOMETRIC(ba, bucket_size, heap);
+    }
+    else
+    {
+        BA_INIT(ba, bucket_size, heap);
+    }
+    for(msi i = 0; i < count; ++i)
+    {
+        Bench_Element e = {};
+        e.value = i;
+        BA_PUSH(ba, e);
+    }
+    f64 push_time = bench_now() - start;
+
+    //Best of 5 rounds, the first one also pays for cold caches
+    u64 sum_get = 0;
+    u64 sum_random = 0;
+    u64 sum_iter = 0;
+    u64 sum_div_mod = 0;
+    f64 get_time = 0;
+    f64 random_time = 0;
+    f64 iter_time = 0;
+    f64 div_mod_time = 0;
+    for(u32 round = 0; round < 5; ++round)
+    {
+        sum_get = 0;
+        start = bench_now();
+        for(msi i = 0; i < count; ++i)
+        {
+            sum_get += BA_GET(ba, i)->value;
+        }
+        get_time = bench_min_time(get_time, bench_now() - start);
+
+        sum_random = 0;
+        start = bench_now();
+        for(msi i = 0; i < count; ++i)
+        {
+            sum_random += BA_GET(ba, random_indices[i])->value;
+        }
+        random_time = bench_min_time(random_time, bench_now() - start);
+
+        sum_iter = 0;
+        start = bench_now();
+        for(msi b = 0; b < BA_BUCKET_COUNT(ba); ++b)
+        {
+            msi in_bucket;
+            Bench_Element* elements = BA_BUCKET(ba, b, &in_bucket);
+            for(msi i = 0; i < in_bucket; ++i)
+            {
+                sum_iter += elements[i].value;
+            }
+        }
+        iter_time = bench_min_time(iter_time, bench_now() - start);
+
+        if(!geometric)
+        {
+            sum_div_mod = 0;
+            start = bench_now();
+            for(msi i = 0; i < count; ++i)
+            {
+                sum_div_mod += ba_get_div_mod(ba, random_indices[i])->value;
+            }
+            div_mod_time = bench_min_time(div_mod_time, bench_now() - start);
+        }
+    }
+
+    f64 m = (f64)count * 1e-6;
+    printf("%-14s push %7.1f  get %7.1f  random get %7.1f  bucket iteration %7.1f M/s  (%llu buckets)\n",
+           name, m / push_time, m / get_time, m / random_time, m / iter_time, (u64)BA_BUCKET_COUNT(ba));
+
+    if(!geometric)
+    {
+        printf("%-14s random get with / and %% %7.1f M/s\n", "", m / div_mod_time);
+        if(sum_div_mod != sum_random)
+        {
+            fprintf(stderr, "Checksum mismatch in %s!\n", name);
+        }
+    }
+
+    if(sum_get != sum_iter || sum_get != (u64)count * (count - 1) / 2)
+    {
+        fprintf(stderr, "Checksum mismatch in %s!\n", name);
+    }
+    BA_FREE(ba);
+}
+
+int main(s32 argc, c8** argv)
+{
+    msi count = argc > 1 ? strtoull(argv[1], nullptr, 10) : (1 << 22);
+
+    msi arena_size = IR_GIGABYTES(2);
+    Memory_Arena arena = create_memory_arena(arena_size, (u8*)malloc(arena_size));
+    Heap_Allocator heap = create_heap(&arena, IR_GIGABYTES(1), 6);
+
+    u32* random_indices = (u32*)malloc(count * sizeof(u32));
+    u32 seed = 1234567;
+    for(msi i = 0; i < count; ++i)
+    {
+        seed = seed * 1664525 + 1013904223;
+        random_indices[i] = (u32)(((u64)seed * count) >> 32);
+    }
+
+    printf("elements: %llu of %llu bytes\n", (u64)count, (u64)sizeof(Bench_Element));
+    bench_layout("fixed 2", 2, false, count, random_indices, &heap);
+    bench_layout("fixed 64", 64, false, count, random_indices, &heap);
+    bench_layout("geometric 16", 16, true, count, random_indices, &heap);
+
+    return 0;
+}
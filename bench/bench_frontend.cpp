@@ -0,0 +1,322 @@
+/*
+   Front-end throughput on a generated Mlang program, every phase timed on its own:
+   UTF-8 validation (MB/s), tokenize (MB/s, tokens/s), parse of the token stream
+   (nodes/s, heap bytes per node), parse_parallel of the same stream on `threads` threads
+   (nodes/s), parse_lazy of the same stream with only fun0 reachable (MB/s, since nearly
+   every body is skipped), typer (nodes/s), an ast_walk over every function body
+   (nodes/s), the streaming parse(file) main.cpp uses for small
+   files (MB/s, nodes/s) and writing and mapping the AST cache of the typed AST (MB/s of the
+   image, save also bytes per node and the size over the source, load also as speedup over
+   tokenize + parse + typer).
+   The best of `runs` is reported and written as JSON to track regressions across commits.
+
+   Usage: bench_frontend [key=value ...]
+       size=8 (MB)  globals=256  statements=16  depth=3  expr=8  seed=N  runs=3  threads=<cores>
+       json=bench/bin/frontend.json  commit=<id stored in the JSON>  emit=<file for the program>
+       cache=bench/bin/frontend.astc (AST cache image)
+   Build and run with ./bench.sh
+*/
+#include "ir_assert.h"
+#include "tokens.h"
+#include "tokenizer.h"
+#include "ast.h"
+#include "parser.h"
+#include "typer.h"
+#include "ir_file.h"
+#include "ast_cache.h"
+#include "mlang_generator.h"
+
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+
+static
+f64 bench_now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+struct Phase_Result
+{
+    const c8* name;
+    f64 seconds;
+};
+
+static
+void phase_update(Phase_Result* phase, f64 seconds)
+{
+    if(phase->seconds == 0 || seconds < phase->seconds)
+    {
+        phase->seconds = seconds;
+    }
+}
+
+//Bytes of all partitions the heap handed out
+static
+msi heap_used_bytes(Heap_Allocator* heap)
+{
+    msi result = 0;
+    for(Heap_Partition* p = heap->p_lists[heap->max_exp + 1 - heap->min_exp]; p; p = p->n)
+    {
+        result += (msi)1 << p->size_exp;
+    }
+    return result;
+}
+
+static
+b8 parse_arg(c8* arg, const c8* key, c8** value)
+{
+    msi length = strlen(key);
+    if(strncmp(arg, key, length) == 0 && arg[length] == '=')
+    {
+        *value = &arg[length + 1];
+        return true;
+    }
+    return false;
+}
+
+//Number of nodes in the subtree of function
+static
+u64 count_nodes(AST* ast, Node_Id function)
+{
+    u64 count = 0;
+    AST_Walk walk = ast_walk_begin(ast, function, AST_WALK_PRE);
+    while(ast_walk_next(&walk))
+    {
+        ++count;
+    }
+    ast_walk_end(&walk);
+    return count;
+}
+
+int main(s32 argc, c8** argv)
+{
+    Mlang_Shape shape = default_mlang_shape();
+    u32 runs = 3;
+    u32 threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const c8* json_path = "bench/bin/frontend.json";
+    const c8* commit = "";
+    const c8* emit_path = nullptr;
+    const c8* cache_path = "bench/bin/frontend.astc";
+
+    for(s32 i = 1; i < argc; ++i)
+    {
+        c8* value = nullptr;
+        if(parse_arg(argv[i], "size", &value))            shape.size = IR_MEGABYTES(atoll(value));
+        else if(parse_arg(argv[i], "globals", &value))     shape.globals = atoi(value);
+        else if(parse_arg(argv[i], "statements", &value))  shape.statements = atoi(value);
+        else if(parse_arg(argv[i], "depth", &value))       shape.depth = atoi(value);
+        else if(parse_arg(argv[i], "expr", &value))        shape.expr_length = u64_max(1, atoi(value));
+        else if(parse_arg(argv[i], "seed", &value))        shape.seed = strtoull(value, nullptr, 0);
+        else if(parse_arg(argv[i], "runs", &value))        runs = u64_max(1, atoi(value));
+        else if(parse_arg(argv[i], "threads", &value))     threads = u64_max(1, atoi(value));
+        else if(parse_arg(argv[i], "json", &value))        json_path = value;
+        else if(parse_arg(argv[i], "commit", &value))      commit = value;
+        else if(parse_arg(argv[i], "emit", &value))        emit_path = value;
+        else if(parse_arg(argv[i], "cache", &value))       cache_path = value;
+        else
+        {
+            fprintf(stderr, "Unknown argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+
+    //Program, heap and the heap's metadata, untouched pages are never committed
+    msi heap_size = IR_GIGABYTES(2);
+    msi arena_size = shape.size + shape.globals * 64 + heap_size + IR_MEGABYTES(128);
+    Memory_Arena arena = create_memory_arena(arena_size, (u8*)malloc(arena_size));
+    String file = generate_mlang(shape, &arena);
+    zero_buffer(IR_WRAP_INTO_BUFFER(&file.data[file.length], TOKENIZER_PADDING));
+
+    if(emit_path)
+    {
+        FILE* out = fopen(emit_path, "wb");
+        fwrite(file.data, file.length, 1, out);
+        fclose(out);
+    }
+
+    Phase_Result utf8_phase = {"utf8"};
+    Phase_Result tokenize_phase = {"tokenize"};
+    Phase_Result parse_phase = {"parse"};
+    Phase_Result parallel_phase = {"parse mt"};
+    Phase_Result lazy_phase = {"parse lazy"};
+    Phase_Result typer_phase = {"typer"};
+    Phase_Result walk_phase = {"walk"};
+    Phase_Result streaming_phase = {"lex+parse"};
+    Phase_Result cache_write_phase = {"cache save"};
+    Phase_Result cache_load_phase = {"cache load"};
+    msi token_count = 0;
+    msi node_count = 0;
+    u64 walked_count = 0;
+    msi ast_bytes = 0;
+    msi cache_bytes = 0;
+
+    //NOTE(Michael): Each run gets a fresh heap in the same part of the arena
+    u8* run_base = arena.current_base;
+    for(u32 run = 0; run < runs; ++run)
+    {
+        arena.current_base = run_base;
+        Heap_Allocator heap = create_heap(&arena, heap_size, 6);
+        Interner symbols = create_interner(&heap);
+
+        f64 begin = bench_now();
+        msi invalid_offset = 0;
+        if(!utf8_validate(file.data, file.length, &invalid_offset))
+        {
+            fprintf(stderr, "Generated program is not valid UTF-8 at %llu\n", invalid_offset);
+            return 1;
+        }
+        phase_update(&utf8_phase, bench_now() - begin);
+        
+        begin = bench_now();
+        Token_Stream tokens = tokenize(file, &symbols, &heap);
+        phase_update(&tokenize_phase, bench_now() - begin);
+        token_count = token_stream_len(&tokens);
+
+        msi used_before_parse = heap_used_bytes(&heap);
+        begin = bench_now();
+        AST ast = parse(&tokens, &heap);
+        phase_update(&parse_phase, bench_now() - begin);
+        node_count = ast_node_count(&ast);
+        ast_bytes = heap_used_bytes(&heap) - used_before_parse;
+        
+        begin = bench_now();
+        AST parallel_ast = parse_parallel(&tokens, &heap, threads);
+        phase_update(&parallel_phase, bench_now() - begin);
+        if(ast_node_count(&parallel_ast) != node_count)
+        {
+            fprintf(stderr, "parse_parallel made %llu nodes instead of %llu!\n", (u64)ast_node_count(&parallel_ast), (u64)node_count);
+            return 1;
+        }
+
+        //NOTE(Michael): The generator has no main, fun0 stands in for it
+        String lazy_root = wrap_asciiz((c8*)"fun0");
+        Parse_Skeleton skeleton = {};
+        begin = bench_now();
+        parse_lazy(&tokens, &heap, &lazy_root, 1, &skeleton);
+        phase_update(&lazy_phase, bench_now() - begin);
+        free_parse_skeleton(&skeleton);
+
+        begin = bench_now();
+        typer(&ast);
+        phase_update(&typer_phase, bench_now() - begin);
+
+        Interner stream_symbols = create_interner(&heap);
+        begin = bench_now();
+        parse(file, &stream_symbols, &heap);
+        phase_update(&streaming_phase, bench_now() - begin);
+
+        begin = bench_now();
+        if(!ast_cache_write(&ast, cache_path))
+        {
+            fprintf(stderr, "Could not write '%s'\n", cache_path);
+            return 1;
+        }
+        phase_update(&cache_write_phase, bench_now() - begin);
+
+        Interner cache_symbols = create_interner(&heap);
+        Mapped_File mapping = {};
+        AST cached_ast;
+        begin = bench_now();
+        if(!ast_cache_map(cache_path, file, &cache_symbols, &heap, &mapping, &cached_ast))
+        {
+            fprintf(stderr, "Could not load '%s'\n", cache_path);
+            return 1;
+        }
+        phase_update(&cache_load_phase, bench_now() - begin);
+        cache_bytes = mapping.content.length;
+        //NOTE(Michael): The typer added its casts to the nodes that were written
+        if(ast_node_count(&cached_ast) != ast_node_count(&ast))
+        {
+            fprintf(stderr, "The AST cache holds %llu nodes instead of %llu!\n", (u64)ast_node_count(&cached_ast), (u64)ast_node_count(&ast));
+            return 1;
+        }
+        unmap_file(&mapping);
+
+        //NOTE(Michael): After the cache phases, allocating the function list before them moves the nodes of the load
+        Node_Id* functions = nullptr;
+        ARR_INIT(functions, 1024, &heap);
+        for(Node_Id child = ast_first_child(&ast, ast.root); child; child = ast_next_sibling(&ast, child))
+        {
+            if(ast_node(&ast, child)->type == N_FUNCTION)
+            {
+                ARR_PUSH(functions, child);
+            }
+        }
+        walked_count = 0;
+        begin = bench_now();
+        for(msi f = 0; f < ARR_LEN(functions); ++f)
+        {
+            walked_count += count_nodes(&ast, functions[f]);
+        }
+        phase_update(&walk_phase, bench_now() - begin);
+        ARR_FREE(functions);
+    }
+
+    f64 mb = (f64)file.length / IR_MEGABYTES(1);
+    printf("%llu bytes, %llu tokens, %llu nodes, best of %u runs\n", file.length, token_count, node_count, runs);
+    printf("%-10s %8.3fs %8.1f MB/s\n", utf8_phase.name, utf8_phase.seconds, mb / utf8_phase.seconds);
+    printf("%-10s %8.3fs %8.1f MB/s %12.0f tokens/s\n", tokenize_phase.name, tokenize_phase.seconds,
+           mb / tokenize_phase.seconds, token_count / tokenize_phase.seconds);
+    printf("%-10s %8.3fs %12.0f nodes/s %8.1f bytes/node\n", parse_phase.name, parse_phase.seconds,
+           node_count / parse_phase.seconds, (f64)ast_bytes / node_count);
+    printf("%-10s %8.3fs %12.0f nodes/s %8u threads\n", parallel_phase.name, parallel_phase.seconds,
+           node_count / parallel_phase.seconds, threads);
+    printf("%-10s %8.3fs %8.1f MB/s\n", lazy_phase.name, lazy_phase.seconds, mb / lazy_phase.seconds);
+    printf("%-10s %8.3fs %12.0f nodes/s\n", typer_phase.name, typer_phase.seconds, node_count / typer_phase.seconds);
+    printf("%-10s %8.3fs %12.0f nodes/s\n", walk_phase.name, walk_phase.seconds, walked_count / walk_phase.seconds);
+    printf("%-10s %8.3fs %8.1f MB/s %12.0f nodes/s\n", streaming_phase.name, streaming_phase.seconds,
+           mb / streaming_phase.seconds, node_count / streaming_phase.seconds);
+    f64 cache_mb = (f64)cache_bytes / IR_MEGABYTES(1);
+    f64 front_seconds = tokenize_phase.seconds + parse_phase.seconds + typer_phase.seconds;
+    printf("%-10s %8.3fs %8.1f MB/s %8.1f bytes/node %5.1fx source\n", cache_write_phase.name, cache_write_phase.seconds,
+           cache_mb / cache_write_phase.seconds, (f64)cache_bytes / node_count, (f64)cache_bytes / file.length);
+    printf("%-10s %8.3fs %8.1f MB/s %8.1fx tokenize+parse+typer\n", cache_load_phase.name, cache_load_phase.seconds,
+           cache_mb / cache_load_phase.seconds, front_seconds / cache_load_phase.seconds);
+
+    FILE* json = fopen(json_path, "wb");
+    if(!json)
+    {
+        fprintf(stderr, "Could not write '%s'\n", json_path);
+        return 1;
+    }
+    fprintf(json,
+            "{\n"
+            "  \"commit\": \"%s\",\n"
+            "  \"shape\": {\"size\": %llu, \"globals\": %u, \"statements\": %u, \"depth\": %u, \"expr\": %u, \"seed\": %llu},\n"
+            "  \"runs\": %u,\n"
+            "  \"bytes\": %llu,\n"
+            "  \"tokens\": %llu,\n"
+            "  \"nodes\": %llu,\n"
+            "  \"phases\": {\n"
+            "    \"utf8\": {\"seconds\": %.6f, \"mb_per_s\": %.3f},\n"
+            "    \"tokenize\": {\"seconds\": %.6f, \"mb_per_s\": %.3f, \"tokens_per_s\": %.0f},\n"
+            "    \"parse\": {\"seconds\": %.6f, \"nodes_per_s\": %.0f, \"bytes_per_node\": %.1f},\n"
+            "    \"parse_parallel\": {\"seconds\": %.6f, \"nodes_per_s\": %.0f, \"threads\": %u},\n"
+            "    \"parse_lazy\": {\"seconds\": %.6f, \"mb_per_s\": %.3f},\n"
+            "    \"typer\": {\"seconds\": %.6f, \"nodes_per_s\": %.0f},\n"
+            "    \"walk\": {\"seconds\": %.6f, \"nodes_per_s\": %.0f},\n"
+            "    \"lex_parse\": {\"seconds\": %.6f, \"mb_per_s\": %.3f, \"nodes_per_s\": %.0f},\n"
+            "    \"cache_save\": {\"seconds\": %.6f, \"bytes\": %llu, \"bytes_per_node\": %.1f},\n"
+            "    \"cache_load\": {\"seconds\": %.6f, \"speedup\": %.1f}\n"
+            "  }\n"
+            "}\n",
+            commit, (u64)shape.size, shape.globals, shape.statements, shape.depth, shape.expr_length, shape.seed,
+            runs, (u64)file.length, (u64)token_count, (u64)node_count,
+            utf8_phase.seconds, mb / utf8_phase.seconds,
+            tokenize_phase.seconds, mb / tokenize_phase.seconds, token_count / tokenize_phase.seconds,
+            parse_phase.seconds, node_count / parse_phase.seconds, (f64)ast_bytes / node_count,
+            parallel_phase.seconds, node_count / parallel_phase.seconds, threads,
+            lazy_phase.seconds, mb / lazy_phase.seconds,
+            typer_phase.seconds, node_count / typer_phase.seconds,
+            walk_phase.seconds, walked_count / walk_phase.seconds,
+            streaming_phase.seconds, mb / streaming_phase.seconds, node_count / streaming_phase.seconds,
+            cache_write_phase.seconds, (u64)cache_bytes, (f64)cache_bytes / node_count,
+            cache_load_phase.seconds, front_seconds / cache_load_phase.seconds);
+    fclose(json);
+    printf("wrote %s\n", json_path);
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+   Microbenchmark for keyword/basic type recognition of identifiers.
+   Compares the old cmp_string chain from tokenize() with lookup_keyword().
+   Build and run with ./bench.sh
+*/
+#include "ir_assert.h"
+#include "tokens.h"
+#include "tokenizer.h"
+
+#include <time.h>
+
+static
+f64 bench_now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+//NOTE(Michael): The identifier path of tokenize() before the perfect hash
+static
+Token_Type lookup_keyword_chain(String text, Type* data_type)
+{
+    static const struct { String text; Token_Type type; Type data_type; } chain[] =
+    {
+        {IR_CONSTZ("fn"), TOKEN_FN, TYPE_UNKNOWN},
+        {IR_CONSTZ("return"), TOKEN_RETURN, TYPE_UNKNOWN},
+        {IR_CONSTZ("if"), TOKEN_IF, TYPE_UNKNOWN},
+        {IR_CONSTZ("else"), TOKEN_ELSE, TYPE_UNKNOWN},
+        {IR_CONSTZ("for"), TOKEN_FOR, TYPE_UNKNOWN},
+        {IR_CONSTZ("while"), TOKEN_WHILE, TYPE_UNKNOWN},
+        {IR_CONSTZ("break"), TOKEN_BREAK, TYPE_UNKNOWN},
+        {IR_CONSTZ("continue"), TOKEN_CONT, TYPE_UNKNOWN},
+        {IR_CONSTZ("struct"), TOKEN_STRUCT, TYPE_UNKNOWN},
+        {IR_CONSTZ("cast"), TOKEN_CAST, TYPE_UNKNOWN},
+        {IR_CONSTZ("s8"), TOKEN_BASIC_TYPE, TYPE_S8},
+        {IR_CONSTZ("s16"), TOKEN_BASIC_TYPE, TYPE_S16},
+        {IR_CONSTZ("s32"), TOKEN_BASIC_TYPE, TYPE_S32},
+        {IR_CONSTZ("s64"), TOKEN_BASIC_TYPE, TYPE_S64},
+        {IR_CONSTZ("u8"), TOKEN_BASIC_TYPE, TYPE_U8},
+        {IR_CONSTZ("u16"), TOKEN_BASIC_TYPE, TYPE_U16},
+        {IR_CONSTZ("u32"), TOKEN_BASIC_TYPE, TYPE_U32},
+        {IR_CONSTZ("u64"), TOKEN_BASIC_TYPE, TYPE_U64},
+        {IR_CONSTZ("msi"), TOKEN_BASIC_TYPE, TYPE_MSI},
+        {IR_CONSTZ("f32"), TOKEN_BASIC_TYPE, TYPE_F32},
+        {IR_CONSTZ("f64"), TOKEN_BASIC_TYPE, TYPE_F64},
+        {IR_CONSTZ("b8"), TOKEN_BASIC_TYPE, TYPE_B8},
+        {IR_CONSTZ("void"), TOKEN_BASIC_TYPE, TYPE_VOID},
+    };
+    
+    for(msi i = 0; i < sizeof(chain)/sizeof(chain[0]); ++i)
+    {
+        if(cmp_string(chain[i].text, text))
+        {
+            *data_type = chain[i].data_type;
+            return chain[i].type;
+        }
+    }
+    return TOKEN_ID;
+}
+
+int main(s32 argc, c8** argv)
+{
+    msi count = 1 << 20;
+    msi rounds = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20;
+    
+    //Roughly what generated code looks like: mostly plain identifiers, every 4th a keyword or type
+    static c8* plain[] = {"a", "i", "count", "result", "left_expr", "tmp0", "value", "node_index", "sum", "fib_n"};
+    static c8* special[] = {"s64", "return", "if", "f32", "u8", "else", "cast", "void"};
+    
+    String* idents = (String*)malloc(count * sizeof(String));
+    u32 seed = 1234567;
+    for(msi i = 0; i < count; ++i)
+    {
+        seed = seed * 1664525 + 1013904223;
+        c8* word = (i & 3) == 0 ? special[(seed >> 16) % 8] : plain[(seed >> 16) % 10];
+        idents[i] = wrap_asciiz(word);
+    }
+    
+    u64 checksum_chain = 0;
+    f64 start = bench_now();
+    for(msi r = 0; r < rounds; ++r)
+    {
+        for(msi i = 0; i < count; ++i)
+        {
+            Type data_type = TYPE_UNKNOWN;
+            checksum_chain += lookup_keyword_chain(idents[i], &data_type) + data_type;
+        }
+    }
+    f64 chain_time = bench_now() - start;
+    
+    u64 checksum_hash = 0;
+    start = bench_now();
+    for(msi r = 0; r < rounds; ++r)
+    {
+        for(msi i = 0; i < count; ++i)
+        {
+            const Keyword* k = lookup_keyword(idents[i].data, idents[i].length);
+            checksum_hash += k ? k->type + k->data_type : TOKEN_ID;
+        }
+    }
+    f64 hash_time = bench_now() - start;
+    
+    f64 total = (f64)(count * rounds);
+    printf("identifiers: %llu\n", (u64)total);
+    printf("cmp_string chain: %8.2f M identifiers/s\n", total / chain_time * 1e-6);
+    printf("perfect hash:     %8.2f M identifiers/s\n", total / hash_time * 1e-6);
+    printf("speedup:          %8.2fx\n", chain_time / hash_time);
+    
+    if(checksum_chain != checksum_hash)
+    {
+        fprintf(stderr, "Checksum mismatch! %llu != %llu\n", checksum_chain, checksum_hash);
+        return 1;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,223 @@
+/*
+   Replays a scripted edit session (typing, backspacing, a quote pair and a comment toggle)
+   in the middle of a generated ~50k line file and again in a file 10 times that size.
+   Every edit is applied with retokenize() and compared against a full tokenize() of the
+   edited text, the final streams are checked token by token. The first edit moves the
+   gap of the fresh stream to the cursor and is reported on its own.
+   Usage: bench_retokenize [lines, default 50000]
+   Build and run with ./bench.sh
+*/
+#include "ir_assert.h"
+#include "tokens.h"
+#include "tokenizer.h"
+
+#include <time.h>
+
+static
+f64 bench_now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+#define BLOCK_LINES 15
+
+static
+String generate_source(msi lines, Memory_Arena* arena, msi capacity)
+{
+    const c8* block =
+        "//Generated function %llu\n"
+        "s64 fun_%llu(s64 a, f64 b)\n"
+        "{\n"
+        "    /* block comment\n"
+        "       over two lines with a \" quote */\n"
+        "    s64 x_%llu = (a + %llu) * 3 - 0x1F % 7;\n"
+        "    f32 y = 2.5f32 + cast(f32)b;\n"
+        "    u8 s = \"string %llu with \\\" escape and // no comment\";\n"
+        "    if x_%llu >= 1_000 && a != 2\n"
+        "    {\n"
+        "        x_%llu += a << 2; // trailing comment \"\n"
+        "    }\n"
+        "    return x_%llu;\n"
+        "}\n\n";
+    
+    String result = {};
+    result.data = (u8*)push_size(capacity, arena);
+    c8 buffer[1024];
+    for(u64 i = 0; i < lines / BLOCK_LINES; ++i)
+    {
+        s32 length = snprintf(buffer, sizeof(buffer), block, i, i, i, i, i % 97, i, i, i);
+        IR_ASSERT(result.length + length + TOKENIZER_PADDING <= capacity);
+        copy_buffer(IR_WRAP_INTO_BUFFER(buffer, length), IR_WRAP_INTO_BUFFER(&result.data[result.length], length));
+        result.length += length;
+    }
+    zero_buffer(IR_WRAP_INTO_BUFFER(&result.data[result.length], TOKENIZER_PADDING));
+    return result;
+}
+
+static
+b8 token_streams_equal(Token_Stream* a, Token_Stream* b)
+{
+    if(token_stream_len(a) != token_stream_len(b))
+        return false;
+    
+    for(msi i = 0; i < token_stream_len(a); ++i)
+    {
+        Token ta = token_stream_get(a, i);
+        Token tb = token_stream_get(b, i);
+        if(ta.type != tb.type || ta.offset != tb.offset || ta.length != tb.length)
+            return false;
+        
+        if(ta.type == TOKEN_STR_LIT && !cmp_string(a->str_literals[ta.payload], b->str_literals[tb.payload]))
+            return false;
+        if(ta.type == TOKEN_NUM && (a->numbers[ta.payload].type != b->numbers[tb.payload].type ||
+                                    a->numbers[ta.payload].s_value != b->numbers[tb.payload].s_value))
+            return false;
+        if(ta.type == TOKEN_BASIC_TYPE && ta.payload != tb.payload)
+            return false;
+        if(ta.type == TOKEN_ID && ta.payload != tb.payload)
+            return false;
+    }
+    return true;
+}
+
+struct Edit_Session
+{
+    String snapshots[2]; //The editor text, retokenize needs the previous one to stay readable
+    u32 current;
+    Token_Stream tokens;
+    Heap_Allocator* heap;
+    Interner* symbols;
+    
+    u32 edits;
+    f64 incremental_total;
+    f64 incremental_max;
+    f64 full_total;
+    f64 full_max;
+};
+
+static
+void session_apply(Edit_Session* s, Text_Edit edit)
+{
+    String old_file = s->snapshots[s->current];
+    String* new_file = &s->snapshots[s->current ^ 1];
+    msi tail = old_file.length - edit.offset - edit.deleted;
+    copy_buffer(IR_WRAP_INTO_BUFFER(old_file.data, edit.offset), IR_WRAP_INTO_BUFFER(new_file->data, edit.offset));
+    copy_buffer(IR_WRAP_INTO_BUFFER(edit.inserted.data, edit.inserted.length),
+                IR_WRAP_INTO_BUFFER(new_file->data + edit.offset, edit.inserted.length));
+    copy_buffer(IR_WRAP_INTO_BUFFER(old_file.data + edit.offset + edit.deleted, tail),
+                IR_WRAP_INTO_BUFFER(new_file->data + edit.offset + edit.inserted.length, tail));
+    new_file->length = edit.offset + edit.inserted.length + tail;
+    zero_buffer(IR_WRAP_INTO_BUFFER(&new_file->data[new_file->length], TOKENIZER_PADDING));
+    
+    f64 begin = bench_now();
+    retokenize(&s->tokens, *new_file, edit);
+    f64 incremental = bench_now() - begin;
+    
+    begin = bench_now();
+    Token_Stream full = tokenize(*new_file, s->symbols, s->heap);
+    f64 seconds = bench_now() - begin;
+    token_stream_free(&full);
+    
+    s->current ^= 1;
+    ++s->edits;
+    s->incremental_total += incremental;
+    if(incremental > s->incremental_max) s->incremental_max = incremental;
+    s->full_total += seconds;
+    if(seconds > s->full_max) s->full_max = seconds;
+}
+
+//Types text one character at a time starting at offset, returns the new cursor
+static
+msi session_type(Edit_Session* s, msi offset, const c8* text)
+{
+    for(const c8* c = text; *c; ++c)
+    {
+        session_apply(s, Text_Edit{offset, 0, String{1, (u8*)c}});
+        ++offset;
+    }
+    return offset;
+}
+
+static
+msi session_backspace(Edit_Session* s, msi offset, msi count)
+{
+    for(msi i = 0; i < count; ++i)
+    {
+        --offset;
+        session_apply(s, Text_Edit{offset, 1, {}});
+    }
+    return offset;
+}
+
+static
+void session_print(Edit_Session* s, const c8* name)
+{
+    printf("%-14s %4u edits  retokenize avg %8.2fus max %8.2fus  tokenize avg %8.2fus max %8.2fus\n",
+           name, s->edits, s->incremental_total / s->edits * 1e6, s->incremental_max * 1e6,
+           s->full_total / s->edits * 1e6, s->full_max * 1e6);
+    s->edits = 0;
+    s->incremental_total = s->incremental_max = 0;
+    s->full_total = s->full_max = 0;
+}
+
+static
+b8 run_session(msi lines)
+{
+    msi capacity = lines * 64 + IR_MEGABYTES(1);
+    msi arena_size = 2 * capacity + IR_GIGABYTES(1);
+    
+    u8* memory = (u8*)malloc(arena_size);
+    Memory_Arena arena = create_memory_arena(arena_size, memory);
+    Edit_Session s = {};
+    s.snapshots[0] = generate_source(lines, &arena, capacity);
+    s.snapshots[1] = String{0, (u8*)push_size(capacity, &arena)};
+    Heap_Allocator heap = create_heap(&arena, IR_GIGABYTES(1) - IR_MEGABYTES(1), 18);
+    Interner symbols = create_interner(&heap);
+    s.heap = &heap;
+    s.symbols = &symbols;
+    s.tokens = tokenize(s.snapshots[0], &symbols, &heap);
+    printf("%llu bytes, %llu tokens\n", s.snapshots[0].length, token_stream_len(&s.tokens));
+    
+    //Start of the return statement of the function in the middle of the file
+    String file = s.snapshots[0];
+    msi cursor = (lines / BLOCK_LINES / 2) * (file.length / (lines / BLOCK_LINES));
+    String needle = IR_CONSTZ("    return");
+    while(!cmp_string(String{needle.length, file.data + cursor}, needle))
+    {
+        ++cursor;
+    }
+    
+    cursor = session_type(&s, cursor, " ");
+    session_print(&s, "first edit");
+    
+    cursor = session_type(&s, cursor, "   s64 total = x_1 + 42 * b; // running sum\n");
+    cursor = session_backspace(&s, cursor, 20);
+    cursor = session_type(&s, cursor, "12; // fixed\n");
+    session_print(&s, "typing");
+    
+    //Unbalanced until the closing quote, the whole tail changes meaning in between
+    cursor = session_type(&s, cursor, "    u8 note = \"");
+    cursor = session_type(&s, cursor, "todo\";\n");
+    session_print(&s, "string literal");
+    
+    msi line_start = cursor;
+    session_apply(&s, Text_Edit{line_start, 0, IR_CONSTZ("//")});
+    session_apply(&s, Text_Edit{line_start, 2, {}});
+    session_print(&s, "comment toggle");
+    
+    Token_Stream reference = tokenize(s.snapshots[s.current], &symbols, &heap);
+    b8 equal = token_streams_equal(&reference, &s.tokens);
+    printf("final stream %s\n", equal ? "matches tokenize" : "MISMATCH");
+    free(memory);
+    return equal;
+}
+
+int main(s32 argc, c8** argv)
+{
+    msi lines = argc > 1 ? atoll(argv[1]) : 50000;
+    b8 equal = run_session(lines);
+    equal &= run_session(10 * lines);
+    return equal ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+/*
+   Scaling of tokenize_parallel() with the thread count on a generated source file.
+   Every run is checked token by token against the single threaded tokenize(), the
+   prescan for the chunk boundaries is also timed on its own.
+   Usage: bench_tokenize_parallel [size in MB, default 100] [max threads, default 16]
+   Build and run with ./bench.sh
+*/
+#include "ir_assert.h"
+#include "tokens.h"
+#include "tokenizer.h"
+
+#include <time.h>
+#include <unistd.h>
+
+static
+f64 bench_now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+static
+String generate_source(msi size, Memory_Arena* arena)
+{
+    const c8* block =
+        "//Generated function %llu\n"
+        "s64 fun_%llu(s64 a, f64 b)\n"
+        "{\n"
+        "    /* block comment\n"
+        "       over two lines with a \" quote */\n"
+        "    s64 x_%llu = (a + %llu) * 3 - 0x1F % 7;\n"
+        "    f32 y = 2.5f32 + cast(f32)b;\n"
+        "    u8 s = \"string %llu with \\\" escape and // no comment\";\n"
+        "    if x_%llu >= 1_000 && a != 2\n"
+        "    {\n"
+        "        x_%llu += a << 2; // trailing comment \"\n"
+        "    }\n"
+        "    return x_%llu;\n"
+        "}\n\n";
+    
+    String result = {};
+    result.data = (u8*)push_size(size + TOKENIZER_PADDING, arena);
+    c8 buffer[1024];
+    u64 i = 0;
+    while(result.length < size)
+    {
+        s32 length = snprintf(buffer, sizeof(buffer), block, i, i, i, i, i % 97, i, i, i);
+        msi copy = u64_min(length, size - result.length);
+        copy_buffer(IR_WRAP_INTO_BUFFER(buffer, copy), IR_WRAP_INTO_BUFFER(&result.data[result.length], copy));
+        result.length += copy;
+        ++i;
+    }
+    zero_buffer(IR_WRAP_INTO_BUFFER(&result.data[result.length], TOKENIZER_PADDING));
+    return result;
+}
+
+static
+b8 token_streams_equal(Token_Stream* a, Token_Stream* b)
+{
+    if(token_stream_len(a) != token_stream_len(b))
+        return false;
+    
+    for(msi i = 0; i < token_stream_len(a); ++i)
+    {
+        Token ta = token_stream_get(a, i);
+        Token tb = token_stream_get(b, i);
+        if(ta.type != tb.type || ta.offset != tb.offset || ta.length != tb.length)
+            return false;
+        
+        if(ta.type == TOKEN_STR_LIT && !cmp_string(a->str_literals[ta.payload], b->str_literals[tb.payload]))
+            return false;
+        if(ta.type == TOKEN_NUM && (a->numbers[ta.payload].type != b->numbers[tb.payload].type ||
+                                    a->numbers[ta.payload].s_value != b->numbers[tb.payload].s_value))
+            return false;
+        if(ta.type == TOKEN_BASIC_TYPE && ta.payload != tb.payload)
+            return false;
+        if(ta.type == TOKEN_ID && !cmp_string(symbol_string(a->symbols, ta.payload), symbol_string(b->symbols, tb.payload)))
+            return false;
+    }
+    return true;
+}
+
+int main(s32 argc, c8** argv)
+{
+    msi size = IR_MEGABYTES(argc > 1 ? atoll(argv[1]) : 100);
+    u32 max_threads = argc > 2 ? atoi(argv[2]) : 16;
+    
+    Memory_Arena arena = create_memory_arena(size + IR_GIGABYTES(4) + IR_MEGABYTES(16),
+                                             (u8*)malloc(size + IR_GIGABYTES(4) + IR_MEGABYTES(16)));
+    String file = generate_source(size, &arena);
+    Heap_Allocator heap = create_heap(&arena, IR_GIGABYTES(4), 18);
+    
+    //NOTE(Michael): Every run interns into a new interner, the threads pay for inserting the names
+    Interner reference_symbols = create_interner(&heap);
+    f64 begin = bench_now();
+    Token_Stream reference = tokenize(file, &reference_symbols, &heap);
+    f64 single = bench_now() - begin;
+    printf("tokenize            %6.3fs %8.1f MB/s  %llu tokens\n", single, size / single / IR_MEGABYTES(1),
+           token_stream_len(&reference));
+    
+    for(u32 threads = 1; threads <= max_threads; threads *= 2)
+    {
+        //NOTE(Michael): The prescan for the chunk boundaries on its own, tokenize_parallel runs it again
+        msi boundaries[TOKENIZER_MAX_THREADS + 1];
+        begin = bench_now();
+        find_chunk_boundaries(file, threads, boundaries);
+        f64 prescan = bench_now() - begin;
+        
+        Interner symbols = create_interner(&heap);
+        begin = bench_now();
+        Token_Stream tokens = tokenize_parallel(file, &symbols, &heap, threads);
+        f64 seconds = bench_now() - begin;
+        b8 equal = token_streams_equal(&reference, &tokens);
+        printf("parallel %2u threads %6.3fs %8.1f MB/s  speedup %5.2fx  prescan %6.4fs %s\n", threads, seconds,
+               size / seconds / IR_MEGABYTES(1), single / seconds, prescan, equal ? "" : "MISMATCH");
+        token_stream_free(&tokens);
+        free_interner(&symbols);
+    }
+    
+    printf("(%ld cores online)\n", sysconf(_SC_NPROCESSORS_ONLN));
+    return 0;
+}
@@ -0,0 +1,352 @@
+#ifndef MLANG_GENERATOR_H
+#define MLANG_GENERATOR_H
+
+#include <stdio.h>
+#include <stdarg.h>
+
+/*
+   Emits valid Mlang programs (they parse and type check) of a given size and shape.
+   Integer code only uses s64, float code only f64, the two meet through casts, so the
+   typer never has to report an implicit conversion. Output only depends on the shape.
+*/
+struct Mlang_Shape
+{
+    msi size;         //Functions are emitted until the program has at least this many bytes
+    u32 globals;      //Global variables in front of the functions
+    u32 statements;   //Statements in a function body, nested blocks get fewer
+    u32 depth;        //Maximum nesting of if/else and blocks
+    u32 expr_length;  //Maximum number of operands in an expression
+    u64 seed;
+};
+
+inline
+Mlang_Shape default_mlang_shape()
+{
+    Mlang_Shape result = {};
+    result.size = IR_MEGABYTES(8);
+    result.globals = 256;
+    result.statements = 16;
+    result.depth = 3;
+    result.expr_length = 8;
+    result.seed = 0x9E3779B97F4A7C15ULL;
+    return result;
+}
+
+struct Mlang_Generator
+{
+    Mlang_Shape shape;
+    String out;
+    msi capacity;
+    u64 rng;
+
+    //Visible variables, in declaration order so leaving a block only has to pop them
+    u32 int_vars[1024];
+    u32 int_var_count;
+    u32 float_vars[1024];
+    u32 float_var_count;
+    u32 next_var;
+    u32 indent;
+};
+
+inline
+u64 gen_random(Mlang_Generator* g)
+{
+    //xorshift64*
+    g->rng ^= g->rng >> 12;
+    g->rng ^= g->rng << 25;
+    g->rng ^= g->rng >> 27;
+    return g->rng * 0x2545F4914F6CDD1DULL;
+}
+
+//Random number in [0, n)
+inline
+u32 gen_below(Mlang_Generator* g, u32 n)
+{
+    return (u32)((gen_random(g) >> 32) % n);
+}
+
+static
+void gen_printf(Mlang_Generator* g, const c8* f_msg, ...)
+{
+    va_list valist;
+    va_start(valist, f_msg);
+    s32 length = vsnprintf((c8*)&g->out.data[g->out.length], g->capacity - g->out.length, f_msg, valist);
+    va_end(valist);
+    IR_ASSERT(length >= 0 && g->out.length + length < g->capacity && "Generated program does not fit!");
+    g->out.length += length;
+}
+
+static
+void gen_indent(Mlang_Generator* g)
+{
+    gen_printf(g, "%*s", g->indent * 4, "");
+}
+
+static void gen_int_expr(Mlang_Generator* g, u32 operands);
+static void gen_float_expr(Mlang_Generator* g, u32 operands);
+
+static
+void gen_int_operand(Mlang_Generator* g)
+{
+    u32 pick = gen_below(g, 16);
+    if(pick < 6 && g->int_var_count)
+    {
+        gen_printf(g, "v%u", g->int_vars[gen_below(g, g->int_var_count)]);
+    }
+    else if(pick < 8)
+    {
+        gen_printf(g, gen_below(g, 2) ? "a" : "b");
+    }
+    else if(pick < 9 && g->shape.globals)
+    {
+        gen_printf(g, "g%u", gen_below(g, g->shape.globals));
+    }
+    else if(pick < 10 && g->float_var_count)
+    {
+        gen_printf(g, "cast(s64)w%u", g->float_vars[gen_below(g, g->float_var_count)]);
+    }
+    else if(pick < 11)
+    {
+        //NOTE(Michael): Only on plain operands, "- -x" must never become "--x"
+        gen_printf(g, gen_below(g, 2) ? "-" : "~");
+        if(g->int_var_count)
+            gen_printf(g, "v%u", g->int_vars[gen_below(g, g->int_var_count)]);
+        else
+            gen_printf(g, "%u", 1 + gen_below(g, 1000));
+    }
+    else if(pick < 12)
+    {
+        gen_printf(g, "(");
+        gen_int_expr(g, 2 + gen_below(g, 3));
+        gen_printf(g, ")");
+    }
+    else if(pick < 13)
+    {
+        gen_printf(g, "0x%X", 1 + gen_below(g, 0xFFFF));
+    }
+    else
+    {
+        gen_printf(g, "%u", 1 + gen_below(g, 1000));
+    }
+}
+
+//NOTE(Michael): Divisors and shift counts are always literals so folding never divides by zero
+static
+void gen_int_expr(Mlang_Generator* g, u32 operands)
+{
+    static const c8* ops[] = {" + ", " - ", " * ", " & ", " | ", " ^ ", " + ", " - "};
+    gen_int_operand(g);
+    for(u32 i = 1; i < operands; ++i)
+    {
+        u32 pick = gen_below(g, 12);
+        if(pick < 8)
+        {
+            gen_printf(g, ops[pick]);
+            gen_int_operand(g);
+        }
+        else if(pick < 10)
+        {
+            gen_printf(g, pick == 8 ? " / %u" : " %% %u", 1 + gen_below(g, 97));
+        }
+        else
+        {
+            gen_printf(g, pick == 10 ? " << %u" : " >> %u", 1 + gen_below(g, 7));
+        }
+    }
+}
+
+static
+void gen_float_operand(Mlang_Generator* g)
+{
+    u32 pick = gen_below(g, 8);
+    if(pick < 3 && g->float_var_count)
+    {
+        gen_printf(g, "w%u", g->float_vars[gen_below(g, g->float_var_count)]);
+    }
+    else if(pick < 4)
+    {
+        gen_printf(g, "c");
+    }
+    else if(pick < 5 && g->shape.globals)
+    {
+        gen_printf(g, "h%u", gen_below(g, g->shape.globals));
+    }
+    else if(pick < 6)
+    {
+        gen_printf(g, "cast(f64)");
+        gen_int_operand(g);
+    }
+    else if(pick < 7)
+    {
+        gen_printf(g, "(");
+        gen_float_expr(g, 2 + gen_below(g, 3));
+        gen_printf(g, ")");
+    }
+    else
+    {
+        gen_printf(g, "%u.%02u", gen_below(g, 1000), 1 + gen_below(g, 99));
+    }
+}
+
+static
+void gen_float_expr(Mlang_Generator* g, u32 operands)
+{
+    static const c8* ops[] = {" + ", " - ", " * ", " / "};
+    gen_float_operand(g);
+    for(u32 i = 1; i < operands; ++i)
+    {
+        gen_printf(g, ops[gen_below(g, 4)]);
+        gen_float_operand(g);
+    }
+}
+
+static
+void gen_condition(Mlang_Generator* g)
+{
+    static const c8* compares[] = {" < ", " > ", " <= ", " >= ", " == ", " != "};
+    u32 terms = 1 + gen_below(g, 3);
+    for(u32 i = 0; i < terms; ++i)
+    {
+        if(i)
+            gen_printf(g, gen_below(g, 2) ? " && " : " || ");
+        gen_int_expr(g, 1 + gen_below(g, g->shape.expr_length / 2 + 1));
+        gen_printf(g, compares[gen_below(g, 6)]);
+        gen_int_expr(g, 1 + gen_below(g, 2));
+    }
+}
+
+static void gen_statements(Mlang_Generator* g, u32 count, u32 depth);
+
+static
+void gen_block(Mlang_Generator* g, u32 depth)
+{
+    u32 int_vars = g->int_var_count;
+    u32 float_vars = g->float_var_count;
+
+    gen_indent(g);
+    gen_printf(g, "{\n");
+    ++g->indent;
+    gen_statements(g, (u32)u64_max(2, g->shape.statements >> depth), depth);
+    --g->indent;
+    gen_indent(g);
+    gen_printf(g, "}\n");
+
+    g->int_var_count = int_vars;
+    g->float_var_count = float_vars;
+}
+
+static
+void gen_statement(Mlang_Generator* g, u32 depth)
+{
+    u32 operands = 1 + gen_below(g, g->shape.expr_length);
+    u32 pick = gen_below(g, 16);
+    if(depth < g->shape.depth && pick < 2)
+    {
+        gen_indent(g);
+        gen_printf(g, "if ");
+        gen_condition(g);
+        gen_printf(g, "\n");
+        gen_block(g, depth + 1);
+        if(gen_below(g, 2))
+        {
+            gen_indent(g);
+            gen_printf(g, "else\n");
+            gen_block(g, depth + 1);
+        }
+        return;
+    }
+    if(depth < g->shape.depth && pick < 3)
+    {
+        gen_block(g, depth + 1);
+        return;
+    }
+
+    gen_indent(g);
+    if(pick < 8 && g->int_var_count < 1024)
+    {
+        u32 var = g->next_var++;
+        gen_printf(g, "s64 v%u = ", var);
+        gen_int_expr(g, operands);
+        g->int_vars[g->int_var_count++] = var;
+    }
+    else if(pick < 10 && g->float_var_count < 1024)
+    {
+        u32 var = g->next_var++;
+        gen_printf(g, "f64 w%u = ", var);
+        gen_float_expr(g, operands);
+        g->float_vars[g->float_var_count++] = var;
+    }
+    else if(pick < 14 && g->int_var_count)
+    {
+        static const c8* assigns[] = {" = ", " += ", " -= ", " *= ", " &= ", " |= ", " ^= "};
+        gen_printf(g, "v%u%s", g->int_vars[gen_below(g, g->int_var_count)], assigns[gen_below(g, 7)]);
+        gen_int_expr(g, operands);
+    }
+    else if(g->float_var_count)
+    {
+        static const c8* assigns[] = {" = ", " += ", " -= ", " *= "};
+        gen_printf(g, "w%u%s", g->float_vars[gen_below(g, g->float_var_count)], assigns[gen_below(g, 4)]);
+        gen_float_expr(g, operands);
+    }
+    else
+    {
+        gen_printf(g, gen_below(g, 2) ? "a = " : "b = ");
+        gen_int_expr(g, operands);
+    }
+    gen_printf(g, ";\n");
+}
+
+static
+void gen_statements(Mlang_Generator* g, u32 count, u32 depth)
+{
+    for(u32 i = 0; i < count; ++i)
+    {
+        gen_statement(g, depth);
+    }
+}
+
+static
+void gen_function(Mlang_Generator* g, u64 index)
+{
+    g->int_var_count = 0;
+    g->float_var_count = 0;
+    g->next_var = 0;
+
+    gen_printf(g, "s64 fun%llu(s64 a, s64 b, f64 c)\n{\n", index);
+    g->indent = 1;
+    gen_statements(g, g->shape.statements, 0);
+    gen_indent(g);
+    gen_printf(g, "return ");
+    gen_int_expr(g, 1 + gen_below(g, g->shape.expr_length));
+    gen_printf(g, ";\n}\n\n");
+    g->indent = 0;
+}
+
+/*
+   The result lives in arena. Reserves size plus slack for the last function,
+   untouched pages of the slack are never committed.
+*/
+static
+String generate_mlang(Mlang_Shape shape, Memory_Arena* arena)
+{
+    Mlang_Generator g = {};
+    g.shape = shape;
+    g.rng = shape.seed ? shape.seed : 1;
+    g.capacity = shape.size + shape.globals * 64 + IR_MEGABYTES(16);
+    g.out.data = (u8*)push_size(g.capacity, arena);
+
+    for(u32 i = 0; i < shape.globals; ++i)
+    {
+        gen_printf(&g, "s64 g%u = %u;\n", i, 1 + gen_below(&g, 100000));
+        gen_printf(&g, "f64 h%u = %u.5;\n", i, gen_below(&g, 1000));
+    }
+    gen_printf(&g, "\n");
+
+    for(u64 i = 0; g.out.length < shape.size; ++i)
+    {
+        gen_function(&g, i);
+    }
+    return g.out;
+}
+
+#endif //MLANG_GENERATOR_H
@@ -4,5 +4,11 @@ DISABLED_WARNINGS="-Wno-write-strings -Wno-sign-compare -Wno-writable-strings -W
 
 INCLUDE_DIR="-I src/irlibs"
 
+#./build.sh avx2 builds the 32 byte scans and the AVX2 UTF-8 validation, the default build uses SSE2
+SIMD_FLAGS=""
+if [ "$1" == "avx2" ]; then
+    SIMD_FLAGS="-mavx2"
+fi
 
-clang++ src/main.cpp -o mc -g -Wall -O0 $INCLUDE_DIR $DISABLE_RTTI_EXCEPTIONS $DISABLED_WARNINGS
\ No newline at end of file
+
+clang++ src/main.cpp -o mc -g -Wall -O0 -pthread $SIMD_FLAGS $INCLUDE_DIR $DISABLE_RTTI_EXCEPTIONS $DISABLED_WARNINGS
\ No newline at end of file
@@ -1,7 +1,6 @@
 #ifndef AST_H
 #define AST_H
 
-
 enum Node_Type
 {
     N_UNKNOWN=0,
@@ -54,8 +53,8 @@ enum Expr_Op_Type
 
 struct Constant
 {
-    Token* token;
     Type type;
+    b8 has_suffix; //Type was given explicitly (3u8), never converted implicitly
     union
     {
         //     u64 u_value;
@@ -67,16 +66,29 @@ struct Constant
 struct Scope;
 struct Variable
 {
-    Token* token;
+    Token token;
     Type type;
-    String name;
+    Symbol_Id name;
     Scope* scope;
+    Variable* next_in_scope;
 };
 
+/*
+   Variables in declaration order. Once a scope holds SCOPE_TABLE_THRESHOLD variables
+   it also gets an open addressing table (linear probing, at most half full) keyed by
+   the Symbol_Id of the name, smaller scopes are searched through the list. Like the
+   list the table finds the first declaration of a name.
+*/
+#define SCOPE_TABLE_THRESHOLD 8
+
 struct Scope
 {
     Scope* parent;
-    Variable** variables;
+    Variable* first_variable;
+    Variable* last_variable;
+    u32 variable_count;
+    u32 table_mask;
+    Variable** table;
 };
 
 struct Expr
@@ -88,51 +100,40 @@ struct Expr
 struct Function
 {
     Scope* scope;
-    Variable** params;
+    u32 param_count; //The params are the first variables of scope
     Type return_type;
-    String name;
-    Token* token;
+    Symbol_Id name;
+    Token token;
 };
 
 
-struct Node;
-#if 1
-//NOTE(Michael)This is here to help the debugger show the children properly...
-struct Node_List
-{
-    Node* n0;
-    Node* n1;
-    Node* n2;
-    Node* n3;
-    Node* n4;
-};
-
-#endif
+/*
+   Nodes live in one dense array and refer to each other by index, children are a
+   singly linked list (first_child, next_sibling) with last_child for appending.
+   Index 0 is never a real node, AST_NO_NODE ends a list like nullptr did.
+   Node* from ast_node are only valid until the next ast_create_node, the array may move.
+*/
+typedef u32 Node_Id;
+#define AST_NO_NODE 0
 
 struct Node_Info
 {
-    Token* token;
+    Token token;
     b8 has_error;
-    Node* next_in_free_list;
     b8 implicit;
 };
 
 struct Node
 {
     Node_Type type;
-    Node* parent;
-    union
-    {
-        Node** children;
-        Node_List* ch;
-    };
-    Scope* scope;
+    Node_Id first_child;
+    Node_Id last_child;
+    Node_Id next_sibling; //Next node of the free list once the node is removed
     Node_Info info;
     union
     {
         Function* fun;
         Variable* var;
-        String id_placeholder;
         Constant con;
         Expr exp;
     };
@@ -140,26 +141,222 @@ struct Node
 
 
 
+//A node of an ast_walk and the next of its children to enter
+struct AST_Walk_Frame
+{
+    Node_Id node;
+    Node_Id next_child;
+};
+
 struct AST
 {
     Heap_Allocator* heap;
-    Node* nodes_ba;
-    Function* functions_ba;
-    Variable* variables_ba;
-    Scope* scopes_ba;
-    Node* root;
+    String file;
+    Line_Index lines;
+    Interner* symbols;
+    Node* nodes;
+    Slab_Allocator functions;
+    Slab_Allocator variables;
+    Slab_Allocator scopes;
+    Node_Id root;
     Scope* global_scope;
-    Node* node_free_list;
+    Node_Id node_free_list;
+    AST_Walk_Frame* walk_scratch; //Stack for the next ast_walk_begin, nullptr while a walk has it
+    b8 nodes_mapped;              //nodes is the node section of an AST cache image (ast_cache.h)
     b8 has_error;
 };
 
 inline
-Node* ast_root(AST* ast)
+String token_text(AST* ast, Token t)
+{
+    return token_text(ast->file, t);
+}
+
+inline
+Node* ast_node(AST* ast, Node_Id id)
+{
+    IR_ASSERT(id != AST_NO_NODE && id < ARR_LEN(ast->nodes));
+    return &ast->nodes[id];
+}
+
+inline
+Node_Id ast_root(AST* ast)
+{
+    return ast->root;
+}
+
+//Number of nodes ever created, removed ones included
+inline
+msi ast_node_count(AST* ast)
+{
+    return ARR_LEN(ast->nodes) - 1;
+}
+
+inline
+Node_Id ast_first_child(AST* ast, Node_Id id)
+{
+    return ast->nodes[id].first_child;
+}
+
+inline
+Node_Id ast_next_sibling(AST* ast, Node_Id id)
 {
-    return BA_GET(ast->nodes_ba, 0);  
+    return ast->nodes[id].next_sibling;
+}
+
+//AST_NO_NODE if node has no child at index
+inline
+Node_Id ast_child(AST* ast, Node_Id id, msi index)
+{
+    Node_Id child = ast_first_child(ast, id);
+    for(; child && index; --index)
+    {
+        child = ast_next_sibling(ast, child);
+    }
+    return child;
+}
+
+inline
+msi ast_child_count(AST* ast, Node_Id id)
+{
+    msi result = 0;
+    for(Node_Id child = ast_first_child(ast, id); child; child = ast_next_sibling(ast, child))
+    {
+        ++result;
+    }
+    return result;
+}
+
+/*
+   Depth first walk over the subtree of a node with an explicit stack, deep trees cannot
+   run out of C stack. ast_walk_next stops at every node before its children (AST_WALK_PRE)
+   and/or after them (AST_WALK_POST), node, depth (0 for the root), is_last (the node has
+   no next sibling or is the root) and leaving (the stop after the children) describe the
+   stop.
+   The first child and the next sibling of a node are read when it is entered: a post
+   order visitor may put new nodes between a node and its children or in the place of the
+   node under its parent (ast_insert_between), the new nodes are not visited.
+   The stack is taken from *scratch (ast->walk_scratch by default) and given back by
+   ast_walk_end, a walk that starts while another one has the stack gets a new one.
+*/
+#define AST_WALK_PRE 1
+#define AST_WALK_POST 2
+
+struct AST_Walk
+{
+    AST* ast;
+    AST_Walk_Frame* stack;
+    AST_Walk_Frame** scratch;
+    u32 order;
+    b8 root_pending;
+    Node_Id node;
+    u32 depth;
+    b8 is_last;
+    b8 leaving;
 };
 
-void ast_print_node(Node* node)
+inline
+AST_Walk ast_walk_begin(AST* ast, Node_Id root, u32 order, AST_Walk_Frame** scratch = nullptr)
+{
+    IR_ASSERT(root != AST_NO_NODE && root < ARR_LEN(ast->nodes));
+    AST_Walk result = {};
+    result.ast = ast;
+    result.scratch = scratch ? scratch : &ast->walk_scratch;
+    result.stack = *result.scratch;
+    *result.scratch = nullptr;
+    if(result.stack)
+    {
+        ARR_DEL_ALL(result.stack);
+    }
+    else
+    {
+        ARR_INIT(result.stack, 64, ast->heap);
+    }
+    ARR_PUSH(result.stack, (AST_Walk_Frame{root, ast->nodes[root].first_child}));
+    
+    result.order = order;
+    result.root_pending = (order & AST_WALK_PRE) != 0;
+    result.node = root;
+    result.is_last = true;
+    return result;
+}
+
+inline
+b8 ast_walk_next(AST_Walk* walk)
+{
+    if(walk->root_pending)
+    {
+        walk->root_pending = false;
+        return true;
+    }
+    
+    //NOTE(Michael): Frames are u32s like order, in locals the compiler does not reload it after every push
+    Node* nodes = walk->ast->nodes;
+    AST_Walk_Frame* stack = walk->stack;
+    u32 order = walk->order;
+    Dyn_Array_Header* header = arr_header(stack);
+    while(header->length)
+    {
+        msi depth = header->length - 1;
+        AST_Walk_Frame* top = &stack[depth];
+        Node_Id child = top->next_child;
+        if(child)
+        {
+            Node_Id next_sibling = nodes[child].next_sibling;
+            Node_Id first_child = nodes[child].first_child;
+            top->next_child = next_sibling;
+            //NOTE(Michael): Pushes without the call into ARR_PUSH until the stack is full
+            if(header->length < header->capacity)
+            {
+                stack[header->length++] = {child, first_child};
+            }
+            else
+            {
+                ARR_PUSH(stack, (AST_Walk_Frame{child, first_child}));
+                walk->stack = stack;
+                header = arr_header(stack);
+            }
+            if(order & AST_WALK_PRE)
+            {
+                walk->node = child;
+                walk->depth = depth + 1;
+                walk->is_last = next_sibling == AST_NO_NODE;
+                walk->leaving = false;
+                return true;
+            }
+        }
+        else
+        {
+            Node_Id node = top->node;
+            header->length--;
+            if(order & AST_WALK_POST)
+            {
+                walk->node = node;
+                walk->depth = depth;
+                walk->is_last = depth == 0 || nodes[node].next_sibling == AST_NO_NODE;
+                walk->leaving = true;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+inline
+void ast_walk_end(AST_Walk* walk)
+{
+    if(*walk->scratch)
+    {
+        ARR_FREE(walk->stack);
+    }
+    else
+    {
+        *walk->scratch = walk->stack;
+    }
+    walk->stack = nullptr;
+}
+
+void ast_print_node(AST* ast, Node* node)
 {
     IR_NOT_NULL(node);
     
@@ -177,12 +374,12 @@ void ast_print_node(Node* node)
     {
         case N_FUNCTION:
         {
-            printf("%.*s", node->fun->name);
+            printf("%.*s", symbol_string(ast->symbols, node->fun->name));
             break;   
         }
         case N_VAR:
         {
-            printf("%.*s", node->var->name);
+            printf("%.*s", symbol_string(ast->symbols, node->var->name));
             if(node->var->type != TYPE_UNKNOWN)
             {
                 printf(" %.*s", data_type_to_str(node->var->type));   
@@ -261,7 +458,7 @@ void ast_print_node(Node* node)
         }
         case N_VAR_DECL:
         {
-            printf("%.*s %.*s", data_type_to_str(node->var->type), node->var->name);
+            printf("%.*s %.*s", data_type_to_str(node->var->type), symbol_string(ast->symbols, node->var->name));
             break;   
         }
         case N_CONSTANT:
@@ -271,12 +468,12 @@ void ast_print_node(Node* node)
                 case TYPE_U8:
                 case TYPE_U16:
                 case TYPE_U32:
-                case TYPE_U64:
                 case TYPE_S8:
                 case TYPE_S16:
                 case TYPE_S32:
                 case TYPE_S64: printf("%lli", node->con.s_value); break;
-                case TYPE_MSI:
+                case TYPE_U64:
+                case TYPE_MSI: printf("%llu", (u64)node->con.s_value); break;
                 case TYPE_F32:
                 case TYPE_F64: printf("%f", node->con.f_value); break;
                 case TYPE_B8: node->con.s_value ? printf("true") : printf("false"); break;
@@ -289,217 +486,273 @@ void ast_print_node(Node* node)
     
     
     printf("\033[0m"); 
-    // printf(" %llu:%llu", node->token->line, node->token->column);
+    // printf(" %llu:%llu", token_location(&ast->lines, node->info.token).line, token_location(&ast->lines, node->info.token).column);
 }
 
-void ast_print_tree(Node* node, Heap_Allocator* heap, u64 depth = 0, b8* flags = nullptr, b8 is_last = false)
+void ast_print_tree(AST* ast, Node_Id node, Heap_Allocator* heap)
 {
-    IR_NOT_NULL(node);
+    IR_ASSERT(node != AST_NO_NODE);
     IR_NOT_NULL(heap);
-    if(depth == 0 && flags == nullptr)
-    {
-        ARR_INIT(flags, 16, heap);
-    }
-    
     
-    if(depth == ARR_LEN(flags))
-    {
-        ARR_PUSH(flags, true);   
-    }
+    //NOTE(Michael): flags[d] is set while the open node at depth d + 1 has a next sibling, its column gets a line
+    b8* flags = nullptr;
+    ARR_INIT(flags, 16, heap);
     
-    for(msi i = 1; i < depth; ++i)
+    AST_Walk walk = ast_walk_begin(ast, node, AST_WALK_PRE);
+    while(ast_walk_next(&walk))
     {
-        if(ARR_LEN(flags)>i && flags[i-1] == true)
+        for(msi i = 1; i < walk.depth; ++i)
         {
-            printf("│  "); 
+            if(flags[i-1] == true)
+            {
+                printf("│  "); 
+            }
+            else
+            {
+                printf("   ");   
+            }
         }
-        else
+        
+        if(walk.depth == 0)
         {
-            printf("   ");   
+            ast_print_node(ast, ast_node(ast, walk.node));
+            printf("\n");
+            continue;
         }
-    }
-    
-    if(depth == 0)
-    {
-        ast_print_node(node);
-        printf("\n");
-    }
-    else if(is_last)
-    {
-        printf("└──");   
-        ast_print_node(node);
-        printf("\n");
-        flags[depth-1] = false;   
-    }
-    else
-    {
-        printf("├──");   
-        ast_print_node(node);
+        
+        if(walk.depth > ARR_LEN(flags))
+        {
+            ARR_PUSH(flags, true);
+        }
+        flags[walk.depth-1] = !walk.is_last;
+        printf(walk.is_last ? "└──" : "├──");
+        ast_print_node(ast, ast_node(ast, walk.node));
         printf("\n");
     }
+    ast_walk_end(&walk);
     
-    for(msi i = 0; node->children && i < ARR_LEN(node->children); ++i)
-    {
-        ast_print_tree(node->children[i], heap, depth + 1, flags,  i == (ARR_LEN(node->children)-1));
-    }
-    
-    
-    flags[depth-1] = true;
-    
+    ARR_FREE(flags);
 }
 
-b8 ast_node_has_error_in_tree(Node* node)
+b8 ast_node_has_error_in_tree(AST* ast, Node_Id node)
 {
-    IR_NOT_NULL(node);
-    b8 result = node->info.has_error;
+    IR_ASSERT(node != AST_NO_NODE);
+    b8 result = false;
     
-    if(!result && node->children)
+    AST_Walk walk = ast_walk_begin(ast, node, AST_WALK_PRE);
+    while(!result && ast_walk_next(&walk))
     {
-        for(msi i = 0; i < ARR_LEN(node->children); ++i)
-        {
-            if(ast_node_has_error_in_tree(node->children[i]))
-            {
-                result = true;
-               // node->info.has_error= true;
-                break;
-            }
-        }
+        result = ast->nodes[walk.node].info.has_error;
     }
+    ast_walk_end(&walk);
     
     return result;
 }
 
 inline
-void ast_node_add_child(Node* parent, Node* child, AST* ast)
+void ast_node_add_child(Node_Id parent, Node_Id child, AST* ast)
 {
-    IR_NOT_NULL(parent);
+    IR_ASSERT(parent != AST_NO_NODE);
     if(child)
     {
-        if(parent->children == nullptr)
+        Node* p = ast_node(ast, parent);
+        if(p->last_child)
         {
-            ARR_INIT(parent->children, 2, ast->heap);
+            ast_node(ast, p->last_child)->next_sibling = child;
         }
-        
-        child->parent = parent;
-        ARR_PUSH(parent->children, child);
+        else
+        {
+            p->first_child = child;
+        }
+        p->last_child = child;
+        ast_node(ast, child)->next_sibling = AST_NO_NODE;
     }
 }
 
+//new_node takes the place of the child at child_index and becomes its parent
 inline
-void ast_move_node(Node* node, Node* new_parent, AST* ast)
+void ast_insert_between(Node_Id parent, msi child_index, Node_Id new_node, AST* ast)
 {
-    if(node->parent)
-    {
-        for(msi i = 0; i < ARR_LEN(node->parent->children); ++i)
-        {
-            if(node->parent->children[i] == node)
-            {
-                ARR_DEL(node->parent->children, i);
-                break;
-            }
-        }     
-    }
+    IR_ASSERT(parent != AST_NO_NODE);
+    IR_ASSERT(new_node != AST_NO_NODE);
     
-    if(new_parent)
+    Node_Id prev = AST_NO_NODE;
+    Node_Id child = ast_first_child(ast, parent);
+    for(msi i = 0; child && i < child_index; ++i)
     {
-        ast_node_add_child(new_parent, node, ast);
+        prev = child;
+        child = ast_next_sibling(ast, child);
     }
-}
-
-inline
-void ast_insert_between(Node* parent, msi child_index, Node* new_node, AST* ast)
-{
-    IR_NOT_NULL(parent);
-    IR_NOT_NULL(new_node);
-    if(parent->children)
+    
+    if(child)
     {
-        IR_ASSERT(child_index <= ARR_LEN(parent->children));
-        if(ARR_LEN(parent->children) > child_index)
+        Node* p = ast_node(ast, parent);
+        Node* c = ast_node(ast, child);
+        ast_node(ast, new_node)->next_sibling = c->next_sibling;
+        if(prev)
         {
-            Node* child = parent->children[child_index];
-            new_node->parent = parent;
-            parent->children[child_index] = new_node;
-            ast_node_add_child(new_node, child, ast);
+            ast_node(ast, prev)->next_sibling = new_node;
         }
         else
         {
-            ast_node_add_child(parent, new_node, ast);
+            p->first_child = new_node;
+        }
+        if(p->last_child == child)
+        {
+            p->last_child = new_node;
         }
+        ast_node_add_child(new_node, child, ast);
     }
     else
     {
-        IR_ASSERT(child_index == 0);
+        IR_ASSERT(ast_child_count(ast, parent) == child_index);
         ast_node_add_child(parent, new_node, ast);
     }
-    
-    
+}
+
+//Copies nodes that are used in place in an AST cache image to the heap, the image cannot grow
+static
+void ast_copy_mapped_nodes(AST* ast)
+{
+    msi count = ARR_LEN(ast->nodes);
+    Node* nodes = nullptr;
+    ARR_INIT(nodes, count + count / 2, ast->heap);
+    copy_buffer(IR_WRAP_INTO_BUFFER(ast->nodes, count * sizeof(Node)), IR_WRAP_INTO_BUFFER(ARR_ADD_N_PTR(nodes, count), count * sizeof(Node)));
+    ast->nodes = nodes;
+    ast->nodes_mapped = false;
 }
 
 inline
-Node* ast_create_node(Scope* scope, Token* t, AST* ast)
+Node_Id ast_create_node(Node_Type type, Token t, AST* ast)
 {
-    IR_NOT_NULL(scope);
-    Node* result;
+    Node_Id result;
     if(ast->node_free_list)
     {
         result = ast->node_free_list;
-        ast->node_free_list = ast->node_free_list->info.next_in_free_list;
+        ast->node_free_list = ast->nodes[result].next_sibling;
+        ast->nodes[result] = (Node){};
     }
     else
     {
-        result = BA_PUSH(ast->nodes_ba, (Node){}); 
+        if(ast->nodes_mapped)
+        {
+            ast_copy_mapped_nodes(ast);
+        }
+        result = (Node_Id)ARR_LEN(ast->nodes);
+        Node* node = ARR_PUSH(ast->nodes, (Node){});
+        IR_NOT_NULL(node);
     }
-    IR_NOT_NULL(result);
-    result->info.token = t;
-    result->scope = scope;
+    ast->nodes[result].type = type;
+    ast->nodes[result].info.token = t;
     return result;
 }
 
 inline 
-Function* ast_create_fun(Token* t, AST* ast)
+Function* ast_create_fun(Token t, AST* ast)
 {
-    Function* result = BA_PUSH(ast->functions_ba, (Function){});
+    Function* result = SLAB_ALLOC(Function, &ast->functions);
     IR_NOT_NULL(result);
     result->token = t;
-    ARR_INIT(result->params, 0, ast->heap);
     return result;
 }
 
+inline
+void scope_table_insert(Scope* scope, Variable* var)
+{
+    u32 slot = symbol_id_hash(var->name) & scope->table_mask;
+    while(scope->table[slot])
+    {
+        if(scope->table[slot]->name == var->name)
+        {
+            return; //Shadowed by the earlier declaration
+        }
+        slot = (slot + 1) & scope->table_mask;
+    }
+    scope->table[slot] = var;
+}
+
+static
+void scope_table_rebuild(Scope* scope, u32 capacity, AST* ast)
+{
+    DYN_FREE(scope->table, ast->heap);
+    scope->table = (Variable**)DYN_ZALLOC(capacity * sizeof(Variable*), ast->heap);
+    IR_NOT_NULL(scope->table);
+    scope->table_mask = capacity - 1;
+    for(Variable* var = scope->first_variable; var; var = var->next_in_scope)
+    {
+        scope_table_insert(scope, var);
+    }
+}
+
 inline 
-Variable* ast_create_var(Scope* scope, Token* t, AST* ast)
+Variable* ast_create_var(Scope* scope, Token t, Symbol_Id name, AST* ast)
 {
     IR_NOT_NULL(scope);
-    Variable* result = BA_PUSH(ast->variables_ba, (Variable){});
-    ARR_PUSH(scope->variables, result);
+    Variable* result = SLAB_ALLOC(Variable, &ast->variables);
     IR_NOT_NULL(result);
     result->scope = scope;
     result->token = t;
+    result->name = name;
+    if(scope->last_variable)
+    {
+        scope->last_variable->next_in_scope = result;
+    }
+    else
+    {
+        scope->first_variable = result;
+    }
+    scope->last_variable = result;
+    scope->variable_count++;
+    
+    if(scope->table && scope->variable_count * 2 <= scope->table_mask + 1)
+    {
+        scope_table_insert(scope, result);
+    }
+    else if(scope->variable_count >= SCOPE_TABLE_THRESHOLD)
+    {
+        scope_table_rebuild(scope, (u32)1 << u64_log2_rounded_up(scope->variable_count * 4), ast);
+    }
     return result;
 }
 
 inline 
 Scope* ast_create_scope(Scope* parent, AST* ast)
 {
-    Scope* result = BA_PUSH(ast->scopes_ba, (Scope){});
+    Scope* result = SLAB_ALLOC(Scope, &ast->scopes);
     IR_NOT_NULL(result);
     result->parent = parent;
-    ARR_INIT(result->variables, 0, ast->heap);
     return result;
 }
 
 
 inline
-Variable* ast_search_var_from_scope_and_name(String name, Scope* scope)
+Variable* ast_search_var_from_scope_and_name(Symbol_Id name, Scope* scope)
 {
     Variable* result = nullptr;
     while(scope)
     {
-        for(msi i = 0; i < ARR_LEN(scope->variables); ++i)
+        if(scope->table)
+        {
+            u32 slot = symbol_id_hash(name) & scope->table_mask;
+            for(Variable* var = scope->table[slot]; var; var = scope->table[slot])
+            {
+                if(var->name == name)
+                {
+                    result = var;
+                    return result;
+                }
+                slot = (slot + 1) & scope->table_mask;
+            }
+        }
+        else
         {
-            if(cmp_string(name, scope->variables[i]->name))
+            for(Variable* var = scope->first_variable; var; var = var->next_in_scope)
             {
-                result = scope->variables[i];
-                return result;
+                if(var->name == name)
+                {
+                    result = var;
+                    return result;
+                }
             }
         }
         
@@ -509,15 +762,21 @@ Variable* ast_search_var_from_scope_and_name(String name, Scope* scope)
 }
 
 
+//Puts the children of node (not their subtrees) into the free list
 inline
-void ast_remove_node(Node* node, AST* ast)
+void ast_remove_children(Node_Id node, AST* ast)
 {
-    if(node->parent)
+    Node* n = ast_node(ast, node);
+    Node_Id child = n->first_child;
+    n->first_child = AST_NO_NODE;
+    n->last_child = AST_NO_NODE;
+    while(child)
     {
-        ast_move_node(node, nullptr, ast);
+        Node_Id next = ast_next_sibling(ast, child);
+        ast_node(ast, child)->next_sibling = ast->node_free_list;
+        ast->node_free_list = child;
+        child = next;
     }
-    node->info.next_in_free_list = ast->node_free_list;
-    ast->node_free_list = node;
 }
 
 
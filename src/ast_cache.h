@@ -0,0 +1,692 @@
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+/*
+   Binary image of a typed AST, written once and mapped by later runs of the same source.
+   The sections hold the Node, Function, Variable and Scope structs, the scope tables and
+   the interner (table slots, Interned_Strings and their bytes) exactly as they are in
+   memory. Tokens keep pointing into the source file by offset. Every pointer is written
+   for the image being mapped at AST_CACHE_BASE: ast_cache_map maps it there and the
+   AST uses the sections in place, the nodes as its node array (they are copied to the
+   heap once the AST grows, see ast_create_node) and the Symbol_Ids stay valid as they
+   are. Loading only checks that every pointer and id stays inside its section, only if
+   the address is taken the pointers are moved by the distance in the same pass.
+   Scope tables and the interner are copied to the heap (they are freed or grown by
+   their owners) without hashing anything again.
+   The layout is the one of this build (sizes and version in the header), a cache from
+   another build or for another source length is refused, the caller parses again.
+   A 64 bit checksum over the whole image refuses damaged files as well, the section
+   checks keep images that match it from crashing a walk.
+   The image is not compact on purpose: sizeof(Node) (56) bytes per node, which are
+   nearly all of it, in return nothing is decoded. Packed nodes would have to be widened
+   into a new node array on every load, that alone costs more than mapping and checking.
+*/
+#define AST_CACHE_MAGIC 0x4854534D //"MSTH"
+#define AST_CACHE_VERSION 3
+#define AST_CACHE_ALIGNMENT 16
+#define AST_CACHE_BASE 0x200000000000ull //Far below the mmap area of 47 bit address spaces
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+struct AST_Cache_Header
+{
+    u32 magic;
+    u32 version;
+    u16 node_size;
+    u16 function_size;
+    u16 variable_size;
+    u16 scope_size;
+    u64 base;              //Address the pointers in the image were written for
+    u64 size;              //Bytes of the whole image
+    u64 file_length;       //Length of the source the tokens point into
+    u32 node_count;        //Including AST_NO_NODE
+    u32 function_count;
+    u32 variable_count;
+    u32 scope_count;
+    u32 table_entries;     //Slots of all scope tables
+    u32 symbol_count;
+    u32 interner_capacity; //Slots of the interner table
+    Node_Id root;
+    Node_Id node_free_list;
+    b8 has_error;
+    u64 global_scope;      //Pointer
+    u64 nodes;             //Offsets of the sections from the start of the image
+    u64 functions;
+    u64 variables;
+    u64 scopes;
+    u64 tables;
+    u64 interner_slots;
+    u64 symbols;
+    u64 strings;
+    u64 string_bytes;
+    u64 checksum;          //See ast_cache_hash_block, has to stay the last field
+};
+
+//Pointer field to the element with biased INDEX of the section at address SECTION
+#define AST_CACHE_POINTER(PTR, SECTION, INDEX) \
+((PTR) = (typeof(PTR))((INDEX) ? (SECTION) + ((msi)(INDEX) - 1) * sizeof(*(PTR)) : 0))
+
+/*
+   Pointer to biased index table used while writing an image, open addressing with
+   linear probing like the scope tables.
+*/
+struct AST_Cache_Refs
+{
+    void** keys;
+    u32* indices;
+    u32 mask;
+    u32 count;
+};
+
+static
+void ast_cache_init_refs(AST_Cache_Refs* refs, msi max_count, Heap_Allocator* heap)
+{
+    msi capacity = (msi)1 << u64_log2_rounded_up(max_count * 2 + 2);
+    refs->keys = (void**)DYN_ZALLOC(capacity * sizeof(void*), heap);
+    refs->indices = (u32*)DYN_ALLOC(capacity * sizeof(u32), heap);
+    IR_NOT_NULL(refs->keys);
+    IR_NOT_NULL(refs->indices);
+    refs->mask = (u32)capacity - 1;
+    refs->count = 0;
+}
+
+static
+void ast_cache_free_refs(AST_Cache_Refs* refs, Heap_Allocator* heap)
+{
+    DYN_FREE(refs->keys, heap);
+    DYN_FREE(refs->indices, heap);
+}
+
+inline
+u32 ast_cache_ref_slot(AST_Cache_Refs* refs, void* key)
+{
+    u32 slot = (u32)((((u64)key >> 3) * 0x9E3779B97F4A7C15ull) >> 32) & refs->mask;
+    while(refs->keys[slot] && refs->keys[slot] != key)
+    {
+        slot = (slot + 1) & refs->mask;
+    }
+    return slot;
+}
+
+//Biased index of key, 0 for nullptr or if key was never added
+inline
+u32 ast_cache_find_ref(AST_Cache_Refs* refs, void* key)
+{
+    if(!key)
+    {
+        return 0;
+    }
+    u32 slot = ast_cache_ref_slot(refs, key);
+    return refs->keys[slot] ? refs->indices[slot] : 0;
+}
+
+//Gives key the next index, false if it already has one
+inline
+b8 ast_cache_add_ref(AST_Cache_Refs* refs, void* key)
+{
+    u32 slot = ast_cache_ref_slot(refs, key);
+    if(refs->keys[slot])
+    {
+        return false;
+    }
+    IR_ASSERT(refs->count < refs->mask);
+    refs->keys[slot] = key;
+    refs->indices[slot] = ++refs->count;
+    return true;
+}
+
+static
+void ast_cache_add_scope(AST_Cache_Refs* refs, Scope*** scopes, Scope* scope)
+{
+    for(; scope && ast_cache_add_ref(refs, scope); scope = scope->parent)
+    {
+        ARR_PUSH(*scopes, scope);
+    }
+}
+
+/*
+   The checksum chains hash_bytes_128 over the header up to the checksum field and then
+   over blocks of the rest of the image, the seed of a block is the hash of the one
+   before. A load hashes the blocks of the nodes while it checks them.
+   ast_cache_hash_block hashes the block at *hashed.
+*/
+#define AST_CACHE_HASH_BLOCK IR_KILOBYTES(16)
+
+inline
+u64 ast_cache_hash_header(u8* data)
+{
+    return hash_bytes_128(String{sizeof(AST_Cache_Header) - sizeof(u64), data}, AST_CACHE_MAGIC).low;
+}
+
+inline
+u64 ast_cache_hash_block(u8* data, msi size, msi* hashed, u64 checksum)
+{
+    msi length = u64_min(AST_CACHE_HASH_BLOCK, size - *hashed);
+    checksum = hash_bytes_128(String{length, &data[*hashed]}, checksum).low;
+    *hashed += length;
+    return checksum;
+}
+
+inline
+msi ast_cache_align(msi offset)
+{
+    return (offset + AST_CACHE_ALIGNMENT - 1) & ~(msi)(AST_CACHE_ALIGNMENT - 1);
+}
+
+/*
+   Writes the image of ast into one allocation from ast->heap, *size gets its length.
+   Only scopes that can be reached from the global scope, a function or a variable of a
+   node are written, with all their variables.
+*/
+static
+u8* ast_cache_serialize(AST* ast, msi* size)
+{
+    IR_NOT_NULL(ast);
+    IR_NOT_NULL(size);
+    Heap_Allocator* heap = ast->heap;
+    msi node_count = ARR_LEN(ast->nodes);
+
+    //NOTE(Michael): used_slots bounds the objects of each kind, adopted slabs included
+    AST_Cache_Refs function_refs = {};
+    AST_Cache_Refs variable_refs = {};
+    AST_Cache_Refs scope_refs = {};
+    ast_cache_init_refs(&function_refs, ast->functions.used_slots, heap);
+    ast_cache_init_refs(&variable_refs, ast->variables.used_slots, heap);
+    ast_cache_init_refs(&scope_refs, ast->scopes.used_slots, heap);
+
+    Function** functions = nullptr;
+    Variable** variables = nullptr;
+    Scope** scopes = nullptr;
+    ARR_INIT(functions, 64, heap);
+    ARR_INIT(variables, 64, heap);
+    ARR_INIT(scopes, 64, heap);
+
+    ast_cache_add_scope(&scope_refs, &scopes, ast->global_scope);
+    for(msi i = 1; i < node_count; ++i)
+    {
+        Node* node = &ast->nodes[i];
+        if(node->type == N_FUNCTION && node->fun)
+        {
+            if(ast_cache_add_ref(&function_refs, node->fun))
+            {
+                ARR_PUSH(functions, node->fun);
+            }
+            ast_cache_add_scope(&scope_refs, &scopes, node->fun->scope);
+        }
+        else if((node->type == N_VAR || node->type == N_VAR_DECL) && node->var)
+        {
+            ast_cache_add_scope(&scope_refs, &scopes, node->var->scope);
+        }
+    }
+    for(msi s = 0; s < ARR_LEN(scopes); ++s)
+    {
+        for(Variable* var = scopes[s]->first_variable; var; var = var->next_in_scope)
+        {
+            ast_cache_add_ref(&variable_refs, var);
+            ARR_PUSH(variables, var);
+        }
+    }
+
+    msi table_entries = 0;
+    for(msi i = 0; i < ARR_LEN(scopes); ++i)
+    {
+        table_entries += scopes[i]->table ? scopes[i]->table_mask + 1 : 0;
+    }
+
+    Interner* symbols = ast->symbols;
+    u32 symbol_count = interner_count(symbols);
+    msi string_bytes = 0;
+    for(Symbol_Id id = 1; id <= symbol_count; ++id)
+    {
+        string_bytes += symbol_string(symbols, id).length;
+    }
+
+    AST_Cache_Header header = {};
+    header.magic = AST_CACHE_MAGIC;
+    header.version = AST_CACHE_VERSION;
+    header.node_size = sizeof(Node);
+    header.function_size = sizeof(Function);
+    header.variable_size = sizeof(Variable);
+    header.scope_size = sizeof(Scope);
+    header.base = AST_CACHE_BASE;
+    header.file_length = ast->file.length;
+    header.node_count = (u32)node_count;
+    header.function_count = (u32)ARR_LEN(functions);
+    header.variable_count = (u32)ARR_LEN(variables);
+    header.scope_count = (u32)ARR_LEN(scopes);
+    header.table_entries = (u32)table_entries;
+    header.symbol_count = symbol_count;
+    header.interner_capacity = symbols->table->mask + 1;
+    header.root = ast->root;
+    header.node_free_list = ast->node_free_list;
+    header.has_error = ast->has_error;
+    //NOTE(Michael): The nodes are preceded by the header of the dynamic array they become
+    header.nodes = ast_cache_align(sizeof(AST_Cache_Header) + sizeof(Dyn_Array_Header));
+    header.functions = ast_cache_align(header.nodes + node_count * sizeof(Node));
+    header.variables = ast_cache_align(header.functions + header.function_count * sizeof(Function));
+    header.scopes = ast_cache_align(header.variables + header.variable_count * sizeof(Variable));
+    header.tables = ast_cache_align(header.scopes + header.scope_count * sizeof(Scope));
+    header.interner_slots = ast_cache_align(header.tables + table_entries * sizeof(Variable*));
+    header.symbols = ast_cache_align(header.interner_slots + header.interner_capacity * sizeof(u64));
+    header.strings = ast_cache_align(header.symbols + symbol_count * sizeof(Interned_String));
+    header.string_bytes = string_bytes;
+    header.size = header.strings + string_bytes;
+
+    msi function_section = header.base + header.functions;
+    msi variable_section = header.base + header.variables;
+    msi scope_section = header.base + header.scopes;
+    u32 global_scope = ast_cache_find_ref(&scope_refs, ast->global_scope);
+    header.global_scope = global_scope ? scope_section + (global_scope - 1) * sizeof(Scope) : 0;
+
+    u8* result = (u8*)DYN_ZALLOC(header.size, heap);
+    IR_NOT_NULL(result);
+    *(AST_Cache_Header*)result = header;
+    *((Dyn_Array_Header*)&result[header.nodes] - 1) = {node_count, node_count, nullptr};
+
+    Node* out_nodes = (Node*)&result[header.nodes];
+    copy_buffer(IR_WRAP_INTO_BUFFER(ast->nodes, node_count * sizeof(Node)), IR_WRAP_INTO_BUFFER(out_nodes, node_count * sizeof(Node)));
+    for(msi i = 1; i < node_count; ++i)
+    {
+        Node* node = &out_nodes[i];
+        if(node->type == N_FUNCTION)
+        {
+            AST_CACHE_POINTER(node->fun, function_section, ast_cache_find_ref(&function_refs, node->fun));
+        }
+        else if(node->type == N_VAR || node->type == N_VAR_DECL)
+        {
+            AST_CACHE_POINTER(node->var, variable_section, ast_cache_find_ref(&variable_refs, node->var));
+        }
+    }
+
+    Function* out_functions = (Function*)&result[header.functions];
+    for(msi i = 0; i < header.function_count; ++i)
+    {
+        out_functions[i] = *functions[i];
+        AST_CACHE_POINTER(out_functions[i].scope, scope_section, ast_cache_find_ref(&scope_refs, functions[i]->scope));
+    }
+
+    Variable* out_variables = (Variable*)&result[header.variables];
+    for(msi i = 0; i < header.variable_count; ++i)
+    {
+        out_variables[i] = *variables[i];
+        AST_CACHE_POINTER(out_variables[i].scope, scope_section, ast_cache_find_ref(&scope_refs, variables[i]->scope));
+        AST_CACHE_POINTER(out_variables[i].next_in_scope, variable_section, ast_cache_find_ref(&variable_refs, variables[i]->next_in_scope));
+    }
+
+    Scope* out_scopes = (Scope*)&result[header.scopes];
+    Variable** out_tables = (Variable**)&result[header.tables];
+    msi table_section = header.base + header.tables;
+    msi table_offset = 0;
+    for(msi i = 0; i < header.scope_count; ++i)
+    {
+        Scope* scope = scopes[i];
+        out_scopes[i] = *scope;
+        AST_CACHE_POINTER(out_scopes[i].parent, scope_section, ast_cache_find_ref(&scope_refs, scope->parent));
+        AST_CACHE_POINTER(out_scopes[i].first_variable, variable_section, ast_cache_find_ref(&variable_refs, scope->first_variable));
+        AST_CACHE_POINTER(out_scopes[i].last_variable, variable_section, ast_cache_find_ref(&variable_refs, scope->last_variable));
+        out_scopes[i].table = nullptr;
+        if(scope->table)
+        {
+            out_scopes[i].table = (Variable**)(table_section + table_offset * sizeof(Variable*));
+            for(msi slot = 0; slot <= scope->table_mask; ++slot, ++table_offset)
+            {
+                AST_CACHE_POINTER(out_tables[table_offset], variable_section, ast_cache_find_ref(&variable_refs, scope->table[slot]));
+            }
+        }
+    }
+
+    copy_buffer(IR_WRAP_INTO_BUFFER(symbols->table->slots, header.interner_capacity * sizeof(u64)),
+                IR_WRAP_INTO_BUFFER(&result[header.interner_slots], header.interner_capacity * sizeof(u64)));
+    Interned_String* out_symbols = (Interned_String*)&result[header.symbols];
+    msi string_offset = 0;
+    for(Symbol_Id id = 1; id <= symbol_count; ++id)
+    {
+        Interned_String* symbol = interner_symbol(symbols, id);
+        out_symbols[id - 1] = {{symbol->string.length, (u8*)(header.base + header.strings + string_offset)}, symbol->hash};
+        copy_buffer(symbol->string, IR_WRAP_INTO_BUFFER(&result[header.strings + string_offset], symbol->string.length));
+        string_offset += symbol->string.length;
+    }
+
+    msi hashed = sizeof(AST_Cache_Header);
+    u64 checksum = ast_cache_hash_header(result);
+    while(hashed < header.size)
+    {
+        checksum = ast_cache_hash_block(result, header.size, &hashed, checksum);
+    }
+    ((AST_Cache_Header*)result)->checksum = checksum;
+
+    ARR_FREE(functions);
+    ARR_FREE(variables);
+    ARR_FREE(scopes);
+    ast_cache_free_refs(&function_refs, heap);
+    ast_cache_free_refs(&variable_refs, heap);
+    ast_cache_free_refs(&scope_refs, heap);
+
+    *size = header.size;
+    return result;
+}
+
+//Writes the image of ast to path, false if the file could not be written
+static
+b8 ast_cache_write(AST* ast, const c8* path)
+{
+    msi size = 0;
+    u8* image = ast_cache_serialize(ast, &size);
+
+    b8 result = false;
+    s32 fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd >= 0)
+    {
+        msi written = 0;
+        while(written < size)
+        {
+            ssize_t bytes = write(fd, &image[written], size - written);
+            if(bytes <= 0)
+            {
+                break;
+            }
+            written += bytes;
+        }
+        result = close(fd) == 0 && written == size;
+    }
+
+    DYN_FREE(image, ast->heap);
+    return result;
+}
+
+/*
+   Checks that the pointer in *ref (written for the image at header->base) is nullptr or
+   points to one of count elements of size bytes in the section that starts at address
+   section, then moves it by delta to where the image is.
+*/
+inline
+b8 ast_cache_link(void** ref, msi section, msi count, msi size, msi delta)
+{
+    msi offset = (msi)*ref - section;
+    if(!*ref)
+    {
+        return true;
+    }
+    if(offset >= count * size || offset % size)
+    {
+        return false;
+    }
+    if(delta)
+    {
+        *ref = (void*)((msi)*ref + delta);
+    }
+    return true;
+}
+
+//Pointer field of the image (see ast_cache_link), SECTION is the name of its header field
+#define AST_CACHE_LINK(REF, SECTION, COUNT) \
+ast_cache_link((void**)&(REF), header->base + header->SECTION, (COUNT), sizeof(*(REF)), delta)
+
+/*
+   Makes result use the image in data (size bytes, writable, 16 byte aligned) in place.
+   data has to outlive result, symbols has to be empty, file is the source the image was
+   written for. If data is not at the address the image was written for its pointers are
+   moved, otherwise only the header of the node array is written (copy on write mappings
+   stay shared). Returns false if the image does not belong to this build or file or is
+   damaged, data may be partially relocated by then but result, symbols and heap are
+   left as they were.
+*/
+static
+b8 ast_cache_load(u8* data, msi size, String file, Interner* symbols, Heap_Allocator* heap, AST* result)
+{
+    IR_NOT_NULL(data);
+    IR_NOT_NULL(symbols);
+    IR_NOT_NULL(heap);
+    IR_NOT_NULL(result);
+
+    AST_Cache_Header* header = (AST_Cache_Header*)data;
+    if(size < sizeof(AST_Cache_Header) || header->magic != AST_CACHE_MAGIC || header->version != AST_CACHE_VERSION ||
+       header->node_size != sizeof(Node) || header->function_size != sizeof(Function) ||
+       header->variable_size != sizeof(Variable) || header->scope_size != sizeof(Scope) ||
+       header->size != size || header->file_length != file.length || header->node_count == 0 ||
+       interner_count(symbols) != 0)
+    {
+        return false;
+    }
+    msi alignment = header->nodes | header->functions | header->variables | header->scopes |
+        header->tables | header->interner_slots | header->symbols | header->base;
+    if(alignment % AST_CACHE_ALIGNMENT != 0 ||
+       header->nodes < sizeof(AST_Cache_Header) + sizeof(Dyn_Array_Header) ||
+       header->nodes + (msi)header->node_count * sizeof(Node) > header->functions ||
+       header->functions + (msi)header->function_count * sizeof(Function) > header->variables ||
+       header->variables + (msi)header->variable_count * sizeof(Variable) > header->scopes ||
+       header->scopes + (msi)header->scope_count * sizeof(Scope) > header->tables ||
+       header->tables + (msi)header->table_entries * sizeof(Variable*) > header->interner_slots ||
+       header->interner_slots + (msi)header->interner_capacity * sizeof(u64) > header->symbols ||
+       header->symbols + (msi)header->symbol_count * sizeof(Interned_String) > header->strings ||
+       header->strings + header->string_bytes > size ||
+       header->root == AST_NO_NODE || header->root >= header->node_count ||
+       header->node_free_list >= header->node_count || header->node_free_list == header->root)
+    {
+        return false;
+    }
+
+    msi delta = (msi)data - header->base;
+    Function* functions = (Function*)&data[header->functions];
+    Variable* variables = (Variable*)&data[header->variables];
+    Scope* scopes = (Scope*)&data[header->scopes];
+    msi node_count = header->node_count;
+
+    //NOTE(Michael): The nodes are only read unless the image moved. The ids and indices are
+    //               checked once through their maxima instead of per field. Every node is the
+    //               first child or next sibling of at most one node and the root and the head of
+    //               the free list of none, otherwise a damaged image could make a walk loop.
+    //               var and fun share their place, the check picks the section by node type
+    //               without a branch. Only a tree with errors has names that were never declared.
+    //               Each block of the checksum is hashed right before its nodes are checked
+    Node* nodes = (Node*)&data[header->nodes];
+    msi var_section = header->base + header->variables;
+    msi fun_section = header->base + header->functions;
+    msi var_bytes = (msi)header->variable_count * sizeof(Variable);
+    msi fun_bytes = (msi)header->function_count * sizeof(Function);
+    msi max_id = 0;
+    msi max_type = 0;
+    u64* linked = (u64*)DYN_ZALLOC((node_count + 63) / 64 * sizeof(u64), heap);
+    IR_NOT_NULL(linked);
+    linked[header->root / 64] |= 1ull << (header->root % 64);
+    linked[header->node_free_list / 64] |= (u64)(header->node_free_list != AST_NO_NODE) << (header->node_free_list % 64);
+    u64 linked_twice = 0;
+    b8 bad_ref = false;
+    msi hashed = sizeof(AST_Cache_Header);
+    u64 checksum = ast_cache_hash_header(data);
+    for(msi i = 1; i < node_count; ++i)
+    {
+        Node* node = &nodes[i];
+        while(hashed < (msi)((u8*)(node + 1) - data))
+        {
+            checksum = ast_cache_hash_block(data, size, &hashed, checksum);
+        }
+        max_id = u64_max(max_id, u64_max(node->first_child, u64_max(node->last_child, node->next_sibling)));
+        max_type = u64_max(max_type, node->type);
+        Node_Id child = node->first_child < node_count ? node->first_child : AST_NO_NODE;
+        Node_Id sibling = node->next_sibling < node_count ? node->next_sibling : AST_NO_NODE;
+        u64 child_bit = (u64)(child != AST_NO_NODE) << (child % 64);
+        linked_twice |= linked[child / 64] & child_bit;
+        linked[child / 64] |= child_bit;
+        u64 sibling_bit = (u64)(sibling != AST_NO_NODE) << (sibling % 64);
+        linked_twice |= linked[sibling / 64] & sibling_bit;
+        linked[sibling / 64] |= sibling_bit;
+
+        b8 is_var = (node->type == N_VAR) | (node->type == N_VAR_DECL);
+        b8 is_fun = node->type == N_FUNCTION;
+        msi var_offset = (msi)node->var - var_section;
+        msi fun_offset = (msi)node->fun - fun_section;
+        b8 var_outside = (var_offset >= var_bytes) | (var_offset % sizeof(Variable) != 0);
+        b8 fun_outside = (fun_offset >= fun_bytes) | (fun_offset % sizeof(Function) != 0);
+        b8 missing = node->var == nullptr;
+        b8 bad_var = missing ? !header->has_error : var_outside;
+        b8 bad_fun = missing ? !header->has_error : fun_outside;
+        bad_ref |= (is_var & bad_var) | (is_fun & bad_fun);
+    }
+    DYN_FREE(linked, heap);
+    //NOTE(Michael): The rest is hashed before the links below move pointers in it
+    while(hashed < size)
+    {
+        checksum = ast_cache_hash_block(data, size, &hashed, checksum);
+    }
+    if(checksum != header->checksum || max_id >= node_count || max_type >= N_COUNT || linked_twice || bad_ref)
+    {
+        return false;
+    }
+
+    b8 valid = true;
+    for(msi i = 0; i < header->function_count; ++i)
+    {
+        valid &= AST_CACHE_LINK(functions[i].scope, scopes, header->scope_count) && functions[i].name <= header->symbol_count;
+    }
+    for(msi i = 0; i < header->variable_count; ++i)
+    {
+        valid &= AST_CACHE_LINK(variables[i].scope, scopes, header->scope_count) && variables[i].name <= header->symbol_count;
+        valid &= AST_CACHE_LINK(variables[i].next_in_scope, variables, header->variable_count);
+    }
+    msi table_entries = 0;
+    for(msi i = 0; i < header->scope_count; ++i)
+    {
+        Scope* scope = &scopes[i];
+        valid &= AST_CACHE_LINK(scope->parent, scopes, header->scope_count);
+        valid &= AST_CACHE_LINK(scope->first_variable, variables, header->variable_count);
+        valid &= AST_CACHE_LINK(scope->last_variable, variables, header->variable_count);
+        if(scope->table)
+        {
+            //NOTE(Michael): The tables follow each other in scope order as they were written, no slot is linked twice
+            msi table_size = (msi)scope->table_mask + 1;
+            b8 table_valid = (msi)scope->table == header->base + header->tables + table_entries * sizeof(Variable*) &&
+                table_entries + table_size <= header->table_entries;
+            table_valid = table_valid && AST_CACHE_LINK(scope->table, tables, header->table_entries);
+            for(msi slot = 0; table_valid && slot < table_size; ++slot)
+            {
+                Variable** entry = &scope->table[slot];
+                table_valid = AST_CACHE_LINK(*entry, variables, header->variable_count) && (!*entry || (*entry)->scope == scope);
+            }
+            valid &= table_valid;
+            table_entries += table_size;
+        }
+    }
+    Scope* global_scope = (Scope*)header->global_scope;
+    valid &= global_scope && AST_CACHE_LINK(global_scope, scopes, header->scope_count);
+
+    for(msi i = 1; valid && delta && i < node_count; ++i)
+    {
+        Node* node = &nodes[i];
+        if(node->type == N_VAR || node->type == N_VAR_DECL)
+        {
+            AST_CACHE_LINK(node->var, variables, header->variable_count);
+        }
+        else if(node->type == N_FUNCTION)
+        {
+            AST_CACHE_LINK(node->fun, functions, header->function_count);
+        }
+    }
+
+    //NOTE(Michael): intern trusts the hashes and the table, a damaged one would hide a symbol from lookups
+    Interned_String* cached_symbols = (Interned_String*)&data[header->symbols];
+    for(u32 i = 0; valid && i < header->symbol_count; ++i)
+    {
+        Interned_String* symbol = &cached_symbols[i];
+        msi offset = (msi)symbol->string.data - header->base - header->strings;
+        valid = offset <= header->string_bytes && symbol->string.length <= header->string_bytes - offset;
+        if(valid && delta)
+        {
+            symbol->string.data += delta;
+        }
+        valid = valid && symbol->hash == hash_short_string(symbol->string);
+    }
+    valid = valid && interner_load(symbols, cached_symbols, header->symbol_count,
+                                   (u64*)&data[header->interner_slots], header->interner_capacity);
+    if(!valid)
+    {
+        return false;
+    }
+
+    //NOTE(Michael): Everything is checked, nothing below can fail
+    *result = {};
+    result->heap = heap;
+    result->file = file;
+    result->lines = create_line_index(file, heap);
+    result->symbols = symbols;
+    result->root = header->root;
+    result->global_scope = global_scope;
+    result->node_free_list = header->node_free_list;
+    result->has_error = header->has_error;
+    SLAB_INIT(result->functions, Function, IR_KILOBYTES(16), heap);
+    SLAB_INIT(result->scopes, Scope, IR_KILOBYTES(16), heap);
+    SLAB_INIT(result->variables, Variable, IR_KILOBYTES(16), heap);
+    *((Dyn_Array_Header*)nodes - 1) = {node_count, node_count, heap};
+    result->nodes = nodes;
+    result->nodes_mapped = true;
+
+    //NOTE(Michael): scope_table_rebuild frees a table that gets too small, so tables are copied to the heap
+    for(msi i = 0; i < header->scope_count; ++i)
+    {
+        Scope* scope = &scopes[i];
+        if(scope->table)
+        {
+            msi table_size = ((msi)scope->table_mask + 1) * sizeof(Variable*);
+            Variable** table = (Variable**)DYN_ALLOC(table_size, heap);
+            IR_NOT_NULL(table);
+            copy_buffer(IR_WRAP_INTO_BUFFER(scope->table, table_size), IR_WRAP_INTO_BUFFER(table, table_size));
+            scope->table = table;
+        }
+    }
+    return true;
+}
+
+/*
+   Maps the image at path copy on write at the address it was written for, or anywhere
+   if that is taken, and loads it into result. mapping has to stay mapped as long as
+   result is used. False (and nothing mapped) if there is no usable image.
+*/
+static
+b8 ast_cache_map(const c8* path, String file, Interner* symbols, Heap_Allocator* heap, Mapped_File* mapping, AST* result)
+{
+    IR_NOT_NULL(mapping);
+    *mapping = {};
+    s32 fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    AST_Cache_Header header = {};
+    struct stat info;
+    u8* data = (u8*)MAP_FAILED;
+    if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+       header.magic == AST_CACHE_MAGIC && header.size == (msi)info.st_size)
+    {
+        //NOTE(Michael): Older kernels take the address as a hint and may map somewhere else
+        data = (u8*)mmap((void*)header.base, header.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED_NOREPLACE, fd, 0);
+        if(data != MAP_FAILED && data != (u8*)header.base)
+        {
+            munmap(data, header.size);
+            data = (u8*)MAP_FAILED;
+        }
+        if(data == MAP_FAILED)
+        {
+            data = (u8*)mmap(nullptr, header.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        }
+    }
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        return false;
+    }
+    mapping->content = String{header.size, data};
+    mapping->base = data;
+    mapping->mapped_size = ir_round_up_to_page(header.size);
+
+    b8 loaded = ast_cache_load(data, header.size, file, symbols, heap, result);
+    if(!loaded)
+    {
+        unmap_file(mapping);
+    }
+    return loaded;
+}
+
+#endif //AST_CACHE_H
@@ -0,0 +1,293 @@
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+/*
+   On disk cache of compile results, keyed by content. An entry is the AST image
+   (ast_cache.h) of the typed AST in <dir>/<key>.astc, the key is the 128 bit hash of
+   the source bytes seeded with COMPILER_VERSION and everything else that changes the
+   result (salts, e.g. the roots of -lazy).
+   Entries are written to a file of their own and renamed into place, readers never see
+   half an entry and concurrent compiles of the same source replace each other's entry.
+   A hit sets the mtime of its entry, after a store the least recently used entries are
+   removed until the entries take at most max_bytes. Hits, misses, stores and evictions
+   are counted in <dir>/stats under an flock, so they add up across processes.
+*/
+#define COMPILER_VERSION "mlang 0.1"
+#define COMPILE_CACHE_EXTENSION ".astc"
+#define COMPILE_CACHE_TMP_EXTENSION ".tmp"
+#define COMPILE_CACHE_PATH_SIZE 4096
+#define COMPILE_CACHE_STALE_TMP_SECONDS 600 //Temporary files of writers that died
+
+struct Compile_Cache
+{
+    const c8* dir;
+    msi max_bytes;
+    Hash_128 key;
+    c8 entry_path[COMPILE_CACHE_PATH_SIZE];
+};
+
+struct Compile_Cache_Stats
+{
+    u64 hits;
+    u64 misses;
+    u64 stores;
+    u64 evictions;
+    u64 entries;  //Only filled by compile_cache_stats
+    u64 bytes;
+};
+
+struct Compile_Cache_Entry
+{
+    c8 name[256];
+    u64 size;
+    timespec mtime;
+};
+
+//Creates dir if it does not exist, false if it cannot be used
+static
+b8 compile_cache_init(Compile_Cache* cache, const c8* dir, msi max_bytes)
+{
+    IR_NOT_NULL(cache);
+    IR_NOT_NULL(dir);
+    *cache = {};
+    cache->dir = dir;
+    cache->max_bytes = max_bytes;
+
+    if(mkdir(dir, 0755) != 0 && errno != EEXIST)
+    {
+        return false;
+    }
+    struct stat info;
+    return stat(dir, &info) == 0 && S_ISDIR(info.st_mode) && strlen(dir) + 64 < COMPILE_CACHE_PATH_SIZE;
+}
+
+//Key and entry path of file, the salts are hashed in order into the seed
+static
+void compile_cache_key(Compile_Cache* cache, String file, String* salts, u32 salt_count)
+{
+    u64 seed = hash_string(wrap_asciiz((c8*)COMPILER_VERSION)) ^ AST_CACHE_VERSION;
+    for(u32 i = 0; i < salt_count; ++i)
+    {
+        seed = hash_bytes_128(salts[i], seed).low;
+    }
+    cache->key = hash_bytes_128(file, seed);
+    snprintf(cache->entry_path, COMPILE_CACHE_PATH_SIZE, "%s/%016llx%016llx" COMPILE_CACHE_EXTENSION,
+             cache->dir, (unsigned long long)cache->key.high, (unsigned long long)cache->key.low);
+}
+
+//Adds delta to the counters in <dir>/stats, returns the counters after the update
+static
+Compile_Cache_Stats compile_cache_update_stats(Compile_Cache* cache, Compile_Cache_Stats delta)
+{
+    Compile_Cache_Stats result = {};
+    c8 path[COMPILE_CACHE_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s/stats", cache->dir);
+    s32 fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd < 0)
+    {
+        return result;
+    }
+    flock(fd, LOCK_EX);
+
+    c8 text[256] = {};
+    ssize_t length = pread(fd, text, sizeof(text) - 1, 0);
+    if(length > 0)
+    {
+        unsigned long long values[4] = {};
+        sscanf(text, "hits %llu misses %llu stores %llu evictions %llu", &values[0], &values[1], &values[2], &values[3]);
+        result.hits = values[0];
+        result.misses = values[1];
+        result.stores = values[2];
+        result.evictions = values[3];
+    }
+
+    result.hits += delta.hits;
+    result.misses += delta.misses;
+    result.stores += delta.stores;
+    result.evictions += delta.evictions;
+    if(delta.hits || delta.misses || delta.stores || delta.evictions)
+    {
+        s32 written = snprintf(text, sizeof(text), "hits %llu misses %llu stores %llu evictions %llu\n",
+                               (unsigned long long)result.hits, (unsigned long long)result.misses,
+                               (unsigned long long)result.stores, (unsigned long long)result.evictions);
+        if(ftruncate(fd, 0) == 0)
+        {
+            pwrite(fd, text, written, 0);
+        }
+    }
+
+    flock(fd, LOCK_UN);
+    close(fd);
+    return result;
+}
+
+static
+b8 compile_cache_has_extension(const c8* name, const c8* extension)
+{
+    msi length = strlen(name);
+    msi extension_length = strlen(extension);
+    return length > extension_length && strcmp(&name[length - extension_length], extension) == 0;
+}
+
+static
+int compile_cache_compare_entries(const void* a, const void* b)
+{
+    timespec x = ((Compile_Cache_Entry*)a)->mtime;
+    timespec y = ((Compile_Cache_Entry*)b)->mtime;
+    if(x.tv_sec != y.tv_sec)
+    {
+        return x.tv_sec < y.tv_sec ? -1 : 1;
+    }
+    return x.tv_nsec < y.tv_nsec ? -1 : x.tv_nsec > y.tv_nsec;
+}
+
+//Entries of the directory, oldest first, also removes stale temporary files
+static
+Compile_Cache_Entry* compile_cache_list(Compile_Cache* cache, Heap_Allocator* heap)
+{
+    Compile_Cache_Entry* result = nullptr;
+    ARR_INIT(result, 64, heap);
+    DIR* dir = opendir(cache->dir);
+    if(!dir)
+    {
+        return result;
+    }
+
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    c8 path[COMPILE_CACHE_PATH_SIZE];
+    for(dirent* file = readdir(dir); file; file = readdir(dir))
+    {
+        b8 is_entry = compile_cache_has_extension(file->d_name, COMPILE_CACHE_EXTENSION);
+        b8 is_tmp = compile_cache_has_extension(file->d_name, COMPILE_CACHE_TMP_EXTENSION);
+        if((!is_entry && !is_tmp) || strlen(file->d_name) >= sizeof(result->name))
+        {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", cache->dir, file->d_name);
+        struct stat info;
+        if(stat(path, &info) != 0)
+        {
+            continue; //Evicted by another process in the meantime
+        }
+        if(is_tmp)
+        {
+            if(now.tv_sec - info.st_mtim.tv_sec > COMPILE_CACHE_STALE_TMP_SECONDS)
+            {
+                unlink(path);
+            }
+            continue;
+        }
+
+        Compile_Cache_Entry entry = {};
+        strcpy(entry.name, file->d_name);
+        entry.size = info.st_size;
+        entry.mtime = info.st_mtim;
+        ARR_PUSH(result, entry);
+    }
+    closedir(dir);
+
+    qsort(result, ARR_LEN(result), sizeof(Compile_Cache_Entry), compile_cache_compare_entries);
+    return result;
+}
+
+//Removes the least recently used entries until they take at most max_bytes, never the current one
+static
+u64 compile_cache_evict(Compile_Cache* cache, Heap_Allocator* heap)
+{
+    Compile_Cache_Entry* entries = compile_cache_list(cache, heap);
+    u64 total = 0;
+    for(msi i = 0; i < ARR_LEN(entries); ++i)
+    {
+        total += entries[i].size;
+    }
+
+    u64 result = 0;
+    c8 path[COMPILE_CACHE_PATH_SIZE];
+    for(msi i = 0; i < ARR_LEN(entries) && total > cache->max_bytes; ++i)
+    {
+        snprintf(path, sizeof(path), "%s/%s", cache->dir, entries[i].name);
+        if(strcmp(path, cache->entry_path) == 0)
+        {
+            continue;
+        }
+        if(unlink(path) == 0)
+        {
+            ++result;
+        }
+        total -= entries[i].size;
+    }
+
+    ARR_FREE(entries);
+    return result;
+}
+
+/*
+   Maps the entry of the current key into result (see ast_cache_map), mapping has to stay
+   mapped as long as result is used. symbols has to be empty and is not after a failed
+   load of a damaged entry.
+*/
+static
+b8 compile_cache_lookup(Compile_Cache* cache, String file, Interner* symbols, Heap_Allocator* heap, Mapped_File* mapping, AST* result)
+{
+    Compile_Cache_Stats delta = {};
+    b8 hit = ast_cache_map(cache->entry_path, file, symbols, heap, mapping, result);
+    if(hit)
+    {
+        //NOTE(Michael): mtime is the time of the last use, atime is not updated on most mounts
+        utimensat(AT_FDCWD, cache->entry_path, nullptr, 0);
+        delta.hits = 1;
+    }
+    else
+    {
+        delta.misses = 1;
+    }
+    compile_cache_update_stats(cache, delta);
+    return hit;
+}
+
+//Writes ast as the entry of the current key, then evicts, false if it could not be written
+static
+b8 compile_cache_store(Compile_Cache* cache, AST* ast)
+{
+    c8 tmp_path[COMPILE_CACHE_PATH_SIZE + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d" COMPILE_CACHE_TMP_EXTENSION, cache->entry_path, (s32)getpid());
+
+    Compile_Cache_Stats delta = {};
+    b8 result = ast_cache_write(ast, tmp_path) && rename(tmp_path, cache->entry_path) == 0;
+    if(result)
+    {
+        delta.stores = 1;
+        delta.evictions = compile_cache_evict(cache, ast->heap);
+    }
+    else
+    {
+        unlink(tmp_path);
+    }
+    compile_cache_update_stats(cache, delta);
+    return result;
+}
+
+//Counters of all processes that used the directory plus the entries in it right now
+static
+Compile_Cache_Stats compile_cache_stats(Compile_Cache* cache, Heap_Allocator* heap)
+{
+    Compile_Cache_Stats result = compile_cache_update_stats(cache, {});
+    Compile_Cache_Entry* entries = compile_cache_list(cache, heap);
+    result.entries = ARR_LEN(entries);
+    for(msi i = 0; i < ARR_LEN(entries); ++i)
+    {
+        result.bytes += entries[i].size;
+    }
+    ARR_FREE(entries);
+    return result;
+}
+
+#endif //COMPILE_CACHE_H
@@ -182,12 +182,31 @@ arr_header((arr))->length+=(n), arr_header((arr))->length-(n))
 
 
 
+/* DOCUMENTATION MSL BUCKET ARRAYS
+ *
+ * Elements never move once pushed, pointers to them stay valid until BA_FREE.
+ * Bucket sizes are powers of two (rounded up) so an index is split with shift and mask.
+ * In geometric mode (BA_INIT_GEOMETRIC) bucket i holds bucket_size << i elements,
+ * the array needs few buckets however long it gets and an index is decoded with intr_bsr.
+ * The compiler itself keeps its AST in slabs (Slab_Allocator), bench_bucket_array is the
+ * only user of both modes in this repo.
+ *
+ * Iterate bucket wise instead of calling BA_GET for every index:
+ *  for(msi b = 0; b < BA_BUCKET_COUNT(foo); ++b)
+ *  {
+ *      msi count;
+ *      T* elements = BA_BUCKET(foo, b, &count);
+ *      for(msi i = 0; i < count; ++i) ... elements[i] ...
+ *  }
+*/
 struct Bucket_Array_Header
 {
     msi length;
-    msi bucket_size;
+    msi bucket_size;    //Elements in the first bucket, a power of two
     u8** buckets;
     Heap_Allocator* heap;
+    u8 bucket_shift;    //log2(bucket_size)
+    b8 geometric;
 };
 
 
@@ -197,9 +216,23 @@ Bucket_Array_Header* ba_header(void* ba)
     return (Bucket_Array_Header*)ba;
 }
 
+inline
+msi ba_bucket_capacity(Bucket_Array_Header* header, msi bucket_index)
+{
+    return header->geometric ? header->bucket_size << bucket_index : header->bucket_size;
+}
 
+//Index of the first element in bucket_index
 inline
-void* init_ba_helper(void* ba, msi elem_size, msi bucket_size, Heap_Allocator* heap)
+msi ba_bucket_first_index(Bucket_Array_Header* header, msi bucket_index)
+{
+    return header->geometric ? (header->bucket_size << bucket_index) - header->bucket_size :
+        bucket_index << header->bucket_shift;
+}
+
+
+inline
+void* init_ba_helper(void* ba, msi elem_size, msi bucket_size, b8 geometric, Heap_Allocator* heap)
 {
     IR_ASSERT(ba==nullptr);
     IR_ASSERT(bucket_size!=0);
@@ -208,8 +241,11 @@ void* init_ba_helper(void* ba, msi elem_size, msi bucket_size, Heap_Allocator* h
     
     if(result)
     {
+        bucket_size = u64_get_nearest_higher_or_equal_pow2(bucket_size);
         result->length = 0;
         result->bucket_size = bucket_size;
+        result->bucket_shift = (u8)intr_bsr(bucket_size);
+        result->geometric = geometric;
         result->heap = heap;
         result->buckets = nullptr;
         
@@ -245,19 +281,16 @@ inline
 b8 free_ba_helper(void* ba)
 {
     Bucket_Array_Header* header = ba_header(ba);
-    b8 result = true;
+    Heap_Allocator* heap = header->heap;
+    //NOTE(Michael): heap_free always returns nullptr, there is no failure to check for
     for(msi i = 0; i < ARR_LEN(header->buckets); ++i)
     {
-        result = DYN_FREE(header->buckets[i], header->heap);
-        IR_ASSERT(result && "Bucket List Free is failing to free the individual buckets!");
+        DYN_FREE(header->buckets[i], heap);
     }
-    result = ARR_FREE(header->buckets);
-    IR_ASSERT(result && "Bucket List Free is failing to free the list of bucket pointers!");
-    
-    result = DYN_FREE(header, header->heap);
-    IR_ASSERT(result && "Bucket List Free is failing to free the header!");
+    ARR_FREE(header->buckets);
+    DYN_FREE(header, heap);
         
-    return result;
+    return true;
 }
 
 inline
@@ -266,9 +299,10 @@ b8 ba_maybe_growth_helper(void* ba, msi elem_size)
     IR_NOT_NULL(ba);
     Bucket_Array_Header* header = ba_header(ba);
     
-    if(header->length == (ARR_LEN(header->buckets) * header->bucket_size))
+    msi bucket_count = ARR_LEN(header->buckets);
+    if(header->length == ba_bucket_first_index(header, bucket_count))
     {
-        u8* new_bucket = (u8*)DYN_ALLOC(elem_size * header->bucket_size, header->heap);
+        u8* new_bucket = (u8*)DYN_ALLOC(elem_size * ba_bucket_capacity(header, bucket_count), header->heap);
         if(!new_bucket)
         {
             IR_SOFT_ASSERT(false && "Bucket List failed allocate new space for elements!");
@@ -292,13 +326,40 @@ void* ba_get_helper(void* ba, msi elem_size, msi index)
     IR_NOT_NULL(ba);
     Bucket_Array_Header* header = ba_header(ba);
     //IR_ASSERT(index>=header->length && "Out of bounds access to bucket list!");
-    msi bucket_index = index/header->bucket_size;
-    msi in_bucket_index = index%header->bucket_size;
+    msi bucket_index;
+    msi in_bucket_index;
+    if(header->geometric)
+    {
+        //NOTE(Michael): Bucket i starts at bucket_size * (2^i - 1), shifting by bucket_size makes that a power of two
+        msi shifted = index + header->bucket_size;
+        msi top_bit = intr_bsr(shifted);
+        bucket_index = top_bit - header->bucket_shift;
+        in_bucket_index = shifted - ((msi)1 << top_bit);
+    }
+    else
+    {
+        bucket_index = index >> header->bucket_shift;
+        in_bucket_index = index & (header->bucket_size - 1);
+    }
     
     return &header->buckets[bucket_index][in_bucket_index*elem_size];
 }
 
-#define BA_INIT(ba, bucket_size, heap_ptr)(ba = ((typeof(ba))init_ba_helper(ba, sizeof(*(ba)), (bucket_size), (heap_ptr))))
+//Start of bucket bucket_index, *count is set to the number of elements in use in it
+inline
+void* ba_bucket_helper(void* ba, msi bucket_index, msi* count)
+{
+    IR_NOT_NULL(ba);
+    Bucket_Array_Header* header = ba_header(ba);
+    IR_ASSERT(bucket_index < ARR_LEN(header->buckets));
+    msi first = ba_bucket_first_index(header, bucket_index);
+    msi capacity = ba_bucket_capacity(header, bucket_index);
+    *count = header->length <= first ? 0 : u64_min(header->length - first, capacity);
+    return header->buckets[bucket_index];
+}
+
+#define BA_INIT(ba, bucket_size, heap_ptr)(ba = ((typeof(ba))init_ba_helper(ba, sizeof(*(ba)), (bucket_size), false, (heap_ptr))))
+#define BA_INIT_GEOMETRIC(ba, first_bucket_size, heap_ptr)(ba = ((typeof(ba))init_ba_helper(ba, sizeof(*(ba)), (first_bucket_size), true, (heap_ptr))))
 #define BA_DEL_ALL(ba)(ba_header(ba)->length=0)
 #define BA_FREE(ba)(free_ba_helper((ba)) ? ((ba)=nullptr, true) : ((ba)=nullptr, false))
 #define BA_LEN_S(ba)((s64)ba_header((ba))->length)
@@ -306,4 +367,6 @@ void* ba_get_helper(void* ba, msi elem_size, msi index)
 #define BA_GET(ba, index) ((typeof((ba)))ba_get_helper((ba), sizeof(*(ba)), (index)))
 #define BA_PUSH(ba, elem)((ba_maybe_growth_helper((ba), sizeof(*(ba)))) ? \
 &(*((typeof((ba)))ba_get_helper(ba, sizeof((*ba)), ba_header(ba)->length++)) = (elem)) : nullptr)
-#define BA_LAST(ba) ((typeof(*(ba)))ba_get_helper((ba), sizeof(*(ba)), ba_header(ba)->length-1))
\ No newline at end of file
+#define BA_LAST(ba) ((typeof(*(ba)))ba_get_helper((ba), sizeof(*(ba)), ba_header(ba)->length-1))
+#define BA_BUCKET_COUNT(ba) ((msi)ARR_LEN(ba_header((ba))->buckets))
+#define BA_BUCKET(ba, bucket_index, count_ptr) ((typeof((ba)))ba_bucket_helper((ba), (bucket_index), (count_ptr)))
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ir_types.h"
+#include "ir_memory.h"
+
+#ifndef IR_ASSERT
+#define IR_ASSERT(ASSERT)
+#define IR_NOT_NULL(PTR)
+#define IR_INVALID_CASE
+#define IR_SOFT_ASSERT(ASSERT)
+#endif
+
+/*
+   A file mapped read only into memory. content is followed by at least the
+   requested padding of readable zero bytes, so scanners can look a few bytes past
+   the end without bounds checks.
+   Regular files are mapped with mmap over a reserved anonymous range, the pages
+   behind the file stay anonymous zero pages. Everything else (pipes, ttys) is read
+   into an anonymous mapping.
+*/
+struct Mapped_File
+{
+    String content;
+    void* base;
+    msi mapped_size;
+};
+
+static b8 map_file(const c8* path, msi padding, Mapped_File* result);
+static void unmap_file(Mapped_File* file);
+
+
+inline
+msi ir_page_size()
+{
+    static msi page_size = 0;
+    if(!page_size)
+    {
+        page_size = (msi)sysconf(_SC_PAGESIZE);
+    }
+    return page_size;
+}
+
+inline
+msi ir_round_up_to_page(msi size)
+{
+    msi page = ir_page_size();
+    return (size + page - 1) & ~(page - 1);
+}
+
+static
+b8 map_file_by_reading(s32 fd, msi padding, Mapped_File* result)
+{
+    msi capacity = ir_round_up_to_page(IR_KILOBYTES(64) + padding);
+    u8* data = (u8*)mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    msi length = 0;
+    for(;;)
+    {
+        if(length + padding == capacity)
+        {
+            msi new_capacity = capacity * 2;
+            u8* new_data = (u8*)mremap(data, capacity, new_capacity, MREMAP_MAYMOVE);
+            if(new_data == MAP_FAILED)
+            {
+                munmap(data, capacity);
+                return false;
+            }
+            data = new_data;
+            capacity = new_capacity;
+        }
+
+        ssize_t read_bytes = read(fd, &data[length], capacity - padding - length);
+        if(read_bytes < 0)
+        {
+            munmap(data, capacity);
+            return false;
+        }
+        if(read_bytes == 0)
+        {
+            break;
+        }
+        length += read_bytes;
+    }
+
+    mprotect(data, capacity, PROT_READ);
+    result->content = String{length, data};
+    result->base = data;
+    result->mapped_size = capacity;
+    return true;
+}
+
+//Returns false if path cannot be opened or mapped
+static
+b8 map_file(const c8* path, msi padding, Mapped_File* result)
+{
+    IR_NOT_NULL(result);
+    *result = {};
+
+    s32 fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    if(!S_ISREG(info.st_mode))
+    {
+        b8 success = map_file_by_reading(fd, padding, result);
+        close(fd);
+        return success;
+    }
+
+    msi length = (msi)info.st_size;
+    msi mapped_size = ir_round_up_to_page(length + padding);
+
+    //NOTE(Michael): Reserve the whole range first, the file is mapped over its front
+    u8* base = (u8*)mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+
+    if(length)
+    {
+        void* mapped = mmap(base, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        if(mapped == MAP_FAILED)
+        {
+            munmap(base, mapped_size);
+            close(fd);
+            return false;
+        }
+        madvise(base, length, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    result->content = String{length, base};
+    result->base = base;
+    result->mapped_size = mapped_size;
+    return true;
+}
+
+static
+void unmap_file(Mapped_File* file)
+{
+    if(file->base)
+    {
+        munmap(file->base, file->mapped_size);
+    }
+    *file = {};
+}
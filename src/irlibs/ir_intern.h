@@ -0,0 +1,352 @@
+#pragma once
+
+#include "ir_types.h"
+#include "ir_maths.h"
+#include "ir_memory.h"
+#include "ir_string.h"
+
+#ifndef IR_ASSERT
+#define IR_ASSERT(ASSERT)
+#define IR_NOT_NULL(PTR)
+#define IR_INVALID_CASE
+#define IR_SOFT_ASSERT(ASSERT)
+#endif
+
+/*
+   String interner, every distinct string gets a dense u32 Symbol_Id starting at 1,
+   SYMBOL_NONE (0) is never handed out. Per symbol data can live in flat arrays indexed
+   by the id. The bytes are copied into blocks of the interner, a symbol's string stays
+   valid until free_interner.
+
+   One interner can be shared by threads. Finding a string that is already interned
+   takes no lock: the table slots hold (id << 32 | hash) and are read with acquire
+   loads. Inserts serialize through lock, write the symbol before its slot is
+   published with a release store, and a grown table replaces the old one in one
+   atomic store. Old tables stay allocated until free_interner so a reader never
+   probes freed memory. Symbols live in chunks that never move, chunk i holds
+   INTERNER_FIRST_CHUNK << i of them.
+   The heap has to be thread safe while threads intern new strings.
+*/
+typedef u32 Symbol_Id;
+#define SYMBOL_NONE 0
+
+#define INTERNER_FIRST_CHUNK_SHIFT 8
+#define INTERNER_FIRST_CHUNK (1 << INTERNER_FIRST_CHUNK_SHIFT)
+#define INTERNER_MAX_CHUNKS 24
+#define INTERNER_BLOCK_SIZE IR_KILOBYTES(64)
+
+struct Interned_String
+{
+    String string;
+    u32 hash;
+};
+
+struct Interner_Table
+{
+    Interner_Table* retired; //The table this one replaced
+    u32 mask;
+    u64 slots[1];
+};
+
+struct Interner
+{
+    Heap_Allocator* heap;
+    Interner_Table* table;
+    Interned_String* chunks[INTERNER_MAX_CHUNKS];
+    u32 count;
+    Memory_Arena bytes;  //Current block for the copied strings
+    Buffer* blocks;
+    b8 lock;
+};
+
+static Interner create_interner(Heap_Allocator* heap);
+static void free_interner(Interner* interner);
+static Symbol_Id intern(Interner* interner, String string, u32 hash);
+static Symbol_Id intern(Interner* interner, String string);
+static Symbol_Id interner_find(Interner* interner, String string, u32 hash);
+static b8 interner_load(Interner* interner, Interned_String* symbols, u32 count, u64* slots, u32 capacity);
+inline String symbol_string(Interner* interner, Symbol_Id id);
+inline u32 symbol_hash(Interner* interner, Symbol_Id id);
+inline u32 interner_count(Interner* interner);
+
+
+//Fibonacci hashing, ids are dense so the multiply spreads them over a table well enough
+inline
+u32 symbol_id_hash(Symbol_Id id)
+{
+    return id * 0x9e3779b1u;
+}
+
+inline
+Interned_String* interner_symbol(Interner* interner, Symbol_Id id)
+{
+    IR_ASSERT(id != SYMBOL_NONE);
+    //NOTE(Michael): Chunk i starts at FIRST * (2^i - 1), same decoding as geometric bucket arrays
+    msi shifted = (msi)id - 1 + INTERNER_FIRST_CHUNK;
+    msi top_bit = intr_bsr(shifted);
+    Interned_String* chunk = __atomic_load_n(&interner->chunks[top_bit - INTERNER_FIRST_CHUNK_SHIFT], __ATOMIC_ACQUIRE);
+    return &chunk[shifted - ((msi)1 << top_bit)];
+}
+
+inline
+String symbol_string(Interner* interner, Symbol_Id id)
+{
+    return interner_symbol(interner, id)->string;
+}
+
+inline
+u32 symbol_hash(Interner* interner, Symbol_Id id)
+{
+    return interner_symbol(interner, id)->hash;
+}
+
+inline
+u32 interner_count(Interner* interner)
+{
+    return __atomic_load_n(&interner->count, __ATOMIC_ACQUIRE);
+}
+
+static
+Interner_Table* interner_create_table(u32 capacity, Heap_Allocator* heap)
+{
+    Interner_Table* result = (Interner_Table*)DYN_ZALLOC(sizeof(Interner_Table) + (capacity - 1) * sizeof(u64), heap);
+    IR_NOT_NULL(result);
+    result->mask = capacity - 1;
+    return result;
+}
+
+static
+Interner create_interner(Heap_Allocator* heap)
+{
+    IR_NOT_NULL(heap);
+    Interner result = {};
+    result.heap = heap;
+    result.table = interner_create_table(1024, heap);
+    ARR_INIT(result.blocks, 4, heap);
+    return result;
+}
+
+static
+void free_interner(Interner* interner)
+{
+    Interner_Table* table = interner->table;
+    while(table)
+    {
+        Interner_Table* retired = table->retired;
+        DYN_FREE(table, interner->heap);
+        table = retired;
+    }
+    for(msi i = 0; i < INTERNER_MAX_CHUNKS; ++i)
+    {
+        DYN_FREE(interner->chunks[i], interner->heap);
+    }
+    for(msi i = 0; i < ARR_LEN(interner->blocks); ++i)
+    {
+        DYN_FREE(interner->blocks[i].data, interner->heap);
+    }
+    ARR_FREE(interner->blocks);
+    *interner = {};
+}
+
+//Returns the id of string in table or SYMBOL_NONE and the empty slot where it would go
+static
+Symbol_Id interner_probe(Interner* interner, Interner_Table* table, String string, u32 hash, u32* empty_slot)
+{
+    u32 slot = hash & table->mask;
+    for(;;)
+    {
+        u64 entry = __atomic_load_n(&table->slots[slot], __ATOMIC_ACQUIRE);
+        if(!entry)
+        {
+            *empty_slot = slot;
+            return SYMBOL_NONE;
+        }
+        if((u32)entry == hash)
+        {
+            Symbol_Id id = (Symbol_Id)(entry >> 32);
+            if(cmp_string(interner_symbol(interner, id)->string, string))
+            {
+                return id;
+            }
+        }
+        slot = (slot + 1) & table->mask;
+    }
+}
+
+//Only called with lock held
+static
+void interner_grow_table(Interner* interner)
+{
+    Interner_Table* old_table = interner->table;
+    Interner_Table* new_table = interner_create_table((old_table->mask + 1) * 2, interner->heap);
+    for(u32 i = 0; i <= old_table->mask; ++i)
+    {
+        u64 entry = old_table->slots[i];
+        if(entry)
+        {
+            u32 slot = (u32)entry & new_table->mask;
+            while(new_table->slots[slot])
+            {
+                slot = (slot + 1) & new_table->mask;
+            }
+            new_table->slots[slot] = entry;
+        }
+    }
+    new_table->retired = old_table;
+    __atomic_store_n(&interner->table, new_table, __ATOMIC_RELEASE);
+}
+
+//Only called with lock held
+static
+String interner_copy_string(Interner* interner, String string)
+{
+    Memory_Arena* bytes = &interner->bytes;
+    if(!bytes->buffer.data || bytes->current_base + string.length > bytes->buffer.data + bytes->buffer.length)
+    {
+        msi size = u64_max(string.length, INTERNER_BLOCK_SIZE);
+        bytes->buffer.data = (u8*)DYN_ALLOC(size, interner->heap);
+        IR_NOT_NULL(bytes->buffer.data);
+        bytes->buffer.length = size;
+        bytes->current_base = bytes->buffer.data;
+        ARR_PUSH(interner->blocks, bytes->buffer);
+    }
+    String result = {string.length, bytes->current_base};
+    copy_buffer(string, result);
+    bytes->current_base += string.length;
+    return result;
+}
+
+//Returns SYMBOL_NONE if string was never interned
+static
+Symbol_Id interner_find(Interner* interner, String string, u32 hash)
+{
+    u32 empty_slot;
+    Interner_Table* table = __atomic_load_n(&interner->table, __ATOMIC_ACQUIRE);
+    return interner_probe(interner, table, string, hash, &empty_slot);
+}
+
+//hash has to be hash_short_string(string), the lexer computes it while scanning
+static
+Symbol_Id intern(Interner* interner, String string, u32 hash)
+{
+    Symbol_Id result = interner_find(interner, string, hash);
+    if(result)
+    {
+        return result;
+    }
+
+    while(__atomic_test_and_set(&interner->lock, __ATOMIC_ACQUIRE))
+    {
+#ifndef IR_ARCH_ARM
+        __builtin_ia32_pause();
+#endif
+    }
+
+    //NOTE(Michael): Another thread may have added it or grown the table since the lookup
+    u32 slot;
+    result = interner_probe(interner, interner->table, string, hash, &slot);
+    if(!result)
+    {
+        if((interner->count + 1) * 2 > interner->table->mask + 1)
+        {
+            interner_grow_table(interner);
+            interner_probe(interner, interner->table, string, hash, &slot);
+        }
+
+        msi index = interner->count;
+        msi shifted = index + INTERNER_FIRST_CHUNK;
+        msi top_bit = intr_bsr(shifted);
+        msi chunk_index = top_bit - INTERNER_FIRST_CHUNK_SHIFT;
+        IR_ASSERT(chunk_index < INTERNER_MAX_CHUNKS);
+        Interned_String* chunk = interner->chunks[chunk_index];
+        if(!chunk)
+        {
+            chunk = (Interned_String*)DYN_ALLOC(((msi)1 << top_bit) * sizeof(Interned_String), interner->heap);
+            IR_NOT_NULL(chunk);
+            __atomic_store_n(&interner->chunks[chunk_index], chunk, __ATOMIC_RELEASE);
+        }
+
+        Interned_String* symbol = &chunk[shifted - ((msi)1 << top_bit)];
+        symbol->string = interner_copy_string(interner, string);
+        symbol->hash = hash;
+
+        result = (Symbol_Id)(index + 1);
+        __atomic_store_n(&interner->count, (u32)result, __ATOMIC_RELEASE);
+        __atomic_store_n(&interner->table->slots[slot], ((u64)result << 32) | hash, __ATOMIC_RELEASE);
+    }
+
+    __atomic_clear(&interner->lock, __ATOMIC_RELEASE);
+    return result;
+}
+
+static
+Symbol_Id intern(Interner* interner, String string)
+{
+    return intern(interner, string, hash_short_string(string));
+}
+
+/*
+   Fills the empty interner with count symbols and the slots of their table (capacity a
+   power of two) as they were saved from another interner, e.g. in an AST cache image.
+   Both are copied without hashing anything again, the strings are not copied and have to
+   outlive the interner. The table is checked by finding every symbol through it, false
+   (and the interner unchanged) if it does not find each one under its own id.
+*/
+static
+b8 interner_load(Interner* interner, Interned_String* symbols, u32 count, u64* slots, u32 capacity)
+{
+    IR_NOT_NULL(interner);
+    if(interner->count || capacity < 2 || (capacity & (capacity - 1)) || (u64)count * 2 > capacity)
+    {
+        return false;
+    }
+    
+    //NOTE(Michael): Every id of the table has to exist before a probe can look at its symbol
+    u32 used = 0;
+    for(u32 i = 0; i < capacity; ++i)
+    {
+        Symbol_Id id = (Symbol_Id)(slots[i] >> 32);
+        if(slots[i] && (id == SYMBOL_NONE || id > count))
+        {
+            return false;
+        }
+        used += slots[i] != 0;
+    }
+    if(used != count)
+    {
+        return false;
+    }
+    
+    Interner result = {};
+    result.heap = interner->heap;
+    result.table = interner_create_table(capacity, result.heap);
+    copy_buffer(IR_WRAP_INTO_BUFFER(slots, capacity * sizeof(u64)), IR_WRAP_INTO_BUFFER(result.table->slots, capacity * sizeof(u64)));
+    ARR_INIT(result.blocks, 4, result.heap);
+    for(msi chunk_index = 0, first = 0; first < count; ++chunk_index)
+    {
+        msi chunk_count = (msi)INTERNER_FIRST_CHUNK << chunk_index;
+        msi copied = u64_min(chunk_count, count - first);
+        result.chunks[chunk_index] = (Interned_String*)DYN_ALLOC(chunk_count * sizeof(Interned_String), result.heap);
+        IR_NOT_NULL(result.chunks[chunk_index]);
+        copy_buffer(IR_WRAP_INTO_BUFFER(&symbols[first], copied * sizeof(Interned_String)),
+                    IR_WRAP_INTO_BUFFER(result.chunks[chunk_index], copied * sizeof(Interned_String)));
+        first += copied;
+    }
+    result.count = count;
+    
+    b8 valid = true;
+    for(Symbol_Id id = 1; valid && id <= count; ++id)
+    {
+        Interned_String* symbol = interner_symbol(&result, id);
+        valid = interner_find(&result, symbol->string, symbol->hash) == id;
+    }
+    if(!valid)
+    {
+        free_interner(&result);
+        return false;
+    }
+    
+    free_interner(interner);
+    *interner = result;
+    return true;
+}
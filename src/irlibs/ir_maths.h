@@ -32,6 +32,26 @@ intr_bsr(u64 v)
     return result;
 }
 
+//NOTE(Michael): Result is undefined for v == 0, same as bsr
+inline u64
+intr_bsf(u64 v)
+{
+    u64 result = 0;
+#ifdef IR_ARCH_ARM
+    IR_INVALID_CASE;
+    NOT_IMPLEMENTED
+#else
+    asm(
+        "bsfq %1, %0"
+        :"=r"( result )        /* output */
+        :"r"( v )         /* input */
+        :         /* clobbered register */
+        );
+
+#endif
+    return result;
+}
+
 /**
  * @brief integer operations
  */
@@ -372,6 +372,8 @@ struct Heap_Allocator
     u8  min_exp;
     u8  max_exp;
     u8  initialized;
+    b8  thread_safe; //Serializes heap_alloc/free/realloc/resize_in_place through lock
+    b8  lock;
 };
 
 
@@ -523,11 +525,11 @@ void heap_split_partition(Heap_Partition* part, u8 target, Heap_Allocator* heap)
     
     
     Heap_Partition split_partition = *part;
-    split_partition.offset+= 1 << split_partition.size_exp;
+    split_partition.offset+= (msi)1 << split_partition.size_exp;
     for(msi i = 0; i<num_splits;++i)
     {
         --split_partition.size_exp;
-        split_partition.offset-= 1 << split_partition.size_exp;
+        split_partition.offset-= (msi)1 << split_partition.size_exp;
         Heap_Partition* new_entry = ((Heap_Partition*)(&heap->data.data[split_partition.offset])); 
         *new_entry = split_partition;
         new_entry->used = false;
@@ -604,7 +606,7 @@ Heap_Allocator create_heap(Memory_Arena* arena, msi size, u8 min_exp)
     heap.p_lists = (Heap_Partition**)heap.metadata.data;
     
     //Partition the buffer
-    msi min_size = 1 << heap.min_exp;
+    msi min_size = (msi)1 << heap.min_exp;
     msi remaining_size = heap.data.length;
     msi offset = 0;
     while(remaining_size >= min_size)
@@ -614,8 +616,8 @@ Heap_Allocator create_heap(Memory_Arena* arena, msi size, u8 min_exp)
         entry->used = false;
         entry->offset = offset;
         heap_add_to_free_list(entry, &heap);
-        offset+= 1 << entry->size_exp;        
-        remaining_size -= 1 << entry->size_exp;
+        offset+= (msi)1 << entry->size_exp;        
+        remaining_size -= (msi)1 << entry->size_exp;
     }
     
     IR_SOFT_ASSERT(remaining_size == 0 && "The buffer given to the heap allocator cannot be partitioned effectively!");
@@ -628,8 +630,31 @@ Heap_Allocator create_heap(Memory_Arena* arena, msi size, u8 min_exp)
 }
 
 
+inline
+void heap_lock(Heap_Allocator* heap)
+{
+    if(!heap->thread_safe)
+        return;
+    
+    while(__atomic_test_and_set(&heap->lock, __ATOMIC_ACQUIRE))
+    {
+#ifndef IR_ARCH_ARM
+        __builtin_ia32_pause();
+#endif
+    }
+}
+
+inline
+void heap_unlock(Heap_Allocator* heap)
+{
+    if(!heap->thread_safe)
+        return;
+    
+    __atomic_clear(&heap->lock, __ATOMIC_RELEASE);
+}
+
 static
-void* heap_free(void* ptr, Heap_Allocator* heap)
+void* heap_free_unlocked(void* ptr, Heap_Allocator* heap)
 {
     if(!ptr)
         return nullptr;
@@ -648,7 +673,7 @@ void* heap_free(void* ptr, Heap_Allocator* heap)
 }
 
 static
-void* heap_alloc(msi size, b8 clear, Heap_Allocator* heap)
+void* heap_alloc_unlocked(msi size, b8 clear, Heap_Allocator* heap)
 {
     if(!size)
     {
@@ -695,7 +720,7 @@ void* heap_alloc(msi size, b8 clear, Heap_Allocator* heap)
 
 
 static
-b8 heap_resize_in_place(void* ptr, msi new_size, Heap_Allocator* heap)
+b8 heap_resize_in_place_unlocked(void* ptr, msi new_size, Heap_Allocator* heap)
 {   
     if(!ptr && new_size != 0)
         return false;
@@ -707,7 +732,7 @@ b8 heap_resize_in_place(void* ptr, msi new_size, Heap_Allocator* heap)
     
     if(new_size == 0)
     {
-        heap_free(ptr, heap);
+        heap_free_unlocked(ptr, heap);
         return true;
     }
     else if(new_size_exp == entry->size_exp)
@@ -757,25 +782,26 @@ b8 heap_resize_in_place(void* ptr, msi new_size, Heap_Allocator* heap)
 }
 
 static
-b8 heap_realloc(void** ptr, msi new_size, Heap_Allocator* heap)
+b8 heap_realloc_unlocked(void** ptr, msi new_size, Heap_Allocator* heap)
 {
     void* new_ptr = *ptr;
     
     if(!ptr || !new_ptr)
     {
-        new_ptr = heap_alloc(new_size, false, heap);
+        new_ptr = heap_alloc_unlocked(new_size, false, heap);
     }
-    else if(!heap_resize_in_place(*ptr, new_size, heap))
+    else if(!heap_resize_in_place_unlocked(*ptr, new_size, heap))
     {
-        new_ptr = heap_alloc(new_size, false, heap);
+        new_ptr = heap_alloc_unlocked(new_size, false, heap);
         if(new_ptr)
         {
             Heap_Partition* old_entry = &((Heap_Partition*)*ptr)[-1];
-            msi old_size = 1 << old_entry->size_exp;
+            msi old_size = (msi)1 << old_entry->size_exp;
             msi smallest_size = u64_min(new_size, old_size);
             copy_buffer(IR_WRAP_INTO_BUFFER(*ptr, smallest_size), IR_WRAP_INTO_BUFFER(new_ptr, smallest_size));
             
-            heap_remove_from_used_list(old_entry, heap);    
+            //NOTE(Michael): Give the old partition back, only unlinking it leaked it
+            heap_free_unlocked(*ptr, heap);
         }
     }
     
@@ -792,3 +818,314 @@ b8 heap_realloc(void** ptr, msi new_size, Heap_Allocator* heap)
     }
 }
 
+static
+void* heap_free(void* ptr, Heap_Allocator* heap)
+{
+    heap_lock(heap);
+    void* result = heap_free_unlocked(ptr, heap);
+    heap_unlock(heap);
+    return result;
+}
+
+static
+void* heap_alloc(msi size, b8 clear, Heap_Allocator* heap)
+{
+    heap_lock(heap);
+    void* result = heap_alloc_unlocked(size, clear, heap);
+    heap_unlock(heap);
+    return result;
+}
+
+static
+b8 heap_resize_in_place(void* ptr, msi new_size, Heap_Allocator* heap)
+{
+    heap_lock(heap);
+    b8 result = heap_resize_in_place_unlocked(ptr, new_size, heap);
+    heap_unlock(heap);
+    return result;
+}
+
+static
+b8 heap_realloc(void** ptr, msi new_size, Heap_Allocator* heap)
+{
+    heap_lock(heap);
+    b8 result = heap_realloc_unlocked(ptr, new_size, heap);
+    heap_unlock(heap);
+    return result;
+}
+
+
+
+/*
+   Slab allocator for objects of one size, e.g. the Variables of an AST.
+   Slabs are power of two blocks from a Heap_Allocator, so the buddy heap hands out
+   exactly slab_size bytes. A slab starts with the pointer to the next slab, the
+   slots begin on the following cache line and never share a line with the header.
+   Freed slots form a list threaded through the slots, alloc and free are O(1).
+   slab_reset drops every object at once and keeps the slabs for the next round,
+   free_slab_allocator gives the slabs back to the heap.
+   
+   With thread_safe set every call takes lock. Threads that allocate a lot fill a slab
+   of their own instead and hand it over with slab_adopt once they are done.
+   
+   SLAB_INIT(slab, TYPE, slab_size, heap)
+   TYPE* t = SLAB_ALLOC(TYPE, &slab);   //zeroed
+   SLAB_FREE(t, &slab);
+*/
+#define IR_CACHE_LINE_SIZE 64
+
+struct Slab_Allocator
+{
+    Heap_Allocator* heap;
+    u8* first_slab;
+    u8* current_slab;
+    u8* bump;     //Next slot of current_slab that was never handed out
+    u8* bump_end;
+    void* free_list;
+    msi slot_size;
+    msi slot_offset; //Offset of the first slot from the start of a slab
+    msi slab_size;
+    msi slab_count;
+    msi used_slots;
+    b8 thread_safe;
+    b8 lock;
+};
+
+#define SLAB_INIT(SLAB, TYPE, SLAB_SIZE, HEAP) ((SLAB) = create_slab_allocator(sizeof(TYPE), alignof(TYPE), (SLAB_SIZE), (HEAP)))
+#define SLAB_ALLOC(TYPE, SLAB_PTR) ((TYPE*)slab_alloc(sizeof(TYPE), true, (SLAB_PTR)))
+#define SLAB_FREE(PTR, SLAB_PTR) (slab_free((PTR), (SLAB_PTR)), (PTR) = nullptr)
+
+//alignment has to be a power of two, pass IR_CACHE_LINE_SIZE to give every object its own lines
+static
+Slab_Allocator create_slab_allocator(msi element_size, msi alignment, msi slab_size, Heap_Allocator* heap)
+{
+    IR_NOT_NULL(heap);
+    IR_ASSERT(alignment && (alignment & (alignment - 1)) == 0);
+    
+    Slab_Allocator result = {};
+    result.heap = heap;
+    alignment = u64_max(alignment, sizeof(void*));
+    result.slot_size = (u64_max(element_size, sizeof(void*)) + alignment - 1) & ~(alignment - 1);
+    result.slot_offset = u64_max(alignment, IR_CACHE_LINE_SIZE);
+    
+    msi min_size = result.slot_offset + result.slot_size;
+    result.slab_size = (msi)1 << u64_log2_rounded_up(u64_max(slab_size, min_size));
+    return result;
+}
+
+inline
+void slab_lock(Slab_Allocator* slab)
+{
+    if(!slab->thread_safe)
+        return;
+    
+    while(__atomic_test_and_set(&slab->lock, __ATOMIC_ACQUIRE))
+    {
+#ifndef IR_ARCH_ARM
+        __builtin_ia32_pause();
+#endif
+    }
+}
+
+inline
+void slab_unlock(Slab_Allocator* slab)
+{
+    if(!slab->thread_safe)
+        return;
+    
+    __atomic_clear(&slab->lock, __ATOMIC_RELEASE);
+}
+
+//Slots of slab, the heap aligns blocks to their size relative to its buffer only
+inline
+u8* slab_first_slot(u8* slab_memory, Slab_Allocator* slab)
+{
+    msi alignment = slab->slot_offset;
+    return (u8*)(((msi)slab_memory + sizeof(u8*) + alignment - 1) & ~(alignment - 1));
+}
+
+static
+b8 slab_next_slab_unlocked(Slab_Allocator* slab)
+{
+    u8* next = slab->current_slab ? *(u8**)slab->current_slab : nullptr;
+    if(!next)
+    {
+        //NOTE(Michael): The partition header lives in front of the block, asking for
+        //               exactly slab_size would round up to the next power of two
+        next = (u8*)heap_alloc(slab->slab_size - sizeof(Heap_Partition), false, slab->heap);
+        if(!next)
+        {
+            return false;
+        }
+        *(u8**)next = nullptr;
+        if(slab->current_slab)
+        {
+            *(u8**)slab->current_slab = next;
+        }
+        else
+        {
+            slab->first_slab = next;
+        }
+        slab->slab_count++;
+    }
+    
+    slab->current_slab = next;
+    slab->bump = slab_first_slot(next, slab);
+    u8* end = next + slab->slab_size - sizeof(Heap_Partition);
+    slab->bump_end = slab->bump + ((end - slab->bump) / slab->slot_size) * slab->slot_size;
+    return true;
+}
+
+static
+void* slab_alloc_unlocked(Slab_Allocator* slab)
+{
+    void* result = slab->free_list;
+    if(result)
+    {
+        slab->free_list = *(void**)result;
+    }
+    else
+    {
+        if(slab->bump == slab->bump_end && !slab_next_slab_unlocked(slab))
+        {
+            IR_SOFT_ASSERT(false && "Slab allocation failed!\n");
+            return nullptr;
+        }
+        result = slab->bump;
+        slab->bump += slab->slot_size;
+    }
+    slab->used_slots++;
+    return result;
+}
+
+inline
+void slab_free_unlocked(void* ptr, Slab_Allocator* slab)
+{
+    *(void**)ptr = slab->free_list;
+    slab->free_list = ptr;
+    slab->used_slots--;
+}
+
+//size is only checked against the slot size, SLAB_ALLOC passes sizeof(TYPE)
+static
+void* slab_alloc(msi size, b8 clear, Slab_Allocator* slab)
+{
+    IR_NOT_NULL(slab);
+    IR_ASSERT(size <= slab->slot_size);
+    slab_lock(slab);
+    void* result = slab_alloc_unlocked(slab);
+    slab_unlock(slab);
+    if(result && clear)
+    {
+        zero_buffer(IR_WRAP_INTO_BUFFER(result, slab->slot_size));
+    }
+    return result;
+}
+
+static
+void slab_free(void* ptr, Slab_Allocator* slab)
+{
+    if(!ptr)
+        return;
+    
+    slab_lock(slab);
+    slab_free_unlocked(ptr, slab);
+    slab_unlock(slab);
+}
+
+//Every object is gone afterwards, the slabs are reused in the same order
+static
+void slab_reset(Slab_Allocator* slab)
+{
+    slab_lock(slab);
+    slab->free_list = nullptr;
+    slab->used_slots = 0;
+    slab->current_slab = nullptr;
+    slab->bump = nullptr;
+    slab->bump_end = nullptr;
+    if(slab->first_slab)
+    {
+        slab->current_slab = slab->first_slab;
+        slab->bump = slab_first_slot(slab->first_slab, slab);
+        u8* end = slab->first_slab + slab->slab_size - sizeof(Heap_Partition);
+        slab->bump_end = slab->bump + ((end - slab->bump) / slab->slot_size) * slab->slot_size;
+    }
+    slab_unlock(slab);
+}
+
+static
+void free_slab_allocator(Slab_Allocator* slab)
+{
+    u8* next = slab->first_slab;
+    while(next)
+    {
+        u8* s = next;
+        next = *(u8**)s;
+        heap_free(s, slab->heap);
+    }
+    Slab_Allocator empty = {};
+    empty.heap = slab->heap;
+    empty.slot_size = slab->slot_size;
+    empty.slot_offset = slab->slot_offset;
+    empty.slab_size = slab->slab_size;
+    empty.thread_safe = slab->thread_safe;
+    *slab = empty;
+}
+
+/*
+   Moves the slabs and objects of other into slab, other is empty afterwards. Both need
+   the same slot size and heap. The slabs of other go in front of the chain, slab keeps
+   bumping into its current slab and only reuses them after slab_reset.
+*/
+static
+void slab_adopt(Slab_Allocator* slab, Slab_Allocator* other)
+{
+    IR_ASSERT(slab->slot_size == other->slot_size && slab->slab_size == other->slab_size);
+    if(!other->first_slab)
+    {
+        return;
+    }
+
+    slab_lock(slab);
+    if(!slab->first_slab)
+    {
+        //NOTE(Michael): Without slabs of its own slab simply continues where other stopped
+        slab->first_slab = other->first_slab;
+        slab->current_slab = other->current_slab;
+        slab->bump = other->bump;
+        slab->bump_end = other->bump_end;
+    }
+    else
+    {
+        u8* last = other->first_slab;
+        while(*(u8**)last)
+        {
+            last = *(u8**)last;
+        }
+        *(u8**)last = slab->first_slab;
+        slab->first_slab = other->first_slab;
+    }
+
+    if(other->free_list)
+    {
+        void* last_free = other->free_list;
+        while(*(void**)last_free)
+        {
+            last_free = *(void**)last_free;
+        }
+        *(void**)last_free = slab->free_list;
+        slab->free_list = other->free_list;
+    }
+
+    slab->slab_count += other->slab_count;
+    slab->used_slots += other->used_slots;
+    slab_unlock(slab);
+
+    other->first_slab = nullptr;
+    other->current_slab = nullptr;
+    other->bump = nullptr;
+    other->bump_end = nullptr;
+    other->free_list = nullptr;
+    other->slab_count = 0;
+    other->used_slots = 0;
+}
@@ -3,6 +3,12 @@
 #include "ir_types.h"
 #include "ir_memory.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #ifndef IR_ASSERT
 #define IR_ASSERT(ASSERT)
 #define IR_NOT_NULL(PTR)
@@ -12,8 +18,17 @@
 
 #define IR_EXP_STR(STRING) (STRING).length, (STRING).data
 
+struct Hash_128
+{
+    u64 low;
+    u64 high;
+};
+
 
 static b8 cmp_string(String a, String b);
+static u64 hash_string(String string);
+static u32 hash_short_string(String string);
+static Hash_128 hash_bytes_128(String string, u64 seed);
 static b8 copy_string(String from, String to);
 static b8 copy_string(String from, String to, msi start, msi length);
 static b8 copy_string(String from, String to, msi start_read, msi start_write, msi length);
@@ -34,6 +49,10 @@ static b8 is_whitespace_without_end_of_line(c8 c);
 static b8 is_whitespace(c8 c);
 static b8 is_alpha(c8 c);
 static b8 is_number(c8 c);
+static msi scan_past_digits(u8* data, msi begin, msi end);
+static msi scan_past_ident_cont(u8* data, msi begin, msi end);
+static msi scan_past_blanks(u8* data, msi begin, msi end);
+static msi scan_to_end_of_line(u8* data, msi begin, msi end);
 static c8 decimal_digit_to_c8(u64 digit);
 
 
@@ -177,6 +196,83 @@ b8 cmp_string(String a, String b)
     return result;
 }
 
+//FNV-1a
+static
+u64 hash_string(String string)
+{
+    u64 result = 0xcbf29ce484222325ULL;
+    for(msi i = 0; i < string.length; ++i)
+    {
+        result ^= (u8)string.data[i];
+        result *= 0x100000001b3ULL;
+    }
+    return result;
+}
+
+//Eight bytes per multiply, meant for identifiers and other short keys
+static
+u32 hash_short_string(String string)
+{
+    u64 result = string.length * 0x9e3779b97f4a7c15ULL;
+    msi i = 0;
+    for(; i + 8 <= string.length; i += 8)
+    {
+        u64 word;
+        __builtin_memcpy(&word, &string.data[i], 8);
+        result = (result ^ word) * 0xff51afd7ed558ccdULL;
+        result ^= result >> 32;
+    }
+    if(i < string.length)
+    {
+        u64 word = 0;
+        __builtin_memcpy(&word, &string.data[i], string.length - i);
+        result = (result ^ word) * 0xff51afd7ed558ccdULL;
+    }
+    result ^= result >> 29;
+    result *= 0xc4ceb9fe1a85ec53ULL;
+    result ^= result >> 32;
+    return (u32)result;
+}
+
+inline
+u64 hash_mum(u64 a, u64 b)
+{
+    __uint128_t product = (__uint128_t)a * b;
+    return (u64)product ^ (u64)(product >> 64);
+}
+
+/*
+   Two independent lanes of 16 bytes each per step, every step one 64x64->128 bit
+   multiply per lane (the wyhash mixing), meant for whole files and other big inputs.
+*/
+static
+Hash_128 hash_bytes_128(String string, u64 seed)
+{
+    const u64 secret[4] = {0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL, 0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL};
+    u64 a = seed ^ secret[0];
+    u64 b = seed ^ secret[1] ^ ((u64)string.length * secret[2]);
+    u64 words[4];
+    msi i = 0;
+    for(; i + 32 <= string.length; i += 32)
+    {
+        __builtin_memcpy(words, &string.data[i], 32);
+        a = hash_mum(words[0] ^ secret[2], words[1] ^ a);
+        b = hash_mum(words[2] ^ secret[3], words[3] ^ b);
+    }
+    if(i < string.length)
+    {
+        words[0] = words[1] = words[2] = words[3] = 0;
+        __builtin_memcpy(words, &string.data[i], string.length - i);
+        a = hash_mum(words[0] ^ secret[2], words[1] ^ a);
+        b = hash_mum(words[2] ^ secret[3], words[3] ^ b);
+    }
+    
+    Hash_128 result;
+    result.low = hash_mum(a ^ secret[1], b ^ secret[3] ^ (u64)string.length);
+    result.high = hash_mum(b ^ secret[0], a ^ secret[2] ^ result.low);
+    return result;
+}
+
 //NOTE length of "to" string doesn't change
 static
 b8 copy_string(String from, String to)
@@ -457,43 +553,304 @@ b8 cmp_asciiz(c8* asciiz1, c8* asciiz2)
 
 
 
+/*
+   Character classes of all 256 byte values, queried with ir_char_class(c) & IR_CC_*.
+   Bytes >= 0x80 have no class.
+*/
+enum Char_Class
+{
+    IR_CC_SPACE      = 1 << 0, //' ' '\t' '\v' '\f'
+    IR_CC_EOL        = 1 << 1, //'\n' '\r'
+    IR_CC_ALPHA      = 1 << 2, //a-z A-Z
+    IR_CC_DIGIT      = 1 << 3, //0-9
+    IR_CC_HEX        = 1 << 4, //0-9 a-f A-F
+    IR_CC_UNDERSCORE = 1 << 5,
+    
+    IR_CC_WHITESPACE  = IR_CC_SPACE | IR_CC_EOL,
+    IR_CC_IDENT_START = IR_CC_ALPHA | IR_CC_UNDERSCORE,
+    IR_CC_IDENT_CONT  = IR_CC_ALPHA | IR_CC_DIGIT | IR_CC_UNDERSCORE,
+};
+
+constexpr
+u8 ir_char_class_of(int c)
+{
+    return (u8)(((c == ' ' || c == '\t' || c == '\v' || c == '\f') ? IR_CC_SPACE : 0) |
+                ((c == '\n' || c == '\r') ? IR_CC_EOL : 0) |
+                (((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) ? IR_CC_ALPHA : 0) |
+                ((c >= '0' && c <= '9') ? IR_CC_DIGIT : 0) |
+                (((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')) ? IR_CC_HEX : 0) |
+                (c == '_' ? IR_CC_UNDERSCORE : 0));
+}
+
+#define IR_CC_ROW(R) \
+ir_char_class_of(R+0),  ir_char_class_of(R+1),  ir_char_class_of(R+2),  ir_char_class_of(R+3),  \
+ir_char_class_of(R+4),  ir_char_class_of(R+5),  ir_char_class_of(R+6),  ir_char_class_of(R+7),  \
+ir_char_class_of(R+8),  ir_char_class_of(R+9),  ir_char_class_of(R+10), ir_char_class_of(R+11), \
+ir_char_class_of(R+12), ir_char_class_of(R+13), ir_char_class_of(R+14), ir_char_class_of(R+15)
+
+static constexpr u8 ir_char_class_table[256] =
+{
+    IR_CC_ROW(0x00), IR_CC_ROW(0x10), IR_CC_ROW(0x20), IR_CC_ROW(0x30),
+    IR_CC_ROW(0x40), IR_CC_ROW(0x50), IR_CC_ROW(0x60), IR_CC_ROW(0x70),
+    IR_CC_ROW(0x80), IR_CC_ROW(0x90), IR_CC_ROW(0xA0), IR_CC_ROW(0xB0),
+    IR_CC_ROW(0xC0), IR_CC_ROW(0xD0), IR_CC_ROW(0xE0), IR_CC_ROW(0xF0),
+};
+#undef IR_CC_ROW
+
+inline
+u8 ir_char_class(c8 c)
+{
+    return ir_char_class_table[(unsigned char)c];
+}
+
 static
 b8 is_end_of_line(c8 c)
 {
-    return  (c == '\n' ||
-             c == '\r');
+    return ir_char_class(c) & IR_CC_EOL;
 }
 
 static
 b8 is_whitespace_without_end_of_line(c8 c)
 {
-    return (c == ' ' ||
-            c == '\t'||
-            c == '\v'||
-            c == '\f');
-};
+    return ir_char_class(c) & IR_CC_SPACE;
+}
 
 static
 b8 is_whitespace(c8 c)
 {
-    return (is_whitespace_without_end_of_line(c) ||
-            is_end_of_line(c));
-};
+    return ir_char_class(c) & IR_CC_WHITESPACE;
+}
 
 static
 b8 is_alpha(c8 c)
 {
-    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+    return ir_char_class(c) & IR_CC_ALPHA;
 }
 
 static
 b8 is_number(c8 c)
 {
-    return (c == '0' || c == '1' ||
-            c == '2' || c == '3' ||
-            c == '4' || c == '5' ||
-            c == '6' || c == '7' ||
-            c == '8' || c == '9');
+    return ir_char_class(c) & IR_CC_DIGIT;
+}
+
+/*
+   Classify 16 (SSE2) or 32 (AVX2) bytes at once, bit i of the mask belongs to p[i].
+   The ranges are checked as (c - low) <= (high - low) on unsigned bytes. The 32 byte
+   versions are only built with -mavx2 (./build.sh avx2, ./bench.sh avx2).
+*/
+#if defined(__SSE2__)
+inline
+u32 ir_digit_mask_16(u8* p)
+{
+    __m128i c = _mm_sub_epi8(_mm_loadu_si128((__m128i*)p), _mm_set1_epi8('0'));
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(c, _mm_set1_epi8(9)), c));
+}
+
+inline
+u32 ir_ident_cont_mask_16(u8* p)
+{
+    __m128i c = _mm_loadu_si128((__m128i*)p);
+    __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    //NOTE(Michael): Setting 0x20 maps 'A'-'Z' onto 'a'-'z' and nothing else onto them
+    __m128i alpha = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(25)), alpha);
+    __m128i is_underscore = _mm_cmpeq_epi8(c, _mm_set1_epi8('_'));
+    return (u32)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(is_digit, is_alpha), is_underscore));
+}
+
+inline
+u32 ir_blank_mask_16(u8* p)
+{
+    __m128i c = _mm_loadu_si128((__m128i*)p);
+    //NOTE(Michael): '\t' '\n' '\v' '\f' '\r' are 9..13
+    __m128i ctrl = _mm_sub_epi8(c, _mm_set1_epi8(9));
+    __m128i is_ctrl = _mm_cmpeq_epi8(_mm_min_epu8(ctrl, _mm_set1_epi8(4)), ctrl);
+    __m128i is_space = _mm_cmpeq_epi8(c, _mm_set1_epi8(' '));
+    return (u32)_mm_movemask_epi8(_mm_or_si128(is_ctrl, is_space));
+}
+
+inline
+u32 ir_end_of_line_mask_16(u8* p)
+{
+    __m128i c = _mm_loadu_si128((__m128i*)p);
+    __m128i lf = _mm_cmpeq_epi8(c, _mm_set1_epi8('\n'));
+    __m128i cr = _mm_cmpeq_epi8(c, _mm_set1_epi8('\r'));
+    return (u32)_mm_movemask_epi8(_mm_or_si128(lf, cr));
+}
+
+inline
+u32 ir_byte_mask_16(u8* p, u8 byte)
+{
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)p), _mm_set1_epi8(byte)));
+}
+
+//NOTE(Michael): Reads p[0..16], bit i is set if p[i] == first and p[i+1] == second
+inline
+u32 ir_pair_mask_16(u8* p, u8 first, u8 second)
+{
+    __m128i c0 = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)p), _mm_set1_epi8(first));
+    __m128i c1 = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)(p+1)), _mm_set1_epi8(second));
+    return (u32)_mm_movemask_epi8(_mm_and_si128(c0, c1));
+}
+#endif
+
+#if defined(__AVX2__)
+inline
+u32 ir_digit_mask_32(u8* p)
+{
+    __m256i c = _mm256_sub_epi8(_mm256_loadu_si256((__m256i*)p), _mm256_set1_epi8('0'));
+    return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(c, _mm256_set1_epi8(9)), c));
+}
+
+inline
+u32 ir_ident_cont_mask_32(u8* p)
+{
+    __m256i c = _mm256_loadu_si256((__m256i*)p);
+    __m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    __m256i is_alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(25)), alpha);
+    __m256i is_underscore = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('_'));
+    return (u32)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(is_digit, is_alpha), is_underscore));
+}
+
+inline
+u32 ir_blank_mask_32(u8* p)
+{
+    __m256i c = _mm256_loadu_si256((__m256i*)p);
+    __m256i ctrl = _mm256_sub_epi8(c, _mm256_set1_epi8(9));
+    __m256i is_ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(ctrl, _mm256_set1_epi8(4)), ctrl);
+    __m256i is_space = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(' '));
+    return (u32)_mm256_movemask_epi8(_mm256_or_si256(is_ctrl, is_space));
+}
+
+inline
+u32 ir_end_of_line_mask_32(u8* p)
+{
+    __m256i c = _mm256_loadu_si256((__m256i*)p);
+    __m256i lf = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n'));
+    __m256i cr = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\r'));
+    return (u32)_mm256_movemask_epi8(_mm256_or_si256(lf, cr));
+}
+
+inline
+u32 ir_byte_mask_32(u8* p, u8 byte)
+{
+    return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i*)p), _mm256_set1_epi8(byte)));
+}
+
+inline
+u32 ir_pair_mask_32(u8* p, u8 first, u8 second)
+{
+    __m256i c0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i*)p), _mm256_set1_epi8(first));
+    __m256i c1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i*)(p+1)), _mm256_set1_epi8(second));
+    return (u32)_mm256_movemask_epi8(_mm256_and_si256(c0, c1));
+}
+#endif
+
+//Returns the index of the first byte in [begin, end) that is not a decimal digit or end
+static
+msi scan_past_digits(u8* data, msi begin, msi end)
+{
+    msi i = begin;
+#if defined(__AVX2__)
+    for(; i + 32 <= end; i += 32)
+    {
+        u32 other = ~ir_digit_mask_32(&data[i]);
+        if(other)
+            return i + __builtin_ctz(other);
+    }
+#endif
+#if defined(__SSE2__)
+    for(; i + 16 <= end; i += 16)
+    {
+        u32 other = ~ir_digit_mask_16(&data[i]) & 0xFFFF;
+        if(other)
+            return i + __builtin_ctz(other);
+    }
+#endif
+    for(; i < end && (ir_char_class(data[i]) & IR_CC_DIGIT); ++i)
+    {}
+    return i;
+}
+
+//Returns the index of the first byte in [begin, end) that can not continue an identifier or end
+static
+msi scan_past_ident_cont(u8* data, msi begin, msi end)
+{
+    msi i = begin;
+#if defined(__AVX2__)
+    for(; i + 32 <= end; i += 32)
+    {
+        u32 other = ~ir_ident_cont_mask_32(&data[i]);
+        if(other)
+            return i + __builtin_ctz(other);
+    }
+#endif
+#if defined(__SSE2__)
+    for(; i + 16 <= end; i += 16)
+    {
+        u32 other = ~ir_ident_cont_mask_16(&data[i]) & 0xFFFF;
+        if(other)
+            return i + __builtin_ctz(other);
+    }
+#endif
+    for(; i < end && (ir_char_class(data[i]) & IR_CC_IDENT_CONT); ++i)
+    {}
+    return i;
+}
+
+//Returns the index of the first byte in [begin, end) that is neither whitespace nor end of line
+static
+msi scan_past_blanks(u8* data, msi begin, msi end)
+{
+    msi i = begin;
+#if defined(__AVX2__)
+    for(; i + 32 <= end; i += 32)
+    {
+        u32 other = ~ir_blank_mask_32(&data[i]);
+        if(other)
+            return i + __builtin_ctz(other);
+    }
+#endif
+#if defined(__SSE2__)
+    for(; i + 16 <= end; i += 16)
+    {
+        u32 other = ~ir_blank_mask_16(&data[i]) & 0xFFFF;
+        if(other)
+            return i + __builtin_ctz(other);
+    }
+#endif
+    for(; i < end && is_whitespace(data[i]); ++i)
+    {}
+    return i;
+}
+
+//Returns the index of the first end of line char in [begin, end) or end
+static
+msi scan_to_end_of_line(u8* data, msi begin, msi end)
+{
+    msi i = begin;
+#if defined(__AVX2__)
+    for(; i + 32 <= end; i += 32)
+    {
+        u32 eol = ir_end_of_line_mask_32(&data[i]);
+        if(eol)
+            return i + __builtin_ctz(eol);
+    }
+#endif
+#if defined(__SSE2__)
+    for(; i + 16 <= end; i += 16)
+    {
+        u32 eol = ir_end_of_line_mask_16(&data[i]);
+        if(eol)
+            return i + __builtin_ctz(eol);
+    }
+#endif
+    for(; i < end && !is_end_of_line(data[i]); ++i)
+    {}
+    return i;
 }
 
 
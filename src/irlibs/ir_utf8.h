@@ -0,0 +1,274 @@
+#pragma once
+
+#include "ir_types.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static msi utf8_decode(u8* data, msi cur, msi end, u32* codepoint);
+static b8 utf8_validate_scalar(u8* data, msi length, msi* error_offset);
+static b8 utf8_validate(u8* data, msi length, msi* error_offset);
+
+
+/*
+   Decodes the character starting at cur (well formed sequences of the Unicode standard,
+   table 3-7: no overlongs, no surrogates, nothing above U+10FFFF).
+   Returns its length in bytes or 0 if the bytes at cur are not valid UTF-8.
+*/
+static
+msi utf8_decode(u8* data, msi cur, msi end, u32* codepoint)
+{
+    u32 b0 = (unsigned char)data[cur];
+    if(b0 < 0x80)
+    {
+        *codepoint = b0;
+        return 1;
+    }
+
+    msi length = 0;
+    u32 low = 0x80;  //Allowed range of the second byte
+    u32 high = 0xBF;
+    if(b0 >= 0xC2 && b0 <= 0xDF)      { length = 2; }
+    else if(b0 == 0xE0)               { length = 3; low = 0xA0; }
+    else if(b0 == 0xED)               { length = 3; high = 0x9F; }
+    else if(b0 >= 0xE1 && b0 <= 0xEF) { length = 3; }
+    else if(b0 == 0xF0)               { length = 4; low = 0x90; }
+    else if(b0 >= 0xF1 && b0 <= 0xF3) { length = 4; }
+    else if(b0 == 0xF4)               { length = 4; high = 0x8F; }
+    else                              { return 0; }
+
+    if(cur + length > end)
+    {
+        return 0;
+    }
+
+    u32 b1 = (unsigned char)data[cur+1];
+    if(b1 < low || b1 > high)
+    {
+        return 0;
+    }
+
+    u32 result = (b0 & (0xFF >> (length + 1))) << 6 | (b1 & 0x3F);
+    for(msi i = 2; i < length; ++i)
+    {
+        u32 b = (unsigned char)data[cur+i];
+        if((b & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+        result = result << 6 | (b & 0x3F);
+    }
+
+    *codepoint = result;
+    return length;
+}
+
+//Returns false and the offset of the first invalid sequence if data is not valid UTF-8
+static
+b8 utf8_validate_scalar(u8* data, msi length, msi* error_offset)
+{
+    msi i = 0;
+    while(i < length)
+    {
+#if defined(__SSE2__)
+        if(i + 16 <= length && !_mm_movemask_epi8(_mm_loadu_si128((__m128i*)&data[i])))
+        {
+            i += 16;
+            continue;
+        }
+#endif
+        u32 codepoint = 0;
+        msi char_length = utf8_decode(data, i, length, &codepoint);
+        if(!char_length)
+        {
+            *error_offset = i;
+            return false;
+        }
+        i += char_length;
+    }
+    return true;
+}
+
+/*
+   Vectorized validation after Keiser and Lemire, "Validating UTF-8 In Less Than One
+   Instruction Per Byte". Each byte is checked against the byte before it with three
+   nibble lookups, every error class is a bit and a pair of bytes is invalid if a bit
+   survives the AND of the lookups. 3 and 4 byte sequences are checked by requiring
+   continuation bytes 2 and 3 bytes after their lead. Blocks without any byte >= 0x80
+   only carry over whether the previous block ended inside a sequence.
+   Builds without SSSE3 (no byte shuffle) skip ASCII runs and decode the rest, the plain
+   x86-64 build is one of them. ./build.sh avx2 and ./bench.sh avx2 build the AVX2 version.
+*/
+#define UTF8_TOO_SHORT      (1 << 0) //11______ 0_______ or 11______ 11______
+#define UTF8_TOO_LONG       (1 << 1) //0_______ 10______
+#define UTF8_OVERLONG_3     (1 << 2) //11100000 100_____
+#define UTF8_TOO_LARGE      (1 << 3) //11110100 1001____ and bigger
+#define UTF8_SURROGATE      (1 << 4) //11101101 101_____
+#define UTF8_OVERLONG_2     (1 << 5) //1100000_ 10______
+#define UTF8_TOO_LARGE_1000 (1 << 6) //11110101 1000____ and bigger
+#define UTF8_OVERLONG_4     (1 << 6) //11110000 1000____
+#define UTF8_TWO_CONTS      (1 << 7) //10______ 10______
+#define UTF8_CARRY          (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+//NOTE(Michael): The lookup tables indexed by the high nibble of the previous byte, its low nibble and the high nibble of the byte
+#define UTF8_BYTE_1_HIGH_TABLE \
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, \
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, \
+    UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, \
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2, \
+    UTF8_TOO_SHORT, \
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE, \
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+
+#define UTF8_BYTE_1_LOW_TABLE \
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4, \
+    UTF8_CARRY | UTF8_OVERLONG_2, \
+    UTF8_CARRY, \
+    UTF8_CARRY, \
+    UTF8_CARRY | UTF8_TOO_LARGE, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+
+#define UTF8_BYTE_2_HIGH_TABLE \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE, \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+
+#if defined(__AVX2__)
+#define UTF8_SIMD_WIDTH 32
+typedef __m256i Utf8_Vector;
+
+static const unsigned char utf8_byte_1_high[32] = {UTF8_BYTE_1_HIGH_TABLE, UTF8_BYTE_1_HIGH_TABLE};
+static const unsigned char utf8_byte_1_low[32] = {UTF8_BYTE_1_LOW_TABLE, UTF8_BYTE_1_LOW_TABLE};
+static const unsigned char utf8_byte_2_high[32] = {UTF8_BYTE_2_HIGH_TABLE, UTF8_BYTE_2_HIGH_TABLE};
+//Bytes that may not end a block: 3 byte leads in the last 2, 4 byte leads in the last 3 and 2 byte leads in the last byte
+static const unsigned char utf8_max_end[32] =
+{
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0-1, 0xE0-1, 0xC0-1,
+};
+
+#define UTF8_LOAD(P)            _mm256_loadu_si256((__m256i*)(P))
+#define UTF8_OR(A, B)           _mm256_or_si256((A), (B))
+#define UTF8_AND(A, B)          _mm256_and_si256((A), (B))
+#define UTF8_XOR(A, B)          _mm256_xor_si256((A), (B))
+#define UTF8_SET1(V)            _mm256_set1_epi8((char)(V))
+#define UTF8_SUBS(A, B)         _mm256_subs_epu8((A), (B))
+#define UTF8_LOOKUP(TABLE, I)   _mm256_shuffle_epi8(UTF8_LOAD(TABLE), (I))
+#define UTF8_SHR4(V)            _mm256_and_si256(_mm256_srli_epi16((V), 4), UTF8_SET1(0x0F))
+#define UTF8_MOVEMASK(V)        _mm256_movemask_epi8(V)
+#define UTF8_IS_ZERO(V)         _mm256_testz_si256((V), (V))
+//NOTE(Michael): Shifts N bytes of the previous block in front of input, alignr only works inside 128 bit lanes
+#define UTF8_PREV(INPUT, PREV, N) \
+    _mm256_alignr_epi8((INPUT), _mm256_permute2x128_si256((PREV), (INPUT), 0x21), 16 - (N))
+#elif defined(__SSSE3__)
+#define UTF8_SIMD_WIDTH 16
+typedef __m128i Utf8_Vector;
+
+static const unsigned char utf8_byte_1_high[16] = {UTF8_BYTE_1_HIGH_TABLE};
+static const unsigned char utf8_byte_1_low[16] = {UTF8_BYTE_1_LOW_TABLE};
+static const unsigned char utf8_byte_2_high[16] = {UTF8_BYTE_2_HIGH_TABLE};
+static const unsigned char utf8_max_end[16] =
+{
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0-1, 0xE0-1, 0xC0-1,
+};
+
+#define UTF8_LOAD(P)            _mm_loadu_si128((__m128i*)(P))
+#define UTF8_OR(A, B)           _mm_or_si128((A), (B))
+#define UTF8_AND(A, B)          _mm_and_si128((A), (B))
+#define UTF8_XOR(A, B)          _mm_xor_si128((A), (B))
+#define UTF8_SET1(V)            _mm_set1_epi8((char)(V))
+#define UTF8_SUBS(A, B)         _mm_subs_epu8((A), (B))
+#define UTF8_LOOKUP(TABLE, I)   _mm_shuffle_epi8(UTF8_LOAD(TABLE), (I))
+#define UTF8_SHR4(V)            _mm_and_si128(_mm_srli_epi16((V), 4), UTF8_SET1(0x0F))
+#define UTF8_MOVEMASK(V)        _mm_movemask_epi8(V)
+#define UTF8_IS_ZERO(V)         (_mm_movemask_epi8(_mm_cmpeq_epi8((V), _mm_setzero_si128())) == 0xFFFF)
+#define UTF8_PREV(INPUT, PREV, N) _mm_alignr_epi8((INPUT), (PREV), 16 - (N))
+#endif
+
+#ifdef UTF8_SIMD_WIDTH
+struct Utf8_Checker
+{
+    Utf8_Vector error;
+    Utf8_Vector prev_input;
+    Utf8_Vector prev_incomplete;
+};
+
+inline
+void utf8_check_block(Utf8_Checker* c, Utf8_Vector input)
+{
+    if(!UTF8_MOVEMASK(input))
+    {
+        //An ASCII block is only wrong if the previous one stopped inside a sequence
+        c->error = UTF8_OR(c->error, c->prev_incomplete);
+        c->prev_incomplete = UTF8_SET1(0);
+        c->prev_input = input;
+        return;
+    }
+
+    Utf8_Vector prev1 = UTF8_PREV(input, c->prev_input, 1);
+    Utf8_Vector byte_1_high = UTF8_LOOKUP(utf8_byte_1_high, UTF8_SHR4(prev1));
+    Utf8_Vector byte_1_low = UTF8_LOOKUP(utf8_byte_1_low, UTF8_AND(prev1, UTF8_SET1(0x0F)));
+    Utf8_Vector byte_2_high = UTF8_LOOKUP(utf8_byte_2_high, UTF8_SHR4(input));
+    Utf8_Vector special_cases = UTF8_AND(UTF8_AND(byte_1_high, byte_1_low), byte_2_high);
+
+    //Only 111_____ two bytes back and 1111____ three bytes back reach 0x80
+    Utf8_Vector prev2 = UTF8_PREV(input, c->prev_input, 2);
+    Utf8_Vector prev3 = UTF8_PREV(input, c->prev_input, 3);
+    Utf8_Vector is_third_byte = UTF8_SUBS(prev2, UTF8_SET1(0xE0 - 0x80));
+    Utf8_Vector is_fourth_byte = UTF8_SUBS(prev3, UTF8_SET1(0xF0 - 0x80));
+    Utf8_Vector must_be_continuation = UTF8_AND(UTF8_OR(is_third_byte, is_fourth_byte), UTF8_SET1(0x80));
+
+    c->error = UTF8_OR(c->error, UTF8_XOR(must_be_continuation, special_cases));
+    c->prev_incomplete = UTF8_SUBS(input, UTF8_LOAD(utf8_max_end));
+    c->prev_input = input;
+}
+#endif
+
+//Returns false and the offset of the first invalid sequence if data is not valid UTF-8
+static
+b8 utf8_validate(u8* data, msi length, msi* error_offset)
+{
+#ifdef UTF8_SIMD_WIDTH
+    Utf8_Checker c = {};
+    msi i = 0;
+    for(; i + UTF8_SIMD_WIDTH <= length; i += UTF8_SIMD_WIDTH)
+    {
+        utf8_check_block(&c, UTF8_LOAD(&data[i]));
+    }
+
+    //The tail is checked as a block padded with zeros (ASCII)
+    u8 tail[UTF8_SIMD_WIDTH] = {};
+    for(msi j = 0; i + j < length; ++j)
+    {
+        tail[j] = data[i + j];
+    }
+    utf8_check_block(&c, UTF8_LOAD(tail));
+    c.error = UTF8_OR(c.error, c.prev_incomplete);
+
+    if(UTF8_IS_ZERO(c.error))
+    {
+        return true;
+    }
+#endif
+    //Invalid input is rare, the scalar pass finds where it went wrong
+    return utf8_validate_scalar(data, length, error_offset);
+}
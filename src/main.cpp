@@ -1,72 +1,164 @@
+#include <unistd.h>
+#include <string.h>
+
 #include "ir_assert.h"
 #include "tokens.h"
+#include "ir_file.h"
 #include "tokenizer.h"
 #include "ast.h"
 #include "parser.h"
 #include "typer.h"
-
-String read_entire_file(c8* file_name, Memory_Arena* arena)
-{
-    FILE* file;
-    file = fopen(file_name, "rb+");
-    
-    u64 file_size = 0;
-    
-    fseek(file, 0, SEEK_END);
-    file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    String result;
-    result.length = file_size;
-    result.data = (u8*)push_size(file_size, arena);
-    
-    fread(result.data, result.length, 1, file);
-    
-    fclose(file);
-    
-    return result;
-}
-
-
-
+#include "ast_cache.h"
+#include "compile_cache.h"
 
 int main(s32 argc, c8** argv)
 {
     Memory_Arena arena = create_memory_arena(IR_MEGABYTES(2048), (u8*)malloc(IR_MEGABYTES(2048)));
     
-    String file;
-    
-    if (argc > 1){
-        file = read_entire_file(argv[1], &arena);
-    }else
-        file = read_entire_file("testcode/test.m", &arena);
+    //Usage: mc [-lazy] [-export=name ...] [-cache=dir] [-cache-size=MB] [-cache-stats] [file]
+    //-lazy only parses the bodies of main and the exported functions
+    //-cache reuses the typed AST of an unchanged file (default dir $MLANG_CACHE_DIR, no cache if unset)
+    const c8* path = "testcode/test.m";
+    b8 lazy = false;
+    String roots[64] = {wrap_asciiz((c8*)"main")};
+    u32 root_count = 1;
+    const c8* cache_dir = getenv("MLANG_CACHE_DIR");
+    msi cache_size = IR_MEGABYTES(1024);
+    b8 print_cache_stats = false;
+    for(s32 i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-lazy") == 0)
+        {
+            lazy = true;
+        }
+        else if(strncmp(argv[i], "-cache=", 7) == 0)
+        {
+            cache_dir = &argv[i][7];
+        }
+        else if(strncmp(argv[i], "-cache-size=", 12) == 0)
+        {
+            cache_size = IR_MEGABYTES(strtoull(&argv[i][12], nullptr, 10));
+        }
+        else if(strcmp(argv[i], "-cache-stats") == 0)
+        {
+            print_cache_stats = true;
+        }
+        else if(strncmp(argv[i], "-export=", 8) == 0 && root_count < sizeof(roots) / sizeof(roots[0]))
+        {
+            roots[root_count++] = wrap_asciiz(&argv[i][8]);
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
     
-    Heap_Allocator heap = create_heap(&arena, IR_MEGABYTES(1024), 18);
+    Mapped_File source = {};
+    if(!map_file(path, TOKENIZER_PADDING, &source))
+    {
+        fprintf(stderr, "Could not open '%s'!\n", path);
+        return EXIT_FAILURE;
+    }
+    String file = source.content;
     
-    Token* tokens = tokenize(file, &heap);
+    Heap_Allocator heap = create_heap(&arena, IR_MEGABYTES(1024), 6);
+    Interner symbols = create_interner(&heap);
     
+    //One pass over the whole file, the lexer trusts every multi byte sequence afterwards
+    msi invalid_offset = 0;
+    if(!utf8_validate(file.data, file.length, &invalid_offset))
+    {
+        Line_Index lines = create_line_index(file, &heap);
+        Token invalid = {};
+        invalid.offset = invalid_offset;
+        Token_Location loc = token_location(&lines, invalid);
+        fprintf(stderr, "ERROR(%llu:%llu):\nInvalid UTF-8 byte sequence!\n", loc.line, loc.column);
+        return EXIT_FAILURE;
+    }
     
 #if 0
-    for(msi i = 0; i < ARR_LEN(tokens); ++i)
+    Token_Stream tokens = tokenize(file, &symbols, &heap);
+    Line_Index lines = create_line_index(file, &heap);
+    for(msi i = 0; i < token_stream_len(&tokens); ++i)
     {
-        fprintf(stdout, "Type: %.*s, '%.*s'  Line: %llu  Column: %llu\n", type_to_str(tokens[i].type), tokens[i].text, tokens[i].line, tokens[i].column);
-        // fprintf(stdout, "%.*s", tokens[i].line_text);
+        Token t = token_stream_get(&tokens, i);
+        Token_Location loc = token_location(&lines, t);
+        fprintf(stdout, "Type: %.*s, '%.*s'  Line: %llu  Column: %llu\n", token_type_to_str(t.type), token_text(file, t), loc.line, loc.column);
+        // fprintf(stdout, "%.*s", loc.line_text);
     }
 #endif
     
     
-    AST ast = parse(tokens, &heap);
-    
-    //ast_print_tree(ast.root, &heap);
-     
-    Node_List list = {};
-    list = list = {};
+    //NOTE(Michael): -lazy leaves bodies out, its roots are part of the key
+    Compile_Cache cache = {};
+    b8 use_cache = cache_dir && cache_dir[0] && compile_cache_init(&cache, cache_dir, cache_size);
+    AST ast;
+    Mapped_File cache_entry = {};
+    b8 cache_hit = false;
+    if(use_cache)
+    {
+        String salts[sizeof(roots) / sizeof(roots[0]) + 1] = {wrap_asciiz((c8*)(lazy ? "-lazy" : ""))};
+        for(u32 i = 0; lazy && i < root_count; ++i)
+        {
+            salts[i + 1] = roots[i];
+        }
+        compile_cache_key(&cache, file, salts, lazy ? root_count + 1 : 1);
+        cache_hit = compile_cache_lookup(&cache, file, &symbols, &heap, &cache_entry, &ast);
+        if(!cache_hit && interner_count(&symbols))
+        {
+            free_interner(&symbols);
+            symbols = create_interner(&heap);
+        }
+    }
     
+    //Big files are lexed and their function bodies parsed on all cores, everything else is lexed while parsing
+    u32 thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    b8 big = thread_count > 1 && file.length >= 2 * TOKENIZER_MIN_CHUNK_SIZE;
+    if(!cache_hit)
+    {
+        if(lazy)
+        {
+            Token_Stream tokens = big ? tokenize_parallel(file, &symbols, &heap, thread_count) : tokenize(file, &symbols, &heap);
+            Parse_Skeleton skeleton = {};
+            ast = parse_lazy(&tokens, &heap, roots, root_count, &skeleton);
+        }
+        else if(big)
+        {
+            Token_Stream tokens = tokenize_parallel(file, &symbols, &heap, thread_count);
+            ast = parse_parallel(&tokens, &heap, thread_count);
+        }
+        else
+        {
+            ast = parse(file, &symbols, &heap);
+        }
+        
+        //ast_print_tree(&ast, ast.root, &heap);
+        
+        
+        typer(&ast);
+        
+        if(use_cache)
+        {
+            compile_cache_store(&cache, &ast);
+        }
+    }
     
-    typer(&ast);
     
+    ast_print_tree(&ast, ast.root, &heap);
     
-    ast_print_tree(ast.root, &heap);
+    if(print_cache_stats)
+    {
+        if(use_cache)
+        {
+            Compile_Cache_Stats stats = compile_cache_stats(&cache, &heap);
+            fprintf(stderr, "cache %s: %s, %llu hits, %llu misses, %llu stores, %llu evictions, %llu entries, %llu bytes\n",
+                    cache.dir, cache_hit ? "hit" : "miss", stats.hits, stats.misses, stats.stores, stats.evictions, stats.entries, stats.bytes);
+        }
+        else
+        {
+            fprintf(stderr, "cache: not used, pass -cache=dir or set MLANG_CACHE_DIR\n");
+        }
+    }
     
     return 0;
 }
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 #include "ast.h"
 
@@ -41,13 +42,63 @@ return = "return", expr, ";";
 
 */
 
+/*
+   The parser pulls its tokens through a small ring buffer, either straight from a
+   Tokenizer (lex_token) or from an already tokenized Token_Stream. Only
+   PARSER_LOOKBEHIND tokens behind and PARSER_RING_SIZE - PARSER_LOOKBEHIND - 1 ahead
+   of the current token can be looked at.
+*/
+#define PARSER_RING_SIZE 16
+#define PARSER_RING_MASK (PARSER_RING_SIZE - 1)
+#define PARSER_LOOKBEHIND 2
+
+/*
+   parse_expr is precedence climbing without recursion, what would be the call stack
+   lives in p->expr_stack. EXPR_FRAME_EXPR is one level of precedence climbing: it
+   holds the left operand and, while the right one is parsed, the binary node.
+   Parentheses, casts and prefix operators wait in their own frames for their operand.
+   Nodes are created and errors reported in the same order as a recursive descent.
+*/
+enum Expr_Frame_Type
+{
+    EXPR_FRAME_EXPR,
+    EXPR_FRAME_PAREN,
+    EXPR_FRAME_PREFIX,    //node is the operator, AST_NO_NODE for unary '+'
+    EXPR_FRAME_CAST,
+};
+
+struct Expr_Frame
+{
+    Expr_Frame_Type type;
+    s32 priority;  //Operators binding tighter than this continue the expression
+    b8 has_left;
+    Node_Id left;
+    Node_Id node;
+    Token token;
+};
+
 struct Parser
 {
-    Token* t;
-    Token* tokens;
+    Tokenizer* lexer;       //Source of tokens or nullptr when parsing tokens
+    Token_Stream* tokens;
+    msi stream_index;       //Next token of tokens to pull
+    
+    //Token i (counted from the start) lives in ring[i & PARSER_RING_MASK], the payload of
+    //TOKEN_NUM is i and the decoded value sits in numbers[i & PARSER_RING_MASK]
+    Token ring[PARSER_RING_SIZE];
+    Number_Literal numbers[PARSER_RING_SIZE];
+    msi pulled;             //Number of tokens pulled into the ring so far
+    b8  pulled_eof;
+    
     msi t_index;
     msi last_error_line;
+    Expr_Frame* expr_stack; //Pending operators of parse_expr
     Scope* cur_scope;
+    
+    //NOTE(Michael): Set while parsing function bodies out of order (parse_parallel)
+    b8 defer_errors;        //Errors are only counted, the sequential parse reports them
+    u32 deferred_errors;    //Once non zero the parser only sees TOKEN_EOF
+    u32 globals_end;        //Globals whose Variable token starts here or later are not declared yet
     AST ast;
 };
 
@@ -69,90 +120,196 @@ Scope* parser_create_scope_and_descend(Parser* p)
     return p->cur_scope;
 }
 
-Token* next_token(Parser* p)
+void parser_error(Parser* p, Token t, c8* f_msg, ...);
+String token_text(Parser* p, Token t);
+
+static
+void parser_pull_token(Parser* p)
+{
+    msi slot = p->pulled & PARSER_RING_MASK;
+    Token t;
+    for(;;)
+    {
+        if(p->deferred_errors)
+        {
+            t = {};
+            t.type = TOKEN_EOF;
+            t.offset = (u32)p->ast.file.length;
+        }
+        else if(p->lexer)
+        {
+            t = lex_token(p->lexer, &p->numbers[slot]);
+        }
+        else
+        {
+            t = token_stream_get(p->tokens, p->stream_index++);
+            if(t.type == TOKEN_NUM)
+            {
+                p->numbers[slot] = p->tokens->numbers[t.payload];
+            }
+        }
+        
+        //Characters the lexer could not place are reported once and never reach the grammar
+        if(t.type != TOKEN_INVALID)
+        {
+            break;
+        }
+        parser_error(p, t, "Unexpected character '%.*s'!", IR_EXP_STR(token_text(p, t)));
+    }
+    
+    if(t.type == TOKEN_NUM)
+    {
+        t.payload = p->pulled;
+    }
+    
+    p->pulled_eof = t.type == TOKEN_EOF;
+    p->ring[slot] = t;
+    ++p->pulled;
+}
+
+//Token at absolute index i, everything after the EOF token is the EOF token
+static
+Token parser_token_at(Parser* p, s64 i)
+{
+    while((s64)p->pulled <= i && !p->pulled_eof)
+    {
+        parser_pull_token(p);
+    }
+    
+    if(i < 0)
+    {
+        Token result = {};
+        result.type = TOKEN_EOF;
+        return result;
+    }
+    
+    if(i >= (s64)p->pulled)
+    {
+        return p->ring[(p->pulled - 1) & PARSER_RING_MASK];
+    }
+    
+    IR_ASSERT(i + PARSER_RING_SIZE > (s64)p->pulled && "Token fell out of the parser ring!");
+    return p->ring[i & PARSER_RING_MASK];
+}
+
+Number_Literal* parser_number_literal(Parser* p, Token t)
+{
+    IR_ASSERT(t.type == TOKEN_NUM && t.payload + PARSER_RING_SIZE > p->pulled);
+    return &p->numbers[t.payload & PARSER_RING_MASK];
+}
+
+Token next_token(Parser* p)
 {
-    Token* result = p->t;
-    if(p->t->type != TOKEN_EOF)
+    Token result = parser_token_at(p, p->t_index);
+    if(result.type != TOKEN_EOF)
     {
         ++p->t_index;
     }
-    p->t = &p->tokens[p->t_index];
     return result;
 }
 
-Token* prev_token(Parser* p)
+Token prev_token(Parser* p)
 {
     if(p->t_index > 0)
     {
         --p->t_index;
     }
-    p->t = &p->tokens[p->t_index];
-    return p->t;
+    return parser_token_at(p, p->t_index);
 }
 
-void parser_error( Parser* p, Token* t, c8* f_msg, ...)
+//Index of the current token in p->tokens, only for parsers reading a Token_Stream
+inline
+msi parser_stream_index(Parser* p)
+{
+    IR_ASSERT(!p->lexer);
+    return p->stream_index - (p->pulled - p->t_index);
+}
+
+//Continues with token stream_index of p->tokens, tokens that were looked ahead at are dropped
+static
+void parser_skip_to(Parser* p, msi stream_index)
+{
+    IR_ASSERT(!p->lexer);
+    p->stream_index = stream_index;
+    p->pulled = p->t_index;
+    p->pulled_eof = false;
+}
+
+void parser_error( Parser* p, Token t, c8* f_msg, ...)
 {
-    if(p->last_error_line ==  t->line)
+    if(p->defer_errors)
+    {
+        p->deferred_errors++;
+        return;
+    }
+    
+    Token_Location loc = token_location(&p->ast.lines, t);
+    if(p->last_error_line == loc.line)
     {
         exit(EXIT_FAILURE);   
     }
-    fprintf(stderr, "ERROR(%llu:%llu):\n", t->line, t->column);
+    fprintf(stderr, "ERROR(%llu:%llu):\n", loc.line, loc.column);
     va_list valist;
     va_start(valist, f_msg);
     vfprintf(stderr, f_msg, valist);
     va_end(valist);
-    fprintf(stderr, "\n%.*s", t->line_text);
-    msi heading_whitespace = count_heading_whitespace_token_line(t);
-    for(msi i = 1 ; i < t->column - heading_whitespace; ++i)
+    fprintf(stderr, "\n%.*s", loc.line_text);
+    for(msi i = 1 ; i < loc.column - loc.heading_whitespace; ++i)
     {
         fprintf(stderr, " ");   
     }
     fprintf(stderr, "^\n");
-    p->last_error_line = t->line;
+    p->last_error_line = loc.line;
 }
 
+Token_Type peek_type(Parser* p, s64 i = 0)
+{
+    return parser_token_at(p, (s64)p->t_index + i).type;
+}
 
-Token* peek_token(Parser* p)
+Token peek_token(Parser* p)
 {
-    return &p->tokens[p->t_index];
+    return parser_token_at(p, p->t_index);
 }
 
-Token* peek_token(Parser* p, msi i)
+Token peek_token(Parser* p, s64 i)
 {
-    msi len = ARR_LEN(p->tokens);
-    if(len > p->t_index + i)
-    {
-        return &p->tokens[p->t_index + i];   
-    }
-    return &p->tokens[len -1];
+    return parser_token_at(p, (s64)p->t_index + i);
 }
 
 
-Token* jmp_next_line(Parser* p)
+Token jmp_next_line(Parser* p)
 {
-    Token* t = peek_token(p);
-    while(next_token(p)->line== t->line)
+    Token t = peek_token(p);
+    while(peek_type(p) != TOKEN_EOF)
     {
-        
+        Token next = next_token(p);
+        msi end = next.offset + next.length;
+        if(scan_to_end_of_line(p->ast.file.data, t.offset, end) != end)
+        {
+            prev_token(p);
+            break;
+        }
     }
-    return peek_token(p);;
+    return peek_token(p);
 }
 
-Parser init_parser(Token* tokens, Heap_Allocator* heap)
+static
+void init_parser(Parser* p, String file, Interner* symbols, Heap_Allocator* heap)
 {
-    IR_NOT_NULL(tokens);
-    Parser p = {};
-    p.tokens = tokens;
-    p.t = &tokens[0];
-    p.ast.heap = heap;
-    BA_INIT(p.ast.nodes_ba, 2, heap);
-    BA_INIT(p.ast.functions_ba, 2, heap);
-    BA_INIT(p.ast.scopes_ba, 2, heap);
-    BA_INIT(p.ast.variables_ba, 2, heap);
-    p.ast.global_scope = ast_create_scope(nullptr, &p.ast);
-    p.cur_scope = p.ast.global_scope;
-    
-    return p;
+    p->ast.heap = heap;
+    p->ast.file = file;
+    p->ast.symbols = symbols;
+    p->ast.lines = create_line_index(file, heap);
+    ARR_INIT(p->ast.nodes, 64, heap);
+    ARR_PUSH(p->ast.nodes, (Node){}); //AST_NO_NODE
+    ARR_INIT(p->expr_stack, 64, heap);
+    SLAB_INIT(p->ast.functions, Function, IR_KILOBYTES(16), heap);
+    SLAB_INIT(p->ast.scopes, Scope, IR_KILOBYTES(16), heap);
+    SLAB_INIT(p->ast.variables, Variable, IR_KILOBYTES(16), heap);
+    p->ast.global_scope = ast_create_scope(nullptr, &p->ast);
+    p->cur_scope = p->ast.global_scope;
+    p->globals_end = 0xFFFFFFFF;
 }
 
 
@@ -163,8 +320,9 @@ b8 peek_pattern(Parser* p, int num_args,  ...)
     va_start(args, num_args);
     for(msi i = 0; i < num_args; ++i)
     {
-        Token_Type next = va_arg(args, Token_Type);
-        if(peek_token(p, i)->type != next)
+        //NOTE(Michael): Enums are promoted to int when passed through '...'
+        Token_Type next = (Token_Type)va_arg(args, int);
+        if(peek_type(p, i) != next)
         {
             result = false;
             break;
@@ -175,56 +333,78 @@ b8 peek_pattern(Parser* p, int num_args,  ...)
     return result;
 }
 
-String token_text(Token* t)
+String token_text(Parser* p, Token t)
 {
     String result = IR_CONSTZ("NULL");
-    if(t)
+    if(t.type != TOKEN_UNKOWN)
     {
-        result = t->text;
+        result = token_text(p->ast.file, t);
     }
     
     return result;
 }
 
-Type token_data_type(Token* t)
+//The lexer interns every TOKEN_ID, after an error t can be anything else
+inline
+Symbol_Id token_symbol(Parser* p, Token t)
+{
+    return t.type == TOKEN_ID ? t.payload : intern(p->ast.symbols, token_text(p, t));
+}
+
+Type token_data_type(Token t)
 {
     Type result = TYPE_UNKNOWN;
-    if(t)
+    if(t.type == TOKEN_BASIC_TYPE)
     {
-        result = t->data_type;
+        result = (Type)t.payload;
     }
     
     return result;
 }
 
-Token* accept(Token_Type t, Parser* p)
+/*
+   A function body only sees the globals declared above the function. Parsed in order
+   the later ones are not in the global scope yet, a body parsed out of order hides
+   them through globals_end.
+*/
+inline
+Variable* parser_search_var(Parser* p, Symbol_Id name)
 {
-    Token* result = nullptr;
-    if(t == p->t->type)
+    Variable* result = ast_search_var_from_scope_and_name(name, p->cur_scope);
+    if(result && result->scope == p->ast.global_scope && result->token.offset >= p->globals_end)
     {
-        result = p->t;
-        next_token(p);
+        result = nullptr;
+    }
+    return result;
+}
+
+//NOTE(Michael): Returns a token with type TOKEN_UNKOWN if the current token doesn't match
+Token accept(Token_Type t, Parser* p)
+{
+    Token result = {};
+    if(t == peek_type(p))
+    {
+        result = next_token(p);
     }
     return result;;
 }
 
 inline
-Token* accept(c8 t, Parser* p)
+Token accept(c8 t, Parser* p)
 {
     return accept((Token_Type)t, p);
 }
 inline
-Token* expect(Token_Type t, Parser* p)
+Token expect(Token_Type t, Parser* p)
 {
-    Token* result = nullptr;
-    result = accept(t, p);
-    if(!result)
+    Token result = accept(t, p);
+    if(result.type == TOKEN_UNKOWN)
     {
-
-        parser_error(p, peek_token(p),
+        Token cur = peek_token(p);
+        parser_error(p, cur,
               "Unexpected Token expected '%.*s' got '%.*s'",
               token_type_to_str(t).length, token_type_to_str(t).data,
-              peek_token(p)->text.length, peek_token(p)->text.data);
+              IR_EXP_STR(token_text(p, cur)));
     }
     
     return result;
@@ -233,282 +413,366 @@ Token* expect(Token_Type t, Parser* p)
 
 
 inline
-Token* expect(c8 t, Parser* p)
+Token expect(c8 t, Parser* p)
 {
     return expect((Token_Type)t, p);
 }
 
-Node* parse_term(Parser* p);
-Node* parse_expr(Parser* p, s64 cur_priority = -999)
+struct Expr_Operator
+{
+    Token_Type token;
+    Expr_Op_Type type;
+    s32 priority;
+    b8 right_assoc;
+};
+
+/*
+   Binary operators, a higher priority binds tighter. build_expr_operator_table()
+   turns the list into a lookup by token type at compile time.
+*/
+static constexpr Expr_Operator binary_operators[] =
 {
-    Node* result = nullptr;
-    Node* left_expr = parse_term(p);
+    {(Token_Type)'*', EX_B_MUL,    100, false},
+    {(Token_Type)'/', EX_B_DIV,    100, false},
+    {(Token_Type)'%', EX_B_MOD,    100, false},
     
-    while(left_expr)
-    {
-        s64 op_priority = -9999;
-        Expr exp = {};        
-        Token* t = peek_token(p);
-        switch(t->type)
-        {
-            case '*': exp.type = EX_B_MUL;                  op_priority = 100; break;
-            case '/': exp.type = EX_B_DIV;                  op_priority = 100; break;
-            case '%': exp.type = EX_B_MOD;                  op_priority = 100; break;
-            
-            case '+': exp.type = EX_B_ADD;                  op_priority = 90;  break;   
-            case '-': exp.type = EX_B_SUB;                  op_priority = 90;  break;  
-            
-            case TOKEN_SHIFT_L: exp.type = EX_B_SHIFTL;     op_priority = 80;  break;   
-            case TOKEN_SHIFT_R: exp.type = EX_B_SHIFTR;     op_priority = 80;  break; 
-            
-            case '<': exp.type = EX_C_LT;                   op_priority = 70;  break;   
-            case '>': exp.type = EX_C_GT;                   op_priority = 70;  break;   
-            case TOKEN_LEQ: exp.type = EX_C_LTEQ;           op_priority = 70;  break;   
-            case TOKEN_GEQ: exp.type = EX_C_GTEQ;           op_priority = 70;  break;
-            
-            case TOKEN_D_EQ: exp.type = EX_C_EQ;            op_priority = 60;  break;   
-            case TOKEN_NOTEQ: exp.type = EX_C_NEQ;          op_priority = 60;  break;
-            
-            case '&': exp.type = EX_B_AND;                  op_priority = 50;  break; 
-            case '^': exp.type = EX_B_XOR;                  op_priority = 40;  break;
-            case '|': exp.type = EX_B_OR;                   op_priority = 30;  break;
-            case TOKEN_AND: exp.type = EX_C_AND;            op_priority = 20;  break;
-            case TOKEN_OR: exp.type = EX_C_OR;              op_priority = 10;  break;   
-            default: break;    
-        }
-        
-        if(exp.type != EX_UNKNOWN)
-        {
-            if(op_priority > cur_priority)
-            {
-                next_token(p);
-                result = ast_create_node(p->cur_scope, t, &p->ast);
-                result->type=N_EXPR;
-                result->exp = exp;
-                
-                Node* right_expr = nullptr;
-                right_expr = parse_expr(p, op_priority);
-                
-                ast_node_add_child(result, left_expr, &p->ast);
-                ast_node_add_child(result, right_expr, &p->ast);
-                
-                if(!right_expr)
-                {
-                    parser_error(p, t, "Expected expression after '%.*s'", token_text(t));
-                }
-                
-                left_expr = result;
-            }
-            else
-            {
-                result = left_expr;
-                break;
-            }
-        }
-        else
-        {
-            result = left_expr;
-            break;
-        }   
-    }
+    {(Token_Type)'+', EX_B_ADD,     90, false},
+    {(Token_Type)'-', EX_B_SUB,     90, false},
     
+    {TOKEN_SHIFT_L,   EX_B_SHIFTL,  80, false},
+    {TOKEN_SHIFT_R,   EX_B_SHIFTR,  80, false},
     
+    {(Token_Type)'<', EX_C_LT,      70, false},
+    {(Token_Type)'>', EX_C_GT,      70, false},
+    {TOKEN_LEQ,       EX_C_LTEQ,    70, false},
+    {TOKEN_GEQ,       EX_C_GTEQ,    70, false},
+    
+    {TOKEN_D_EQ,      EX_C_EQ,      60, false},
+    {TOKEN_NOTEQ,     EX_C_NEQ,     60, false},
+    
+    {(Token_Type)'&', EX_B_AND,     50, false},
+    {(Token_Type)'^', EX_B_XOR,     40, false},
+    {(Token_Type)'|', EX_B_OR,      30, false},
+    {TOKEN_AND,       EX_C_AND,     20, false},
+    {TOKEN_OR,        EX_C_OR,      10, false},
+};
+
+//Prefix operators that become an N_EXPR with the operand as child, unary '+' is dropped
+static constexpr Expr_Operator prefix_operators[] =
+{
+    {(Token_Type)'-', EX_U_SUB,        0, false},
+    {TOKEN_D_PLUS,    EX_U_PREINC,     0, false},
+    {TOKEN_D_MINUS,   EX_U_PREDEC,     0, false},
+    {(Token_Type)'!', EX_U_LOGIC_INV,  0, false},
+    {(Token_Type)'~', EX_U_BIN_INV,    0, false},
+};
+
+#define BINARY_OPERATOR_COUNT (sizeof(binary_operators)/sizeof(binary_operators[0]))
+#define PREFIX_OPERATOR_COUNT (sizeof(prefix_operators)/sizeof(prefix_operators[0]))
+#define EXPR_NO_PRIORITY -999
+
+struct Expr_Operator_Table
+{
+    Expr_Operator binary[256]; //By Token_Type, type is EX_UNKNOWN if the token is no operator
+    Expr_Operator prefix[256];
+};
+
+constexpr
+Expr_Operator_Table build_expr_operator_table()
+{
+    Expr_Operator_Table result = {};
+    for(msi i = 0; i < BINARY_OPERATOR_COUNT; ++i)
+    {
+        result.binary[binary_operators[i].token & 0xFF] = binary_operators[i];
+    }
+    for(msi i = 0; i < PREFIX_OPERATOR_COUNT; ++i)
+    {
+        result.prefix[prefix_operators[i].token & 0xFF] = prefix_operators[i];
+    }
     return result;
 }
 
-Node* parse_term(Parser* p)
+static constexpr Expr_Operator_Table expr_operator_table = build_expr_operator_table();
+
+inline
+b8 parser_binds_tighter(Token_Type type, s32 priority)
 {
-    Node* result = nullptr;
-    Token* t = peek_token(p);
-    
-    Expr_Op_Type unary_expr_type = EX_UNKNOWN;
+    const Expr_Operator* op = &expr_operator_table.binary[type & 0xFF];
+    return op->type != EX_UNKNOWN && op->priority > priority;
+}
+
+//Returns the next binary operator if it binds tighter than priority
+inline
+const Expr_Operator* parser_binary_operator(Parser* p, s32 priority)
+{
+    Token_Type type = peek_type(p);
+    return parser_binds_tighter(type, priority) ? &expr_operator_table.binary[type & 0xFF] : nullptr;
+}
+
+//Leaves of the expression, pushes frames for prefix operators and parentheses
+static
+Node_Id parse_operand(Parser* p, b8* is_leaf)
+{
+    Token t = peek_token(p);
+    *is_leaf = true;
     
-    switch(t->type)
+    switch(t.type)
     {
         case '(':
         {
             next_token(p);
-            result = parse_expr(p);
-            if(!expect(')', p))
-            {
-                parser_error(p, t, "Missing ')' for subexpression!");   
-            }
-            break;
+            Expr_Frame paren = {EXPR_FRAME_PAREN};
+            paren.token = t;
+            ARR_PUSH(p->expr_stack, paren);
+            Expr_Frame expr = {EXPR_FRAME_EXPR, EXPR_NO_PRIORITY};
+            ARR_PUSH(p->expr_stack, expr);
+            *is_leaf = false;
+            return AST_NO_NODE;
         }
         case '+':
         {
             next_token(p);
-            result = parse_term(p);
-            if(!result)
-            {
-                parser_error(p, t, "Expected term after Unary '%.*s'", t->text); 
-            }
-            break;
-        }
-        case '-':
-        {
-            next_token(p);
-            unary_expr_type = EX_U_SUB;
-            break;   
-        }
-        case TOKEN_D_PLUS:
-        {
-            next_token(p);
-            unary_expr_type = EX_U_PREINC;
-            break;   
-        }
-        case TOKEN_D_MINUS:
-        {
-            next_token(p);
-            unary_expr_type = EX_U_PREDEC;
-            break;   
-        }
-        case '!':
-        {
-            next_token(p);
-            unary_expr_type = EX_U_LOGIC_INV;
-            break;   
-        }
-        case '~':
-        {
-            next_token(p);
-            unary_expr_type = EX_U_BIN_INV;
-            break;   
+            Expr_Frame frame = {EXPR_FRAME_PREFIX};
+            frame.token = t;
+            ARR_PUSH(p->expr_stack, frame);
+            *is_leaf = false;
+            return AST_NO_NODE;
         }
         case TOKEN_CAST:
         {
             next_token(p);
             expect('(', p);
-            result = ast_create_node(p->cur_scope, t, &p->ast);
-            result->type = N_EXPR;
-            result->exp.type = EX_U_CAST;
-            result->exp.result_type = token_data_type(expect(TOKEN_BASIC_TYPE, p));
+            Expr_Frame frame = {EXPR_FRAME_CAST};
+            frame.token = t;
+            frame.node = ast_create_node(N_EXPR, t, &p->ast);
+            Type cast_type = token_data_type(expect(TOKEN_BASIC_TYPE, p));
+            Node* cast = ast_node(&p->ast, frame.node);
+            cast->exp.type = EX_U_CAST;
+            cast->exp.result_type = cast_type;
             expect(')', p);
-            
-            Node* term = parse_term(p);
-            if(!term)
-            {
-                parser_error(p, t, "Expected term or subexpression after cast!"); 
-            }
-            ast_node_add_child(result, term, &p->ast); 
-            break;
+            ARR_PUSH(p->expr_stack, frame);
+            *is_leaf = false;
+            return AST_NO_NODE;
         }
         case TOKEN_NUM:
         {
-            //TODO(Michael) BETTER CONSTANTS!
-            result = ast_create_node(p->cur_scope, t, &p->ast);
-            result->type = N_CONSTANT;
-            Token* num_tok = next_token(p);
-            u8* endptr = num_tok->text.data+num_tok->text.length;
-            if(search_string_first_occurrence(num_tok->text, '.').length > 0)
+            Node_Id result = ast_create_node(N_CONSTANT, t, &p->ast);
+            Token num_tok = next_token(p);
+            Number_Literal* literal = parser_number_literal(p, num_tok);
+            if(literal->error)
             {
-                //FLOAT
-                result->con.type=TYPE_F64;
-                result->con.f_value = strtod(num_tok->text.data, &endptr);
-                if(endptr == num_tok->text.data)
-                {
-                    parser_error(p, num_tok, "Failed to convert floating point constant!");
-                }
+                parser_error(p, num_tok, "%.*s", IR_EXP_STR(number_error_to_str(literal->error)));
+            }
+            Node* constant = ast_node(&p->ast, result);
+            constant->con.type = literal->type;
+            constant->con.has_suffix = literal->has_suffix;
+            if(data_type_is_floating_point(literal->type))
+            {
+                constant->con.f_value = literal->f_value;
             }
             else
             {
-                //INTEGER
-                result->con.type=TYPE_S64;
-                result->con.s_value = strtoll(num_tok->text.data, &endptr, 10);
-                if(endptr == num_tok->text.data)
-                {
-                    parser_error(p, num_tok, "Failed to convert integer constant!");
-                }
+                constant->con.s_value = literal->s_value;
             }
-            break;
+            return result;
         }
         case TOKEN_ID:
         {
-            Token* var_tok = next_token(p);
-            result = ast_create_node(p->cur_scope, var_tok, &p->ast);
-            result->type = N_VAR;
-            result->var = ast_search_var_from_scope_and_name(var_tok->text, p->cur_scope);
+            Token var_tok = next_token(p);
+            Node_Id result = ast_create_node(N_VAR, var_tok, &p->ast);
+            Variable* var = parser_search_var(p, token_symbol(p, var_tok));
+            ast_node(&p->ast, result)->var = var;
             
-            if(!result->var)
+            if(!var)
             {
-                parser_error(p, var_tok, "Use of undeclared identifier '%.*s'!", var_tok->text);
+                parser_error(p, var_tok, "Use of undeclared identifier '%.*s'!", token_text(p, var_tok));
             }
-            
-            break;
+            return result;
         }
         default: break;
     }
     
-    if(unary_expr_type != EX_UNKNOWN)
+    const Expr_Operator* prefix = &expr_operator_table.prefix[t.type & 0xFF];
+    if(prefix->type != EX_UNKNOWN)
     {
-        result = ast_create_node(p->cur_scope, t, &p->ast);
-        result->type = N_EXPR;
-        result->exp.type = unary_expr_type;
-        Node* term = parse_term(p);
-        if(!term)
+        next_token(p);
+        Expr_Frame frame = {EXPR_FRAME_PREFIX};
+        frame.token = t;
+        frame.node = ast_create_node(N_EXPR, t, &p->ast);
+        ast_node(&p->ast, frame.node)->exp.type = prefix->type;
+        ARR_PUSH(p->expr_stack, frame);
+        *is_leaf = false;
+    }
+    return AST_NO_NODE;
+}
+
+Node_Id parse_expr(Parser* p, s32 priority = EXPR_NO_PRIORITY)
+{
+    b8 need_operand;
+    Token_Type operand = peek_type(p);
+    if((operand == TOKEN_NUM || operand == TOKEN_ID) && !parser_binds_tighter(peek_type(p, 1), priority))
+    {
+        return parse_operand(p, &need_operand);
+    }
+    
+    msi base = ARR_LEN(p->expr_stack);
+    Expr_Frame first = {EXPR_FRAME_EXPR, priority};
+    ARR_PUSH(p->expr_stack, first);
+    
+    Node_Id value = AST_NO_NODE;
+    need_operand = true;
+    while(ARR_LEN(p->expr_stack) > base)
+    {
+        if(need_operand)
         {
-            parser_error(p, t, "Expected term after Unary '%.*s'", t->text); 
+            value = parse_operand(p, &need_operand);
+            need_operand = !need_operand;
+            continue;
+        }
+        
+        //value is the finished operand of the innermost frame
+        Expr_Frame* frame = &p->expr_stack[ARR_LEN(p->expr_stack) - 1];
+        switch(frame->type)
+        {
+            case EXPR_FRAME_PAREN:
+            {
+                if(expect(')', p).type == TOKEN_UNKOWN)
+                {
+                    parser_error(p, frame->token, "Missing ')' for subexpression!");   
+                }
+                ARR_POP(p->expr_stack);
+                break;
+            }
+            case EXPR_FRAME_PREFIX:
+            case EXPR_FRAME_CAST:
+            {
+                if(!value)
+                {
+                    if(frame->type == EXPR_FRAME_CAST)
+                    {
+                        parser_error(p, frame->token, "Expected term or subexpression after cast!"); 
+                    }
+                    else
+                    {
+                        parser_error(p, frame->token, "Expected term after Unary '%.*s'", token_text(p, frame->token));
+                    }
+                }
+                if(frame->node)
+                {
+                    ast_node_add_child(frame->node, value, &p->ast);
+                    value = frame->node;
+                }
+                ARR_POP(p->expr_stack);
+                break;
+            }
+            case EXPR_FRAME_EXPR:
+            {
+                if(!frame->has_left)
+                {
+                    if(!value)
+                    {
+                        ARR_POP(p->expr_stack);
+                        break;
+                    }
+                    frame->has_left = true;
+                }
+                else
+                {
+                    ast_node_add_child(frame->node, frame->left, &p->ast);
+                    ast_node_add_child(frame->node, value, &p->ast);
+                    if(!value)
+                    {
+                        parser_error(p, frame->token, "Expected expression after '%.*s'", token_text(p, frame->token));
+                    }
+                    value = frame->node;
+                }
+                frame->left = value;
+                
+                const Expr_Operator* op = parser_binary_operator(p, frame->priority);
+                if(!op)
+                {
+                    ARR_POP(p->expr_stack);
+                    break;
+                }
+                
+                frame->token = next_token(p);
+                frame->node = ast_create_node(N_EXPR, frame->token, &p->ast);
+                ast_node(&p->ast, frame->node)->exp.type = op->type;
+                
+                s32 right_priority = op->right_assoc ? op->priority - 1 : op->priority;
+                
+                //NOTE(Michael): Most right operands are a single number or name followed by an operator
+                //               that does not bind tighter, those go into this frame without a push
+                Token_Type operand = peek_type(p);
+                if((operand == TOKEN_NUM || operand == TOKEN_ID) && !parser_binds_tighter(peek_type(p, 1), right_priority))
+                {
+                    value = parse_operand(p, &need_operand);
+                    need_operand = false;
+                    break;
+                }
+                
+                Expr_Frame right = {EXPR_FRAME_EXPR, right_priority};
+                ARR_PUSH(p->expr_stack, right);
+                need_operand = true;
+                break;
+            }
         }
-        ast_node_add_child(result, term, &p->ast);   
     }
     
-    return result;
+    return value;
 }
 
 
 
-Node* parse_var_decl(Parser* p)
+Node_Id parse_var_decl(Parser* p)
 {
-    Node* result = nullptr;
+    Node_Id result = AST_NO_NODE;
     
     if(peek_pattern(p, 2, TOKEN_BASIC_TYPE, TOKEN_ID))
     {
         Type var_type = token_data_type(expect(TOKEN_BASIC_TYPE, p));
-        String var_name = token_text(expect(TOKEN_ID, p));
+        Token name_tok = expect(TOKEN_ID, p);
         
-        result = ast_create_node(p->cur_scope, peek_token(p, -1), &p->ast);
-        result->type = N_VAR_DECL;
+        result = ast_create_node(N_VAR_DECL, peek_token(p, -1), &p->ast);
         
-        Node* var_node = result;
+        Node_Id var_node = result;
         
-        if(accept('=', p))
+        if(accept('=', p).type != TOKEN_UNKOWN)
         {
-            Node* assign_expr = parse_expr(p);
+            Node_Id assign_expr = parse_expr(p);
             if(!assign_expr)
             {
                 parser_error(p, peek_token(p, -1), "Expected expression after '=' in variable declaration!");   
             }
             else
             {
-                Node* decl = result;
-                result = ast_create_node(p->cur_scope, result->info.token, &p->ast);
-                result->type = N_ASSIGN;
+                Node_Id decl = result;
+                result = ast_create_node(N_ASSIGN, ast_node(&p->ast, decl)->info.token, &p->ast);
                 ast_node_add_child(result, decl, &p->ast);
                 ast_node_add_child(result, assign_expr, &p->ast);
             }
             expect(';', p);
         }
-        else if(!accept(';', p))
+        else if(accept(';', p).type == TOKEN_UNKOWN)
         {
             parser_error(p, peek_token(p), "Can only use simple assign '=' or ';' when declaring a variable!");
         }
         
-        Variable* var = ast_create_var(p->cur_scope, peek_token(p, 1), &p->ast);
+        Variable* var = ast_create_var(p->cur_scope, peek_token(p, 1), token_symbol(p, name_tok), &p->ast);
         var->type = var_type;
-        var->name = var_name;
-        var_node->var = var;
+        ast_node(&p->ast, var_node)->var = var;
         
     }
     
     return result;
 }
 
-Node* parse_assign(Parser* p)
+Node_Id parse_assign(Parser* p)
 {
-    Node* result = nullptr;
-    if(peek_token(p)->type == TOKEN_ID)
+    Node_Id result = AST_NO_NODE;
+    if(peek_type(p) == TOKEN_ID)
     {
-        Token_Type token_type = peek_token(p, 1)->type;
+        Token_Type token_type = peek_type(p, 1);
         Expr_Op_Type op_type = EX_UNKNOWN;
         switch(token_type)
         {
@@ -572,44 +836,40 @@ Node* parse_assign(Parser* p)
             }
         }
         
-        Token* id_tok = expect(TOKEN_ID, p);
-        Node* var_node = ast_create_node(p->cur_scope, id_tok, &p->ast);
-        var_node->type = N_VAR;
-        var_node->var = ast_search_var_from_scope_and_name(id_tok->text, p->cur_scope);
+        Token id_tok = expect(TOKEN_ID, p);
+        Node_Id var_node = ast_create_node(N_VAR, id_tok, &p->ast);
+        Variable* var = parser_search_var(p, token_symbol(p, id_tok));
+        ast_node(&p->ast, var_node)->var = var;
         
-        if(!var_node->var)
+        if(!var)
         {
-            parser_error(p, id_tok, "Trying to assign to undeclared identifier '%.*s'!", id_tok->text);
+            parser_error(p, id_tok, "Trying to assign to undeclared identifier '%.*s'!", token_text(p, id_tok));
         }
         
-        Token* assign_tok = next_token(p);
+        Token assign_tok = next_token(p);
         
-        Node* expr_node = parse_expr(p);
+        Node_Id expr_node = parse_expr(p);
         
         if(!expr_node)
         {
-            parser_error(p, assign_tok, "Expected expression after assign '%.*s'!", assign_tok->text);
+            parser_error(p, assign_tok, "Expected expression after assign '%.*s'!", token_text(p, assign_tok));
         }
         
         if(op_type != EX_UNKNOWN)
         {
-            Node* new_expr = ast_create_node(p->cur_scope, assign_tok, &p->ast);
-            new_expr->type = N_EXPR;
-            new_expr->exp.type = op_type;
+            Node_Id new_expr = ast_create_node(N_EXPR, assign_tok, &p->ast);
+            ast_node(&p->ast, new_expr)->exp.type = op_type;
             
             ast_node_add_child(new_expr, var_node, &p->ast);
             ast_node_add_child(new_expr, expr_node, &p->ast);
             
             expr_node = new_expr;
             
-            Variable* var = var_node->var;
-            var_node = ast_create_node(p->cur_scope, id_tok, &p->ast);
-            var_node->type = N_VAR;
-            var_node->var = var;
+            var_node = ast_create_node(N_VAR, id_tok, &p->ast);
+            ast_node(&p->ast, var_node)->var = var;
         }
         
-        result = ast_create_node(p->cur_scope, assign_tok, &p->ast);
-        result->type = N_ASSIGN;
+        result = ast_create_node(N_ASSIGN, assign_tok, &p->ast);
         
         
         ast_node_add_child(result, var_node, &p->ast);
@@ -624,33 +884,31 @@ Node* parse_assign(Parser* p)
     return result;
 }
 
-Node* parse_return(Parser* p)
+Node_Id parse_return(Parser* p)
 {
-    Node* result = nullptr;
-    if(accept(TOKEN_RETURN, p))
+    Node_Id result = AST_NO_NODE;
+    if(accept(TOKEN_RETURN, p).type != TOKEN_UNKOWN)
     {
         
-        result = ast_create_node(p->cur_scope, peek_token(p, -1), &p->ast);
-        result->type = N_RETURN;
+        result = ast_create_node(N_RETURN, peek_token(p, -1), &p->ast);
         
-        Node* e = parse_expr(p);
+        Node_Id e = parse_expr(p);
         ast_node_add_child(result, e, &p->ast);
         expect(';', p);
     }
     return result;
 }
 
-Node* parse_statement(Parser* p);
-Node* parse_statement_seq(Parser* p);
-Node* parse_if_else(Parser* p)
+Node_Id parse_statement(Parser* p);
+Node_Id parse_statement_seq(Parser* p);
+Node_Id parse_if_else(Parser* p)
 {
-    Node* result = nullptr;
-    Token* if_tok = accept(TOKEN_IF, p);
-    if(if_tok)
+    Node_Id result = AST_NO_NODE;
+    Token if_tok = accept(TOKEN_IF, p);
+    if(if_tok.type != TOKEN_UNKOWN)
     {
-        result = ast_create_node(p->cur_scope, if_tok, &p->ast);
-        result->type = N_IF;
-        Node* expr_node = parse_expr(p);
+        result = ast_create_node(N_IF, if_tok, &p->ast);
+        Node_Id expr_node = parse_expr(p);
         
         if(!expr_node)
         {
@@ -658,18 +916,17 @@ Node* parse_if_else(Parser* p)
         }
         
         ast_node_add_child(result, expr_node, &p->ast);
-        Node* stmnt = parse_statement(p);
+        Node_Id stmnt = parse_statement(p);
         ast_node_add_child(result, stmnt, &p->ast);        
         
-        Token* else_tok = accept(TOKEN_ELSE, p);
+        Token else_tok = accept(TOKEN_ELSE, p);
         
-        if(else_tok)
+        if(else_tok.type != TOKEN_UNKOWN)
         {
             
-            Node* else_node = ast_create_node(p->cur_scope, else_tok, &p->ast);
-            else_node->type = N_ELSE;
+            Node_Id else_node = ast_create_node(N_ELSE, else_tok, &p->ast);
             
-            Node* stmnt_node = parse_statement(p); 
+            Node_Id stmnt_node = parse_statement(p); 
             ast_node_add_child(else_node, stmnt_node, &p->ast); 
  
             ast_node_add_child(result, else_node, &p->ast);
@@ -680,9 +937,9 @@ Node* parse_if_else(Parser* p)
     return result;
 }
 
-Node* parse_statement(Parser* p)
+Node_Id parse_statement(Parser* p)
 {
-    Node* result = nullptr;
+    Node_Id result = AST_NO_NODE;
     if((result = parse_return(p)))
     {}
     else if((result = parse_var_decl(p)))
@@ -691,7 +948,7 @@ Node* parse_statement(Parser* p)
     {}   
     else if((result = parse_if_else(p)))
     {} 
-    else if(accept('{', p))
+    else if(accept('{', p).type != TOKEN_UNKOWN)
     {
         parser_create_scope_and_descend(p);
         result = parse_statement_seq(p);
@@ -703,16 +960,15 @@ Node* parse_statement(Parser* p)
     return result;
 }
 
-Node* parse_statement_seq(Parser* p)
+Node_Id parse_statement_seq(Parser* p)
 {
-    Node* result = nullptr;
+    Node_Id result = AST_NO_NODE;
     
-    Node* stmnt = parse_statement(p);
+    Node_Id stmnt = parse_statement(p);
     
     if(stmnt)
     {
-        result = ast_create_node(p->cur_scope, stmnt->info.token, &p->ast);
-        result->type = N_STATEMENT_SEQ;
+        result = ast_create_node(N_STATEMENT_SEQ, ast_node(&p->ast, stmnt)->info.token, &p->ast);
         
         ast_node_add_child(result, stmnt, &p->ast);
         
@@ -725,10 +981,11 @@ Node* parse_statement_seq(Parser* p)
     return result;
 }
 
-Node* parse_function(Parser* p)
+//Everything up to the '{' of the body, leaves the parser in the scope of the function
+Node_Id parse_function_signature(Parser* p)
 {
     Type return_type = token_data_type(expect(TOKEN_BASIC_TYPE, p));
-    String id = token_text(expect(TOKEN_ID, p));
+    Symbol_Id id = token_symbol(p, expect(TOKEN_ID, p));
     expect('(', p);
     
     Function* fun = ast_create_fun(peek_token(p, -2), &p->ast);
@@ -736,37 +993,40 @@ Node* parse_function(Parser* p)
     fun->name = id;
     fun->return_type = return_type;
     
-    Node* result = ast_create_node(p->cur_scope, fun->token, &p->ast);
-    result->type = N_FUNCTION;
-    result->fun = fun;
+    Node_Id result = ast_create_node(N_FUNCTION, fun->token, &p->ast);
+    ast_node(&p->ast, result)->fun = fun;
     
     p->cur_scope = fun->scope;
     
     
-    if(!accept(')', p))
+    if(accept(')', p).type == TOKEN_UNKOWN)
     {
         Type var_type = token_data_type(expect(TOKEN_BASIC_TYPE, p));
-        id = token_text(expect(TOKEN_ID, p));
+        Token name_tok = expect(TOKEN_ID, p);
         
-        Variable* var = ast_create_var(p->cur_scope, peek_token(p, -1), &p->ast);
+        Variable* var = ast_create_var(p->cur_scope, peek_token(p, -1), token_symbol(p, name_tok), &p->ast);
         var->type = var_type;
-        var->name = id;
-        ARR_PUSH(fun->params, var);
+        fun->param_count++;
         
-        while(accept(',', p))
+        while(accept(',', p).type != TOKEN_UNKOWN)
         {
             var_type = token_data_type(expect(TOKEN_BASIC_TYPE, p));
-            id = token_text(expect(TOKEN_ID, p));
-            var = ast_create_var(p->cur_scope, peek_token(p, -1), &p->ast);
+            name_tok = expect(TOKEN_ID, p);
+            var = ast_create_var(p->cur_scope, peek_token(p, -1), token_symbol(p, name_tok), &p->ast);
             var->type = var_type;
-            var->name = id;
-            ARR_PUSH(fun->params, var);
+            fun->param_count++;
         }
         expect(')', p);
     }
+    
+    return result;
+}
+
+Node_Id parse_function_body(Parser* p)
+{
     expect('{', p);
     
-    ast_node_add_child(result, parse_statement_seq(p), &p->ast);
+    Node_Id result = parse_statement_seq(p);
     
     expect('}', p);
     
@@ -775,19 +1035,150 @@ Node* parse_function(Parser* p)
     return result;
 }
 
-void block(Parser* p)
+Node_Id parse_function(Parser* p)
+{
+    Node_Id result = parse_function_signature(p);
+    ast_node_add_child(result, parse_function_body(p), &p->ast);
+    return result;
+}
+
+/*
+   The skeleton of a token stream are the globals and function signatures, parsed in
+   order, every function body is left as a Parse_Job. parse_parallel has workers parse
+   the bodies with their own Parser, nodes, variables and scopes, then copies the nodes
+   into the AST behind the skeleton and hangs the bodies under their N_FUNCTION in
+   source order. parse_lazy only parses the bodies of reachable functions.
+*/
+#define PARSER_MAX_THREADS 64
+#define PARSER_MIN_TOKENS_PER_THREAD (1 << 16)
+
+//Stream indices of a '{' at the top level and its matching '}'
+struct Function_Body
+{
+    u32 open;
+    u32 close;
+};
+
+struct Parse_Job
+{
+    Node_Id function;    //N_FUNCTION in the AST
+    Scope* scope;        //Scope of the function with the params already in it
+    u32 open;            //Stream index of the '{' of the body
+    u32 close;           //Stream index of the matching '}'
+    u32 globals_end;     //Offset of the '{', every global declared after the function is behind it
+    u32 worker;
+    Node_Id first_node;  //The body is [first_node, end_node) in the nodes of the worker
+    Node_Id end_node;
+    Node_Id body;        //Root of the body in the nodes of the worker
+    Node_Id stitched;    //Where first_node goes in the AST
+    b8 failed;           //Deferred error or the body did not end at close
+    b8 parsed;           //parse_lazy: the body is in the AST
+};
+
+struct Parse_Skeleton
+{
+    Token_Stream* tokens;
+    Function_Body* bodies;
+    u32 next_body;       //Next body the skeleton expects
+    b8 failed;
+    Parse_Job* jobs;     //One per function in source order
+};
+
+struct Parallel_Parse;
+
+struct Parse_Worker
+{
+    Parser parser;
+    Parallel_Parse* parallel;
+    u32 index;
+    pthread_t thread;
+};
+
+struct Parallel_Parse
+{
+    Parse_Skeleton skeleton;
+    u32 next_job;        //Workers take jobs in order through this counter
+    Node* nodes;         //Nodes of the AST while bodies are stitched into it
+    Parse_Worker workers[PARSER_MAX_THREADS];
+    u32 worker_count;
+};
+
+/*
+   Brace matching over the token stream, pushes the '{' and '}' of every brace pair at
+   the top level. Those are the function bodies, a global never contains braces.
+   Returns false if the braces do not match up.
+*/
+static
+b8 find_function_bodies(Token_Stream* tokens, Function_Body** bodies)
 {
+    msi depth = 0;
+    u32 open = 0;
+    msi count = token_stream_len(tokens);
+    for(msi i = 0; i < count; ++i)
+    {
+        Token_Type type = token_stream_type(tokens, i);
+        if(type == '{')
+        {
+            if(depth++ == 0)
+            {
+                open = (u32)i;
+            }
+        }
+        else if(type == '}')
+        {
+            if(depth == 0)
+            {
+                return false;
+            }
+            if(--depth == 0)
+            {
+                Function_Body body = {open, (u32)i};
+                ARR_PUSH(*bodies, body);
+            }
+        }
+    }
+    return depth == 0;
+}
+
+//Parses the signature and turns the body into a Parse_Job, the parser continues behind it
+Node_Id parse_function_skeleton(Parser* p, Parse_Skeleton* skeleton)
+{
+    Node_Id result = parse_function_signature(p);
+    
+    Token open = peek_token(p);
+    msi open_index = parser_stream_index(p);
+    if(open.type != '{' || skeleton->next_body >= ARR_LEN(skeleton->bodies) ||
+       skeleton->bodies[skeleton->next_body].open != open_index)
+    {
+        skeleton->failed = true;
+        return result;
+    }
+    
+    Function_Body body = skeleton->bodies[skeleton->next_body++];
+    Parse_Job job = {};
+    job.function = result;
+    job.scope = p->cur_scope;
+    job.open = body.open;
+    job.close = body.close;
+    job.globals_end = open.offset;
+    ARR_PUSH(skeleton->jobs, job);
     
-    Node* root = ast_create_node(p->cur_scope, p->tokens, &p->ast);
-    root->type= N_PROGRAM;
-    p->ast.root = root;
+    parser_ascend_scope(p);
+    parser_skip_to(p, body.close + 1);
+    return result;
+}
+
+void block(Parser* p, Parse_Skeleton* skeleton = nullptr)
+{
+    
+    p->ast.root = ast_create_node(N_PROGRAM, peek_token(p), &p->ast);
     b8 found_something = true;
     while(found_something)
     {
         found_something = false;
         if(peek_pattern(p, 3, TOKEN_BASIC_TYPE, TOKEN_ID, (Token_Type)'('))
         {
-            Node* fun = parse_function(p);
+            Node_Id fun = skeleton ? parse_function_skeleton(p, skeleton) : parse_function(p);
             if(fun)
             {
                 ast_node_add_child(p->ast.root, fun, &p->ast);
@@ -796,7 +1187,7 @@ void block(Parser* p)
         }
         else 
         {
-            Node* global_var = parse_var_decl(p);
+            Node_Id global_var = parse_var_decl(p);
             if(global_var)
             {
                 ast_node_add_child(p->ast.root, global_var, &p->ast); 
@@ -804,26 +1195,372 @@ void block(Parser* p)
             }
             
         }
-        if(peek_pattern(p, 1, TOKEN_EOF))
+        if(peek_pattern(p, 1, TOKEN_EOF) || (skeleton && (skeleton->failed || p->deferred_errors)))
         {
             break;
         }
     }
 }
 
-AST parse(Token* tokens, Heap_Allocator* heap)
+static
+AST parse(Parser* p)
 {
-    Parser p = init_parser(tokens, heap);
-    
-    block(&p);
+    block(p);
     
-    if(p.last_error_line != 0)
+    if(p->last_error_line != 0)
     {
         exit(EXIT_FAILURE);   
     }
     
+    ARR_FREE(p->expr_stack);
+    return p->ast;
+}
+
+//Parses tokens that were lexed up front (e.g. by tokenize_parallel)
+AST parse(Token_Stream* tokens, Heap_Allocator* heap)
+{
+    IR_NOT_NULL(tokens);
+    Parser p = {};
+    init_parser(&p, tokens->file, tokens->symbols, heap);
+    p.tokens = tokens;
+    return parse(&p);
+}
+
+static
+void parse_job(Parser* p, Parse_Job* job)
+{
+    p->stream_index = job->open;
+    p->pulled = 0;
+    p->pulled_eof = false;
+    p->t_index = 0;
+    p->deferred_errors = 0;
+    p->cur_scope = job->scope;
+    p->globals_end = job->globals_end;
+    
+    job->first_node = (Node_Id)ARR_LEN(p->ast.nodes);
+    job->body = parse_function_body(p);
+    job->end_node = (Node_Id)ARR_LEN(p->ast.nodes);
+    job->failed = p->deferred_errors || p->t_index != job->close - job->open + 1;
+}
+
+static
+void* parse_worker(void* data)
+{
+    Parse_Worker* worker = (Parse_Worker*)data;
+    Parallel_Parse* parallel = worker->parallel;
+    Parse_Skeleton* skeleton = &parallel->skeleton;
+    msi job_count = ARR_LEN(skeleton->jobs);
+    while(!__atomic_load_n(&skeleton->failed, __ATOMIC_RELAXED))
+    {
+        u32 j = __atomic_fetch_add(&parallel->next_job, 1, __ATOMIC_RELAXED);
+        if(j >= job_count)
+        {
+            break;
+        }
+        Parse_Job* job = &skeleton->jobs[j];
+        job->worker = worker->index;
+        parse_job(&worker->parser, job);
+        if(job->failed)
+        {
+            __atomic_store_n(&skeleton->failed, true, __ATOMIC_RELAXED);
+        }
+    }
+    return nullptr;
+}
+
+//Copies the body nodes of jobs into the AST, links are moved by the distance the nodes move
+static
+void* stitch_worker(void* data)
+{
+    Parse_Worker* worker = (Parse_Worker*)data;
+    Parallel_Parse* parallel = worker->parallel;
+    msi job_count = ARR_LEN(parallel->skeleton.jobs);
+    for(;;)
+    {
+        u32 j = __atomic_fetch_add(&parallel->next_job, 1, __ATOMIC_RELAXED);
+        if(j >= job_count)
+        {
+            break;
+        }
+        Parse_Job* job = &parallel->skeleton.jobs[j];
+        Node* from = parallel->workers[job->worker].parser.ast.nodes;
+        Node* to = &parallel->nodes[job->stitched];
+        Node_Id delta = job->stitched - job->first_node;
+        for(Node_Id i = job->first_node; i < job->end_node; ++i, ++to)
+        {
+            *to = from[i];
+            to->first_child += to->first_child ? delta : 0;
+            to->last_child += to->last_child ? delta : 0;
+            to->next_sibling += to->next_sibling ? delta : 0;
+        }
+    }
+    return nullptr;
+}
+
+//Runs work on every worker, the calling thread is worker 0
+static
+void parse_run_workers(Parallel_Parse* parallel, void* (*work)(void*))
+{
+    parallel->next_job = 0;
+    for(u32 i = 1; i < parallel->worker_count; ++i)
+    {
+        if(pthread_create(&parallel->workers[i].thread, nullptr, work, &parallel->workers[i]))
+        {
+            work(&parallel->workers[i]);
+            parallel->workers[i].thread = 0;
+        }
+    }
+    work(&parallel->workers[0]);
+    for(u32 i = 1; i < parallel->worker_count; ++i)
+    {
+        if(parallel->workers[i].thread)
+        {
+            pthread_join(parallel->workers[i].thread, nullptr);
+        }
+    }
+}
+
+static
+void free_parser(Parser* p)
+{
+    ARR_FREE(p->expr_stack);
+    ARR_FREE(p->ast.nodes);
+    free_slab_allocator(&p->ast.functions);
+    free_slab_allocator(&p->ast.variables);
+    free_slab_allocator(&p->ast.scopes);
+}
+
+static
+void free_parse_skeleton(Parse_Skeleton* skeleton)
+{
+    if(skeleton->bodies)
+    {
+        ARR_FREE(skeleton->bodies);
+    }
+    if(skeleton->jobs)
+    {
+        ARR_FREE(skeleton->jobs);
+    }
+    *skeleton = {};
+}
+
+//Parses the skeleton of tokens with p, false if it has an error or its braces do not match up
+static
+b8 parse_skeleton(Parser* p, Token_Stream* tokens, Heap_Allocator* heap, Parse_Skeleton* skeleton)
+{
+    init_parser(p, tokens->file, tokens->symbols, heap);
+    p->tokens = tokens;
+    p->defer_errors = true;
+    
+    *skeleton = {};
+    skeleton->tokens = tokens;
+    ARR_INIT(skeleton->bodies, 64, heap);
+    ARR_INIT(skeleton->jobs, 64, heap);
+    skeleton->failed = !find_function_bodies(tokens, &skeleton->bodies);
+    if(!skeleton->failed)
+    {
+        block(p, skeleton);
+        skeleton->failed |= p->deferred_errors != 0;
+    }
+    
+    p->defer_errors = false;
+    return !skeleton->failed;
+}
+
+/*
+   Same AST as parse(tokens, heap) with the function bodies parsed on up to thread_count
+   threads (the calling thread included), see Parse_Job. The heap is switched to thread
+   safe mode while the workers run. Errors are only counted on this path, after the
+   first one everything is parsed again by parse(tokens, heap) which reports them in order.
+*/
+AST parse_parallel(Token_Stream* tokens, Heap_Allocator* heap, u32 thread_count)
+{
+    IR_NOT_NULL(tokens);
+    IR_NOT_NULL(heap);
+    thread_count = u64_min(u64_min(thread_count, PARSER_MAX_THREADS), token_stream_len(tokens) / PARSER_MIN_TOKENS_PER_THREAD);
+    if(thread_count <= 1)
+    {
+        return parse(tokens, heap);
+    }
+    
+    Parallel_Parse* parallel = (Parallel_Parse*)DYN_ZALLOC(sizeof(Parallel_Parse), heap);
+    IR_NOT_NULL(parallel);
+    Parse_Skeleton* skeleton = &parallel->skeleton;
+    
+    Parser p = {};
+    parse_skeleton(&p, tokens, heap, skeleton);
+    p.defer_errors = true;
+    
+    parallel->worker_count = skeleton->failed ? 0 : u64_min(thread_count, ARR_LEN(skeleton->jobs));
+    
+    //NOTE(Michael): A body has about one node per token, workers size their nodes for an even share
+    //               so they do not grow them while holding the lock of the heap
+    msi body_tokens = 0;
+    for(msi j = 0; j < ARR_LEN(skeleton->jobs); ++j)
+    {
+        body_tokens += skeleton->jobs[j].close - skeleton->jobs[j].open + 1;
+    }
+    
+    for(u32 i = 0; i < parallel->worker_count; ++i)
+    {
+        Parse_Worker* worker = &parallel->workers[i];
+        worker->parallel = parallel;
+        worker->index = i;
+        Parser* wp = &worker->parser;
+        wp->tokens = tokens;
+        wp->defer_errors = true;
+        wp->ast.heap = heap;
+        wp->ast.file = p.ast.file;
+        wp->ast.lines = p.ast.lines;
+        wp->ast.symbols = p.ast.symbols;
+        wp->ast.global_scope = p.ast.global_scope;
+        ARR_INIT(wp->ast.nodes, body_tokens / parallel->worker_count + 1024, heap);
+        ARR_PUSH(wp->ast.nodes, (Node){}); //AST_NO_NODE
+        ARR_INIT(wp->expr_stack, 64, heap);
+        SLAB_INIT(wp->ast.variables, Variable, IR_KILOBYTES(16), heap);
+        SLAB_INIT(wp->ast.scopes, Scope, IR_KILOBYTES(16), heap);
+    }
+    
+    b8 was_thread_safe = heap->thread_safe;
+    heap->thread_safe = true;
+    if(parallel->worker_count)
+    {
+        parse_run_workers(parallel, parse_worker);
+    }
+    
+    if(!skeleton->failed && parallel->worker_count)
+    {
+        msi job_count = ARR_LEN(skeleton->jobs);
+        msi node_count = 0;
+        for(msi j = 0; j < job_count; ++j)
+        {
+            Parse_Job* job = &skeleton->jobs[j];
+            job->stitched = (Node_Id)(ARR_LEN(p.ast.nodes) + node_count);
+            node_count += job->end_node - job->first_node;
+        }
+        ARR_ADD_N_PTR(p.ast.nodes, node_count);
+        parallel->nodes = p.ast.nodes;
+        parse_run_workers(parallel, stitch_worker);
+        
+        for(msi j = 0; j < job_count; ++j)
+        {
+            Parse_Job* job = &skeleton->jobs[j];
+            if(job->body)
+            {
+                ast_node_add_child(job->function, job->body - job->first_node + job->stitched, &p.ast);
+            }
+        }
+    }
+    heap->thread_safe = was_thread_safe;
+    
+    for(u32 i = 0; i < parallel->worker_count; ++i)
+    {
+        Parser* wp = &parallel->workers[i].parser;
+        if(!skeleton->failed)
+        {
+            slab_adopt(&p.ast.variables, &wp->ast.variables);
+            slab_adopt(&p.ast.scopes, &wp->ast.scopes);
+        }
+        free_parser(wp);
+    }
+    
+    b8 failed = skeleton->failed;
+    free_parse_skeleton(skeleton);
+    DYN_FREE(parallel, heap);
+    
+    if(failed)
+    {
+        //NOTE(Michael): Tables of big scopes stay in the heap until it goes away
+        free_parser(&p);
+        return parse(tokens, heap);
+    }
+    
+    ARR_FREE(p.expr_stack);
     return p.ast;
 }
 
+//Parses the body of every function called name that is still left in skeleton, false if there is none
+b8 parse_function_on_demand(AST* ast, Parse_Skeleton* skeleton, Symbol_Id name)
+{
+    b8 result = false;
+    msi job_count = skeleton->jobs ? ARR_LEN(skeleton->jobs) : 0;
+    for(msi j = 0; j < job_count; ++j)
+    {
+        Parse_Job* job = &skeleton->jobs[j];
+        if(ast_node(ast, job->function)->fun->name != name)
+        {
+            continue;
+        }
+        result = true;
+        if(job->parsed)
+        {
+            continue;
+        }
+        
+        Parser p = {};
+        p.tokens = skeleton->tokens;
+        p.ast = *ast;
+        ARR_INIT(p.expr_stack, 64, ast->heap);
+        parse_job(&p, job);
+        job->parsed = true;
+        ast_node_add_child(job->function, job->body, &p.ast);
+        ARR_FREE(p.expr_stack);
+        *ast = p.ast;
+        
+        if(p.last_error_line != 0)
+        {
+            exit(EXIT_FAILURE);
+        }
+    }
+    return result;
+}
+
+/*
+   Parses the skeleton of tokens and only the bodies of the functions named in roots
+   (main and the exported ones), every other body costs the brace matching and a skip.
+   The grammar has no calls, no body can reach another function, so the roots are all
+   that is reachable. skeleton keeps the other bodies for parse_function_on_demand.
+   A file with an error is parsed completely by parse(tokens, heap), which reports it.
+*/
+AST parse_lazy(Token_Stream* tokens, Heap_Allocator* heap, String* roots, u32 root_count, Parse_Skeleton* skeleton)
+{
+    IR_NOT_NULL(tokens);
+    IR_NOT_NULL(heap);
+    IR_NOT_NULL(skeleton);
+    
+    Parser p = {};
+    if(!parse_skeleton(&p, tokens, heap, skeleton))
+    {
+        //NOTE(Michael): Tables of big scopes stay in the heap until it goes away
+        free_parser(&p);
+        free_parse_skeleton(skeleton);
+        return parse(tokens, heap);
+    }
+    
+    ARR_FREE(p.expr_stack);
+    AST result = p.ast;
+    for(u32 i = 0; i < root_count; ++i)
+    {
+        Symbol_Id name = interner_find(result.symbols, roots[i], hash_short_string(roots[i]));
+        if(name)
+        {
+            parse_function_on_demand(&result, skeleton, name);
+        }
+    }
+    return result;
+}
+
+//Lexes file on demand while parsing, only the parser's token ring is kept in memory
+AST parse(String file, Interner* symbols, Heap_Allocator* heap)
+{
+    Tokenizer lexer = create_tokenizer(file, symbols, heap);
+    Parser p = {};
+    init_parser(&p, file, symbols, heap);
+    p.lexer = &lexer;
+    AST result = parse(&p);
+    token_stream_free(&lexer.tokens);
+    return result;
+}
+
 
 #endif //PARSER_H
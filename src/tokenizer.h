@@ -1,545 +1,1829 @@
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
+#include <pthread.h>
+
+#include "ir_number.h"
+#include "ir_utf8.h"
+
+//Chunks of tokenize_parallel are never smaller than this
+#define TOKENIZER_MIN_CHUNK_SIZE IR_MEGABYTES(1)
+#define TOKENIZER_MAX_THREADS 64
+#define TOKENIZER_LITERAL_BLOCK_SIZE IR_KILOBYTES(64)
+
+/*
+   Every file handed to the tokenizer is followed by TOKENIZER_PADDING zero bytes
+   (map_file(path, TOKENIZER_PADDING, ...) or push_padded_source). Lookahead past the
+   current char reads those zeros instead of checking against the end, a zero byte
+   never continues a token, comment opener or escape.
+*/
+#define TOKENIZER_PADDING 64
+
 struct Tokenizer
 {
     String file;
-    String line_text;
-    Token* tokens;
-    String* str_literals;
-    c8  n[3];
+    Token_Stream tokens;
     msi cur;
-    msi cur_line;
-    msi cur_column;
+    msi range_end;
+    Heap_Allocator* heap;
+};
+
+struct Keyword
+{
+    const c8* text;
+    msi length;
+    Token_Type type;
+    Type data_type;
+};
+
+static constexpr Keyword keywords[] = 
+{
+    {"fn",       2, TOKEN_FN,         TYPE_UNKNOWN},
+    {"return",   6, TOKEN_RETURN,     TYPE_UNKNOWN},
+    {"if",       2, TOKEN_IF,         TYPE_UNKNOWN},
+    {"else",     4, TOKEN_ELSE,       TYPE_UNKNOWN},
+    {"for",      3, TOKEN_FOR,        TYPE_UNKNOWN},
+    {"while",    5, TOKEN_WHILE,      TYPE_UNKNOWN},
+    {"break",    5, TOKEN_BREAK,      TYPE_UNKNOWN},
+    {"continue", 8, TOKEN_CONT,       TYPE_UNKNOWN},
+    {"struct",   6, TOKEN_STRUCT,     TYPE_UNKNOWN},
+    {"cast",     4, TOKEN_CAST,       TYPE_UNKNOWN},
+    {"s8",       2, TOKEN_BASIC_TYPE, TYPE_S8},
+    {"s16",      3, TOKEN_BASIC_TYPE, TYPE_S16},
+    {"s32",      3, TOKEN_BASIC_TYPE, TYPE_S32},
+    {"s64",      3, TOKEN_BASIC_TYPE, TYPE_S64},
+    {"u8",       2, TOKEN_BASIC_TYPE, TYPE_U8},
+    {"u16",      3, TOKEN_BASIC_TYPE, TYPE_U16},
+    {"u32",      3, TOKEN_BASIC_TYPE, TYPE_U32},
+    {"u64",      3, TOKEN_BASIC_TYPE, TYPE_U64},
+    {"msi",      3, TOKEN_BASIC_TYPE, TYPE_MSI},
+    {"f32",      3, TOKEN_BASIC_TYPE, TYPE_F32},
+    {"f64",      3, TOKEN_BASIC_TYPE, TYPE_F64},
+    {"b8",       2, TOKEN_BASIC_TYPE, TYPE_B8},
+    {"void",     4, TOKEN_BASIC_TYPE, TYPE_VOID},
+};
+
+#define KEYWORD_COUNT (sizeof(keywords)/sizeof(keywords[0]))
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 8
+#define KEYWORD_TABLE_SIZE 128
+
+/*
+   Perfect hash over (first char, last char, length). The multiplier was picked so
+   that all keywords land in distinct slots, keyword_table_is_perfect() checks that
+   at compile time so adding a keyword that collides fails the build.
+*/
+constexpr
+u32 keyword_hash(c8 first, c8 last, msi length)
+{
+    return ((u32)(first & 0xFF) + (u32)(last & 0xFF) * 39 + (u32)length) & (KEYWORD_TABLE_SIZE - 1);
+}
+
+struct Keyword_Table
+{
+    s8 slots[KEYWORD_TABLE_SIZE]; //index into keywords or -1
+};
+
+constexpr
+Keyword_Table build_keyword_table()
+{
+    Keyword_Table result = {};
+    for(msi i = 0; i < KEYWORD_TABLE_SIZE; ++i)
+    {
+        result.slots[i] = -1;
+    }
+    for(msi i = 0; i < KEYWORD_COUNT; ++i)
+    {
+        const Keyword& k = keywords[i];
+        result.slots[keyword_hash(k.text[0], k.text[k.length-1], k.length)] = (s8)i;
+    }
+    return result;
+}
+
+constexpr
+b8 keyword_table_is_perfect()
+{
+    Keyword_Table table = build_keyword_table();
+    for(msi i = 0; i < KEYWORD_COUNT; ++i)
+    {
+        const Keyword& k = keywords[i];
+        if(table.slots[keyword_hash(k.text[0], k.text[k.length-1], k.length)] != (s8)i ||
+           k.length < KEYWORD_MIN_LENGTH || k.length > KEYWORD_MAX_LENGTH)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(keyword_table_is_perfect(), "Keyword hash has collisions, pick another multiplier in keyword_hash!");
+
+static constexpr Keyword_Table keyword_table = build_keyword_table();
+
+inline
+const Keyword* lookup_keyword(u8* text, msi length)
+{
+    if(length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH)
+    {
+        return nullptr;
+    }
+    
+    s8 index = keyword_table.slots[keyword_hash(text[0], text[length-1], length)];
+    if(index < 0)
+    {
+        return nullptr;
+    }
+    
+    const Keyword* k = &keywords[index];
+    if(k->length != length || !cmp_string(IR_WRAP_INTO_BUFFER(k->text, length), IR_WRAP_INTO_BUFFER(text, length)))
+    {
+        return nullptr;
+    }
+    return k;
+}
+
+struct Operator
+{
+    const c8* text;
+    msi length;
+    Token_Type type;
+};
+
+/*
+   Adding an operator only needs a new entry here, build_operator_dfa() turns the
+   list into a trie shaped DFA at compile time and lex_operator() takes the longest match.
+*/
+static constexpr Operator operators[] =
+{
+    {"(",   1, (Token_Type)'('},
+    {")",   1, (Token_Type)')'},
+    {"[",   1, (Token_Type)'['},
+    {"]",   1, (Token_Type)']'},
+    {"{",   1, (Token_Type)'{'},
+    {"}",   1, (Token_Type)'}'},
+    {"<",   1, (Token_Type)'<'},
+    {">",   1, (Token_Type)'>'},
+    {"%",   1, (Token_Type)'%'},
+    {"+",   1, (Token_Type)'+'},
+    {"-",   1, (Token_Type)'-'},
+    {"*",   1, (Token_Type)'*'},
+    {"/",   1, (Token_Type)'/'},
+    {"!",   1, (Token_Type)'!'},
+    {"=",   1, (Token_Type)'='},
+    {":",   1, (Token_Type)':'},
+    {";",   1, (Token_Type)';'},
+    {",",   1, (Token_Type)','},
+    {".",   1, (Token_Type)'.'},
+    {"#",   1, (Token_Type)'#'},
+    {"&",   1, (Token_Type)'&'},
+    {"|",   1, (Token_Type)'|'},
+    {"^",   1, (Token_Type)'^'},
+    {"$",   1, (Token_Type)'$'},
+    {"?",   1, (Token_Type)'?'},
+    {"~",   1, (Token_Type)'~'},
+    
+    {"==",  2, TOKEN_D_EQ},
+    {"&&",  2, TOKEN_AND},
+    {"||",  2, TOKEN_OR},
+    {"!=",  2, TOKEN_NOTEQ},
+    {"<=",  2, TOKEN_LEQ},
+    {">=",  2, TOKEN_GEQ},
+    {"++",  2, TOKEN_D_PLUS},
+    {"--",  2, TOKEN_D_MINUS},
+    {"+=",  2, TOKEN_PLUS_EQ},
+    {"-=",  2, TOKEN_MINUS_EQ},
+    {"*=",  2, TOKEN_MUL_EQ},
+    {"/=",  2, TOKEN_DIV_EQ},
+    {"%=",  2, TOKEN_MOD_EQ},
+    {"<<=", 3, TOKEN_SHIFT_L_EQ},
+    {">>=", 3, TOKEN_SHIFT_R_EQ},
+    {"&=",  2, TOKEN_AND_EQ},
+    {"^=",  2, TOKEN_XOR_EQ},
+    {"|=",  2, TOKEN_OR_EQ},
+    {"<<",  2, TOKEN_SHIFT_L},
+    {">>",  2, TOKEN_SHIFT_R},
 };
 
+#define OPERATOR_COUNT (sizeof(operators)/sizeof(operators[0]))
+#define OPERATOR_MAX_STATES 64
+#define OPERATOR_MAX_CLASSES 32
+
+struct Operator_Dfa
+{
+    u8 first[256];                                              //state after the first byte, 0 = no operator starts with it
+    u8 char_class[256];                                         //0 = byte does not appear in any operator
+    u8 transitions[OPERATOR_MAX_STATES][OPERATOR_MAX_CLASSES];  //0 = no transition, state 0 is the start
+    Token_Type accept[OPERATOR_MAX_STATES];                     //TOKEN_UNKOWN if the state is only a prefix
+    msi state_count;
+    msi class_count;
+    b8 valid;
+};
+
+constexpr
+Operator_Dfa build_operator_dfa()
+{
+    Operator_Dfa dfa = {};
+    dfa.state_count = 1;
+    dfa.class_count = 1;
+    dfa.valid = true;
+    
+    for(msi i = 0; i < OPERATOR_COUNT && dfa.valid; ++i)
+    {
+        const Operator& op = operators[i];
+        msi state = 0;
+        for(msi j = 0; j < op.length; ++j)
+        {
+            u32 c = op.text[j] & 0xFF;
+            if(!dfa.char_class[c])
+            {
+                if(dfa.class_count == OPERATOR_MAX_CLASSES)
+                {
+                    dfa.valid = false;
+                    break;
+                }
+                dfa.char_class[c] = (u8)dfa.class_count++;
+            }
+            
+            u8 cls = dfa.char_class[c];
+            if(!dfa.transitions[state][cls])
+            {
+                if(dfa.state_count == OPERATOR_MAX_STATES)
+                {
+                    dfa.valid = false;
+                    break;
+                }
+                dfa.transitions[state][cls] = (u8)dfa.state_count++;
+            }
+            state = dfa.transitions[state][cls];
+        }
+        
+        //NOTE(Michael): Same operator listed twice
+        if(dfa.accept[state] != TOKEN_UNKOWN)
+        {
+            dfa.valid = false;
+        }
+        dfa.accept[state] = op.type;
+    }
+    
+    for(msi c = 0; c < 256; ++c)
+    {
+        dfa.first[c] = dfa.char_class[c] ? dfa.transitions[0][dfa.char_class[c]] : 0;
+    }
+    
+    return dfa;
+}
+
+static constexpr Operator_Dfa operator_dfa = build_operator_dfa();
+
+static_assert(operator_dfa.valid, "Operator table is too big for the DFA or contains duplicates!");
+
+//Returns the length of the longest operator starting at cur (0 if there is none)
+inline
+msi lex_operator(u8* data, msi cur, Token_Type* type)
+{
+    msi state = operator_dfa.first[data[cur] & 0xFF];
+    msi length = 1;
+    msi accepted_length = 0;
+    
+    while(state)
+    {
+        if(operator_dfa.accept[state] != TOKEN_UNKOWN)
+        {
+            *type = operator_dfa.accept[state];
+            accepted_length = length;
+        }
+        
+        u8 cls = operator_dfa.char_class[data[cur + length] & 0xFF];
+        state = cls ? operator_dfa.transitions[state][cls] : 0;
+        ++length;
+    }
+    
+    return accepted_length;
+}
+
+//Copies text into arena followed by the TOKENIZER_PADDING zero bytes the tokenizer expects
 static
-Tokenizer create_tokenizer(String file, Heap_Allocator* heap)
+String push_padded_source(String text, Memory_Arena* arena)
 {
+    String result = {};
+    result.data = (u8*)push_size(text.length + TOKENIZER_PADDING, arena);
+    IR_NOT_NULL(result.data);
+    result.length = text.length;
+    copy_buffer(text, result);
+    zero_buffer(IR_WRAP_INTO_BUFFER(&result.data[text.length], TOKENIZER_PADDING));
+    return result;
+}
+
+static
+Tokenizer create_tokenizer(String file, Interner* symbols, Heap_Allocator* heap)
+{
+    IR_ASSERT(file.length < 0xFFFFFFFF && "Token offsets are 32 bit!");
+    IR_ASSERT(file.data && file.data[file.length] == 0 && file.data[file.length+1] == 0 &&
+              "The file needs TOKENIZER_PADDING zero bytes behind it!");
     Tokenizer t = {};
     t.file = file;
-    t.line_text = substring(file, 0, search_string_first_occurrence(file, '\n').data - file.data +1);
-    t.str_literals = nullptr;
-    ARR_INIT(t.str_literals, 16, heap);
-    ARR_INIT(t.tokens, 64, heap);
+    t.range_end = file.length;
+    t.heap = heap;
+    t.tokens.file = file;
+    t.tokens.symbols = symbols;
+    ARR_INIT(t.tokens.str_literals, 16, heap);
     
-    t.cur_line = 1;
-    t.cur_column = 1;
+    return t;
     
-    if(file.length >= 1)
+}
+
+//Only needed when the tokens are collected into tokens, lex_token alone does not use them
+static
+void tokenizer_init_token_arrays(Tokenizer* t)
+{
+    ARR_INIT(t->tokens.numbers, 64, t->heap);
+    ARR_INIT(t->tokens.kinds, 64, t->heap);
+    ARR_INIT(t->tokens.offsets, 64, t->heap);
+    ARR_INIT(t->tokens.lengths, 64, t->heap);
+    ARR_INIT(t->tokens.payloads, 64, t->heap);
+}
+
+//Returns the index right after the first "*/" in [begin, end) or end if the comment is not closed
+static
+msi scan_past_block_comment(u8* data, msi begin, msi end)
+{
+    msi i = begin;
+#if defined(__AVX2__)
+    for(; i + 32 + 1 <= end; i += 32)
     {
-        t.n[0]=t.file.data[0];
+        u32 closing = ir_pair_mask_32(&data[i], '*', '/');
+        if(closing)
+        {
+            return i + intr_bsf(closing) + 2;
+        }
     }
-    if(file.length >= 2)
+#endif
+#if defined(__SSE2__)
+    for(; i + 16 + 1 <= end; i += 16)
     {
-        t.n[1]=t.file.data[1];
+        u32 closing = ir_pair_mask_16(&data[i], '*', '/');
+        if(closing)
+        {
+            return i + intr_bsf(closing) + 2;
+        }
     }
+#endif
+    for(; i + 1 < end; ++i)
+    {
+        if(data[i] == '*' && data[i+1] == '/')
+        {
+            return i + 2;
+        }
+    }
+    return end;
+}
+
+//Appends the position of every end of line char in [begin, end) to eols
+static
+void collect_end_of_lines(u8* data, msi begin, msi end, u32** eols)
+{
+    msi i = begin;
+#if defined(__AVX2__)
+    for(; i + 32 <= end; i += 32)
+    {
+        for(u32 eol = ir_end_of_line_mask_32(&data[i]); eol; eol &= eol - 1)
+        {
+            ARR_PUSH(*eols, (u32)(i + intr_bsf(eol)));
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    for(; i + 16 <= end; i += 16)
+    {
+        for(u32 eol = ir_end_of_line_mask_16(&data[i]); eol; eol &= eol - 1)
+        {
+            ARR_PUSH(*eols, (u32)(i + intr_bsf(eol)));
+        }
+    }
+#endif
+    for(; i < end; ++i)
+    {
+        if(is_end_of_line(data[i]))
+        {
+            ARR_PUSH(*eols, (u32)i);
+        }
+    }
+}
+
+/*
+   Positions of all end of line chars ('\n' and '\r' each start a new line).
+   Diagnostics are rare so the index is built the first time a location is asked for.
+*/
+struct Line_Index
+{
+    String file;
+    Heap_Allocator* heap;
+    u32* eols;
+};
+
+static
+Line_Index create_line_index(String file, Heap_Allocator* heap)
+{
+    Line_Index result = {};
+    result.file = file;
+    result.heap = heap;
+    return result;
+}
+
+static
+void line_index_build(Line_Index* index)
+{
+    if(!index->eols)
+    {
+        ARR_INIT(index->eols, index->file.length / 32 + 16, index->heap);
+        collect_end_of_lines(index->file.data, 0, index->file.length, &index->eols);
+    }
+}
+
+struct Token_Location
+{
+    msi line;
+    msi column;
+    String line_text;       //Line of the token without its heading whitespace, including the end of line char
+    msi heading_whitespace; //Bytes between the start of the line and line_text
+};
+
+static
+Token_Location token_location(Line_Index* index, Token t)
+{
+    line_index_build(index);
+    String file = index->file;
+    Token_Location result = {};
+    msi offset = u64_min(t.offset, file.length);
     
-    return t;
+    //Number of end of lines before offset
+    msi low = 0;
+    msi high = ARR_LEN(index->eols);
+    while(low < high)
+    {
+        msi mid = low + (high - low) / 2;
+        if(index->eols[mid] < offset)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    msi eol_count = low;
+    msi line_begin = eol_count ? index->eols[eol_count-1] + 1 : 0;
     
+    msi text_begin = u64_min(scan_past_blanks(file.data, line_begin, file.length), offset);
+    msi text_end = eol_count < ARR_LEN(index->eols) ? u64_max(index->eols[eol_count], text_begin) : file.length;
+    
+    result.line = eol_count + 1;
+    result.column = offset - line_begin + 1;
+    result.line_text.data = &file.data[text_begin];
+    result.line_text.length = text_end - text_begin + (text_end < file.length ? 1 : 0);
+    result.heading_whitespace = text_begin - line_begin;
+    
+    return result;
 }
 
 static 
-void adv_chars(Tokenizer* t, msi count)
+void skip_whitespace_and_comments(Tokenizer* t)
 {
-    for(msi i = 0; i < count; ++i)
+    u8* data = t->file.data;
+    msi end = t->file.length;
+    msi cur = t->cur;
+    for(;;)
     {
-        if(t->cur >= t->file.length)
+        cur = scan_past_blanks(data, cur, end);
+        
+        if(data[cur] == '/')
         {
-            t->n[0] = 0;
-            t->n[1] = 0;
-            t->n[2] = 0;
-            break;
+            //Skip CPP style comment
+            if(data[cur+1] == '/')
+            {
+                cur = scan_to_end_of_line(data, cur+2, end);
+                continue;
+            }
+            //Skip C style comment
+            if(data[cur+1] == '*')
+            {
+                cur = scan_past_block_comment(data, cur+2, end);
+                continue;
+            }
         }
         
-        ++t->cur_column;
-        if(is_end_of_line(t->file.data[t->cur]))
+        break;
+    }
+    
+    t->cur = cur;
+}
+
+static
+void tokenizer_grow_literal_slots(Tokenizer* t)
+{
+    msi new_count = t->tokens.literal_slot_count ? t->tokens.literal_slot_count * 2 : 64;
+    u32* new_slots = (u32*)DYN_ZALLOC(new_count * sizeof(u32), t->heap);
+    IR_NOT_NULL(new_slots);
+    
+    for(msi i = 0; i < ARR_LEN(t->tokens.str_literals); ++i)
+    {
+        msi slot = hash_string(t->tokens.str_literals[i]) & (new_count - 1);
+        while(new_slots[slot])
+        {
+            slot = (slot + 1) & (new_count - 1);
+        }
+        new_slots[slot] = i + 1;
+    }
+    
+    DYN_FREE(t->tokens.literal_slots, t->heap);
+    t->tokens.literal_slots = new_slots;
+    t->tokens.literal_slot_count = new_count;
+}
+
+//Returns the index of literal in str_literals, *is_new tells if it was added by this call
+static
+u32 tokenizer_intern_literal(Tokenizer* t, String literal, b8* is_new)
+{
+    if((ARR_LEN(t->tokens.str_literals) + 1) * 2 > t->tokens.literal_slot_count)
+    {
+        tokenizer_grow_literal_slots(t);
+    }
+    
+    msi mask = t->tokens.literal_slot_count - 1;
+    msi slot = hash_string(literal) & mask;
+    while(t->tokens.literal_slots[slot])
+    {
+        u32 index = t->tokens.literal_slots[slot] - 1;
+        if(cmp_string(t->tokens.str_literals[index], literal))
+        {
+            *is_new = false;
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+    
+    u32 index = ARR_LEN(t->tokens.str_literals);
+    ARR_PUSH(t->tokens.str_literals, literal);
+    t->tokens.literal_slots[slot] = index + 1;
+    *is_new = true;
+    return index;
+}
+
+//Starts a new block for unescaped literals with room for at least size bytes
+static
+void tokenizer_push_literal_block(Tokenizer* t, msi size)
+{
+    Memory_Arena* arena = &t->tokens.literal_arena;
+    if(!t->tokens.literal_blocks)
+    {
+        ARR_INIT(t->tokens.literal_blocks, 4, t->heap);
+    }
+    
+    size = u64_max(size, TOKENIZER_LITERAL_BLOCK_SIZE);
+    arena->buffer.data = (u8*)DYN_ALLOC(size, t->heap);
+    IR_NOT_NULL(arena->buffer.data);
+    arena->buffer.length = size;
+    arena->current_base = arena->buffer.data;
+    ARR_PUSH(t->tokens.literal_blocks, arena->buffer);
+}
+
+//cur is the char after the opening quote, returns the index of the literal in str_literals
+static
+u32 lex_string_literal(Tokenizer* t, msi cur, msi* literal_end)
+{
+    u8* data = t->file.data;
+    msi end = t->file.length;
+    msi begin = cur;
+    msi escapes = 0;
+    
+    while(cur < end && data[cur] != '"')
+    {
+        if(data[cur] == '\\' && (data[cur+1] == '"' || data[cur+1] == 'n'))
+        {
+            ++escapes;
+            cur += 2;
+        }
+        else
+        {
+            ++cur;
+        }
+    }
+    *literal_end = cur;
+    
+    b8 is_new = false;
+    if(!escapes)
+    {
+        return tokenizer_intern_literal(t, substring(t->file, begin, cur - begin), &is_new);
+    }
+    
+    Memory_Arena* arena = &t->tokens.literal_arena;
+    msi length = cur - begin - escapes;
+    if((msi)(arena->buffer.data + arena->buffer.length - arena->current_base) < length)
+    {
+        tokenizer_push_literal_block(t, length);
+    }
+    
+    Buffer unescaped = create_buffer(length, arena);
+    IR_NOT_NULL(unescaped.data);
+    msi write = 0;
+    for(msi read = begin; read < cur; ++read)
+    {
+        if(data[read] == '\\' && (data[read+1] == '"' || data[read+1] == 'n'))
         {
-            ++t->cur_line;
-            t->cur_column = 1;
+            ++read;
+            unescaped.data[write++] = data[read] == 'n' ? '\n' : '"';
+        }
+        else
+        {
+            unescaped.data[write++] = data[read];
+        }
+    }
+    
+    String literal = {};
+    literal.data = unescaped.data;
+    literal.length = unescaped.length;
+    u32 index = tokenizer_intern_literal(t, literal, &is_new);
+    if(!is_new)
+    {
+        free_buffer_if_last(&unescaped, arena);
+    }
+    return index;
+}
+
+static
+u32 digit_value(c8 c)
+{
+    if(!(ir_char_class(c) & IR_CC_HEX)) return 0xFF;
+    if(c <= '9') return c - '0';
+    return (c | 0x20) - 'a' + 10;
+}
+
+//'_' may separate two digits of the given base
+inline
+b8 is_digit_separator(u8* data, msi cur, u32 base)
+{
+    return data[cur] == '_' && cur > 0 && digit_value(data[cur-1]) < base &&
+        digit_value(data[cur+1]) < base;
+}
+
+/*
+   Slow path for decimal floats the Eisel-Lemire conversion cannot decide
+   (more than 19 significant digits), strtod on a copy without separators.
+*/
+static
+f64 parse_f64_slow(u8* data, msi begin, msi end, f64 approximation)
+{
+    c8 buffer[512];
+    msi length = 0;
+    for(msi i = begin; i < end; ++i)
+    {
+        if(data[i] == '_')
+            continue;
+        if(length + 1 >= sizeof(buffer))
+            return approximation;
+        buffer[length++] = data[i];
+    }
+    buffer[length] = '\0';
+    return strtod(buffer, nullptr);
+}
+
+/*
+   Decodes the number starting at cur: decimal integers and floats (with optional
+   exponent), 0x hex and 0b binary integers, '_' digit separators and an optional
+   numeric type suffix (3u8, 1.5f32, 0xFF_u16). Returns the end of the literal.
+*/
+static
+msi lex_number(u8* data, msi cur, msi end, Number_Literal* literal)
+{
+    *literal = {};
+    literal->type = TYPE_S64;
+    
+    msi begin = cur;
+    u64 int_value = 0;
+    b8 overflow = false;
+    b8 is_float = false;
+    f64 float_value = 0;
+    
+    if(data[cur] == '0' &&
+       (data[cur+1] == 'x' || data[cur+1] == 'X' || data[cur+1] == 'b' || data[cur+1] == 'B'))
+    {
+        u32 shift = (data[cur+1] == 'x' || data[cur+1] == 'X') ? 4 : 1;
+        u32 base = 1 << shift;
+        msi digits = 0;
+        for(cur += 2; cur < end; ++cur)
+        {
+            if(is_digit_separator(data, cur, base))
+                continue;
+            u32 d = digit_value(data[cur]);
+            if(d >= base)
+                break;
+            if(int_value >> (64 - shift))
+                overflow = true;
+            int_value = (int_value << shift) | d;
+            ++digits;
+        }
+        
+        if(!digits)
+        {
+            literal->error = NUMBER_ERROR_NO_DIGITS;
+        }
+    }
+    else
+    {
+        //At most 19 significant digits fit into the mantissa, the rest only moves exp10
+        u64 mantissa = 0;
+        msi significant = 0;
+        s64 exp10 = 0;
+        b8 truncated = false;
+        b8 in_fraction = false;
+        
+        //Runs of digits are found in one step, only the bytes between them are looked at one by one
+        for(; cur < end; ++cur)
+        {
+            msi run_end = scan_past_digits(data, cur, end);
+            for(; cur < run_end; ++cur)
+            {
+                u32 d = data[cur] - '0';
+                if(!in_fraction)
+                {
+                    if(int_value > (0xFFFFFFFFFFFFFFFFULL - d) / 10)
+                        overflow = true;
+                    int_value = int_value * 10 + d;
+                }
+                
+                if(significant < 19)
+                {
+                    mantissa = mantissa * 10 + d;
+                    if(mantissa)
+                        ++significant;
+                    if(in_fraction)
+                        --exp10;
+                }
+                else
+                {
+                    truncated |= d != 0;
+                    if(!in_fraction)
+                        ++exp10;
+                }
+            }
+            
+            if(data[cur] == '.' && !in_fraction)
+            {
+                in_fraction = true;
+                is_float = true;
+                continue;
+            }
+            if(!is_digit_separator(data, cur, 10))
+                break;
+        }
+        
+        //Exponent, only taken if digits follow so 3else stays 3 else
+        if(data[cur] == 'e' || data[cur] == 'E')
+        {
+            msi e = cur + 1;
+            b8 negative = false;
+            if(data[e] == '+' || data[e] == '-')
+            {
+                negative = data[e] == '-';
+                ++e;
+            }
+            if(is_number(data[e]))
+            {
+                s64 exponent = 0;
+                for(; e < end && (is_number(data[e]) || is_digit_separator(data, e, 10)); ++e)
+                {
+                    if(data[e] != '_' && exponent < 100000)
+                        exponent = exponent * 10 + (data[e] - '0');
+                }
+                exp10 += negative ? -exponent : exponent;
+                is_float = true;
+                cur = e;
+            }
+        }
+        
+        if(is_float)
+        {
+            f64 upper = 0;
+            if(!f64_from_decimal(mantissa, exp10, &float_value) ||
+               (truncated && (!f64_from_decimal(mantissa + 1, exp10, &upper) || upper != float_value)))
+            {
+                float_value = parse_f64_slow(data, begin, cur, float_value);
+            }
+            literal->type = TYPE_F64;
+        }
+    }
+    
+    //Type suffix, a single '_' may separate it from the digits
+    msi suffix = data[cur] == '_' ? cur + 1 : cur;
+    if(is_alpha(data[suffix]))
+    {
+        msi suffix_end = scan_past_ident_cont(data, suffix, end);
+        
+        const Keyword* keyword = lookup_keyword(&data[suffix], suffix_end - suffix);
+        if(keyword && keyword->type == TOKEN_BASIC_TYPE && data_type_is_number(keyword->data_type))
+        {
+            literal->type = keyword->data_type;
+            literal->has_suffix = true;
+            cur = suffix_end;
+        }
+    }
+    
+    if(literal->error)
+    {
+        return cur;
+    }
+    
+    if(data_type_is_floating_point(literal->type))
+    {
+        if(!is_float)
+        {
+            float_value = (f64)int_value;
+        }
+        literal->f_value = literal->type == TYPE_F32 ? (f64)(f32)float_value : float_value;
+    }
+    else if(is_float)
+    {
+        literal->error = NUMBER_ERROR_INTEGER_SUFFIX_ON_FLOAT;
+    }
+    else
+    {
+        u8 bits = data_type_size(literal->type);
+        u64 max = data_type_is_signed(literal->type) ? (1ULL << (bits - 1)) - 1 :
+            (bits == 64 ? 0xFFFFFFFFFFFFFFFFULL : (1ULL << bits) - 1);
+        if(overflow || int_value > max)
+        {
+            literal->error = NUMBER_ERROR_OVERFLOW;
+        }
+        literal->s_value = (s64)int_value;
+    }
+    
+    return cur;
+}
+
+/*
+   Characters allowed in identifiers beyond ASCII, C11 Annex D. D.1 lists what may
+   appear anywhere in an identifier, D.2 what may not start one (combining marks).
+   Both tables are sorted so lookups are a binary search, they only run for bytes >= 0x80.
+*/
+struct Unicode_Range
+{
+    u32 first;
+    u32 last;
+};
+
+static const Unicode_Range unicode_ident_ranges[] =
+{
+    {0x00A8, 0x00A8}, {0x00AA, 0x00AA}, {0x00AD, 0x00AD}, {0x00AF, 0x00AF},
+    {0x00B2, 0x00B5}, {0x00B7, 0x00BA}, {0x00BC, 0x00BE}, {0x00C0, 0x00D6},
+    {0x00D8, 0x00F6}, {0x00F8, 0x00FF}, {0x0100, 0x167F}, {0x1681, 0x180D},
+    {0x180F, 0x1FFF}, {0x200B, 0x200D}, {0x202A, 0x202E}, {0x203F, 0x2040},
+    {0x2054, 0x2054}, {0x2060, 0x206F}, {0x2070, 0x218F}, {0x2460, 0x24FF},
+    {0x2776, 0x2793}, {0x2C00, 0x2DFF}, {0x2E80, 0x2FFF}, {0x3004, 0x3007},
+    {0x3021, 0x302F}, {0x3031, 0x303F}, {0x3040, 0xD7FF}, {0xF900, 0xFD3D},
+    {0xFD40, 0xFDCF}, {0xFDF0, 0xFE44}, {0xFE47, 0xFFFD},
+    {0x10000, 0x1FFFD}, {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD}, {0x40000, 0x4FFFD},
+    {0x50000, 0x5FFFD}, {0x60000, 0x6FFFD}, {0x70000, 0x7FFFD}, {0x80000, 0x8FFFD},
+    {0x90000, 0x9FFFD}, {0xA0000, 0xAFFFD}, {0xB0000, 0xBFFFD}, {0xC0000, 0xCFFFD},
+    {0xD0000, 0xDFFFD}, {0xE0000, 0xEFFFD},
+};
+#define UNICODE_IDENT_RANGE_COUNT (sizeof(unicode_ident_ranges)/sizeof(unicode_ident_ranges[0]))
+
+static const Unicode_Range unicode_ident_not_start_ranges[] =
+{
+    {0x0300, 0x036F}, {0x1DC0, 0x1DFF}, {0x20D0, 0x20FF}, {0xFE20, 0xFE2F},
+};
+#define UNICODE_IDENT_NOT_START_RANGE_COUNT (sizeof(unicode_ident_not_start_ranges)/sizeof(unicode_ident_not_start_ranges[0]))
+
+static
+b8 unicode_in_ranges(const Unicode_Range* ranges, msi count, u32 codepoint)
+{
+    msi low = 0;
+    msi high = count;
+    while(low < high)
+    {
+        msi mid = low + (high - low) / 2;
+        if(ranges[mid].last < codepoint)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low < count && ranges[low].first <= codepoint;
+}
+
+inline
+b8 unicode_is_ident_cont(u32 codepoint)
+{
+    return unicode_in_ranges(unicode_ident_ranges, UNICODE_IDENT_RANGE_COUNT, codepoint);
+}
+
+inline
+b8 unicode_is_ident_start(u32 codepoint)
+{
+    return unicode_is_ident_cont(codepoint) &&
+        !unicode_in_ranges(unicode_ident_not_start_ranges, UNICODE_IDENT_NOT_START_RANGE_COUNT, codepoint);
+}
+
+//Returns the first byte after the identifier chars starting at cur, ASCII runs are scanned in bulk
+static
+msi scan_past_unicode_ident_cont(u8* data, msi cur, msi end)
+{
+    for(;;)
+    {
+        cur = scan_past_ident_cont(data, cur, end);
+        if(cur >= end || (unsigned char)data[cur] < 0x80)
+        {
+            return cur;
+        }
+        
+        u32 codepoint = 0;
+        msi length = utf8_decode(data, cur, end, &codepoint);
+        if(!length || !unicode_is_ident_cont(codepoint))
+        {
+            return cur;
+        }
+        cur += length;
+    }
+}
+
+/*
+   Lexes the token at t->cur and advances past it. Returns TOKEN_EOF once no token
+   starts before t->range_end. TOKEN_NUM values are decoded into *number, the payload
+   is left for the caller (see lex_tokens_into_stream and the parser's token ring).
+*/
+static
+Token lex_token(Tokenizer* t, Number_Literal* number)
+{
+    u8* data = t->file.data;
+    msi end = t->file.length;
+    
+    for(;;)
+    {
+        skip_whitespace_and_comments(t);
+        
+        Token token = {};
+        token.offset = t->cur;
+        token.length = 1;
+        
+        if(t->cur >= t->range_end)
+        {
+            token.type = TOKEN_EOF;
+            token.length = 0;
+            return token;
+        }
+        
+        Token_Type op_type = TOKEN_UNKOWN;
+        msi op_length = lex_operator(data, t->cur, &op_type);
+        if(op_length)
+        {
+            token.type = op_type;
+            token.length = op_length;
+            t->cur += op_length;
+            return token;
+        }
+        
+        c8 c = data[t->cur];
+        
+        if(c == '"')
+        {
+            token.type = TOKEN_STR_LIT;
+            token.offset = t->cur + 1;
             
-            msi begin = 1;
-            for(;is_whitespace(t->file.data[t->cur+begin]);++begin)
-            {}
+            msi cur = 0;
+            token.payload = lex_string_literal(t, t->cur + 1, &cur);
+            token.length = cur - token.offset;
             
-            t->line_text.data = &t->file.data[t->cur+begin];
+            if(cur < end)
+                ++cur;
+            t->cur = cur;
             
-            msi i = 0;
-            for(; !is_end_of_line(t->line_text.data[i]); ++i)
-            {}
+            return token;
+        }
+        
+        if(ir_char_class(c) & IR_CC_IDENT_START)
+        {
+            token.type = TOKEN_ID;
             
-            t->line_text.length = i+1;
+            msi cur = scan_past_ident_cont(data, t->cur + 1, end);
+            if((unsigned char)data[cur] >= 0x80)
+            {
+                cur = scan_past_unicode_ident_cont(data, cur, end);
+            }
+            
+            token.length = cur - t->cur;
+            t->cur = cur;
+            
+            const Keyword* keyword = lookup_keyword(&data[token.offset], token.length);
+            if(keyword)
+            {
+                token.type = keyword->type;
+                token.payload = keyword->data_type;
+            }
+            else
+            {
+                String name = {token.length, (u8*)&data[token.offset]};
+                token.payload = intern(t->tokens.symbols, name, hash_short_string(name));
+            }
             
+            return token;
         }
-        ++t->cur;
         
-        t->n[0] = t->file.data[t->cur];
         
-        if(t->cur+1 < t->file.length)
-            t->n[1] = t->file.data[t->cur+1];
-        else
-            t->n[1] = 0;
+        if(is_number(c))
+        {
+            token.type = TOKEN_NUM;
+            msi cur = lex_number(data, t->cur, end, number);
+            token.length = cur - t->cur;
+            t->cur = cur;
+            return token;
+        }
         
-        if(t->cur+2 < t->file.length)
-            t->n[2] = t->file.data[t->cur+2];
-        else
-            t->n[2] = 0;
+        //NOTE(Michael): Only bytes >= 0x80 get here, ASCII never pays for the decoding
+        if((unsigned char)c >= 0x80)
+        {
+            u32 codepoint = 0;
+            msi length = utf8_decode(data, t->cur, end, &codepoint);
+            if(length && unicode_is_ident_start(codepoint))
+            {
+                token.type = TOKEN_ID;
+                msi cur = scan_past_unicode_ident_cont(data, t->cur + length, end);
+                token.length = cur - t->cur;
+                String name = {token.length, (u8*)&data[token.offset]};
+                token.payload = intern(t->tokens.symbols, name, hash_short_string(name));
+                t->cur = cur;
+                return token;
+            }
+            token.length = length ? length : 1;
+        }
+        
+        //No token starts with this character, the parser reports it
+        token.type = TOKEN_INVALID;
+        t->cur += token.length;
+        return token;
     }
 }
 
-static 
-void skip_whitespace_and_comments(Tokenizer* t)
+/*
+   Lexes every token that starts in [t->cur, range_end) into t->tokens, without the EOF
+   token. Tokens may run past range_end (the chunks of tokenize_parallel end at a
+   newline so they never do).
+*/
+static
+Token lex_tokens_into_stream(Tokenizer* t, msi range_end)
 {
+    t->range_end = range_end;
     for(;;)
     {
-        if(is_whitespace(t->n[0]) || is_end_of_line(t->n[0]))
+        Number_Literal number;
+        Token token = lex_token(t, &number);
+        if(token.type == TOKEN_EOF)
         {
-            adv_chars(t, 1);
-            continue;
+            return token;
+        }
+        
+        if(token.type == TOKEN_NUM)
+        {
+            token.payload = ARR_LEN(t->tokens.numbers);
+            ARR_PUSH(t->tokens.numbers, number);
         }
-        //Skip CPP style comment
-        if(t->n[0] == '/' && t->n[1] == '/')
+        token_stream_push(&t->tokens, token);
+    }
+}
+
+static
+Token_Stream tokenize(String file, Interner* symbols, Heap_Allocator* heap)
+{
+    IR_NOT_NULL(heap);
+    IR_NOT_NULL(symbols);
+    Tokenizer t = create_tokenizer(file, symbols, heap);
+    tokenizer_init_token_arrays(&t);
+    Token eof = lex_tokens_into_stream(&t, file.length);
+    token_stream_push(&t.tokens, eof);
+    
+    return t.tokens;
+}
+
+//Where a line of the chunk prescan starts, chunks may only start in PRESCAN_CODE
+enum Prescan_State : u8
+{
+    PRESCAN_CODE,
+    PRESCAN_STRING,
+    PRESCAN_BLOCK_COMMENT,
+    PRESCAN_STATE_COUNT,
+};
+
+//Returns the index right after the quote that closes the string literal whose body starts at begin or end
+static
+msi scan_past_string_literal(u8* data, msi begin, msi end)
+{
+    msi i = begin;
+    while(i < end)
+    {
+        u32 hits = 0;
+#if defined(__AVX2__)
+        if(i + 32 <= end)
         {
-            while(!is_end_of_line(t->n[0]))
+            hits = ir_byte_mask_32(&data[i], '"') | ir_byte_mask_32(&data[i], '\\');
+            if(!hits)
             {
-                adv_chars(t, 1);
+                i += 32;
+                continue;
             }
-            continue;
         }
-  
-        
-        //Skip C style comment
-        if(t->n[0] == '/' && t->n[1] == '*')
+        else
+#endif
+#if defined(__SSE2__)
+        if(i + 16 <= end)
         {
-            while(!(t->n[0] == '*' && t->n[1] == '/'))
+            hits = ir_byte_mask_16(&data[i], '"') | ir_byte_mask_16(&data[i], '\\');
+            if(!hits)
             {
-                adv_chars(t, 1);
-            }  
-            adv_chars(t, 2);
-            continue;
+                i += 16;
+                continue;
+            }
+        }
+        else
+#endif
+        {
+            hits = data[i] == '"' || data[i] == '\\';
+            if(!hits)
+            {
+                ++i;
+                continue;
+            }
         }
         
-        break;
+        i += intr_bsf(hits);
+        if(data[i] == '"')
+        {
+            return i + 1;
+        }
+        //NOTE(Michael): Same escape rule as lex_string_literal, only \" can hide a quote
+        i += data[i+1] == '"' ? 2 : 1;
+    }
+    return end;
+}
+
+//Returns the index of the first '"', '/' or end of line char in [begin, end) or end
+static
+msi scan_to_code_event(u8* data, msi begin, msi end)
+{
+    msi i = begin;
+#if defined(__AVX2__)
+    for(; i + 32 <= end; i += 32)
+    {
+        u32 events = ir_byte_mask_32(&data[i], '"') | ir_byte_mask_32(&data[i], '/') | ir_end_of_line_mask_32(&data[i]);
+        if(events)
+        {
+            return i + intr_bsf(events);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    for(; i + 16 <= end; i += 16)
+    {
+        u32 events = ir_byte_mask_16(&data[i], '"') | ir_byte_mask_16(&data[i], '/') | ir_end_of_line_mask_16(&data[i]);
+        if(events)
+        {
+            return i + intr_bsf(events);
+        }
     }
+#endif
+    for(; i < end && data[i] != '"' && data[i] != '/' && !is_end_of_line(data[i]); ++i)
+    {}
+    return i;
 }
 
+/*
+   Steps from cur, which is outside of literals and comments, to the next line start
+   outside of them. Stops at limit (a line start or the end of the file) and writes the
+   state the line at limit starts in. A literal or comment never ends at a line start, so
+   the state at limit decides alone how the next line continues.
+*/
 static
-Token* tokenize(String file, Heap_Allocator* heap)
+msi prescan_next_line(u8* data, msi cur, msi limit, msi end, Prescan_State* state)
 {
-    IR_NOT_NULL(heap);
-    Tokenizer t = create_tokenizer(file, heap);
-    
-    while(t.n[0] != 0)
+    *state = PRESCAN_CODE;
+    while(cur < limit)
     {
-        skip_whitespace_and_comments(&t);
-        
-        Token token = {};
-        token.text.data = &t.file.data[t.cur];
-        token.text.length = 1;
-        token.line = t.cur_line;
-        token.column = t.cur_column;
-        token.line_text = t.line_text;
-        
-        
-        if(t.n[0] == '=' && t.n[1] == '=')
+        cur = scan_to_code_event(data, cur, limit);
+        if(cur == limit)
         {
-            token.type = TOKEN_D_EQ;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;     
+            break;
         }
         
-        if(t.n[0] == '&' && t.n[1] == '&')
+        u8 c = data[cur];
+        if(is_end_of_line(c))
         {
-            token.type = TOKEN_AND;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;     
+            return cur + 1;
         }
-        
-        if(t.n[0] == '|' && t.n[1] == '|')
+        if(c == '"')
         {
-            token.type = TOKEN_OR;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;     
+            cur = scan_past_string_literal(data, cur + 1, end);
+            *state = PRESCAN_STRING;
         }
-        
-        if(t.n[0] == '!' && t.n[1] == '=')
+        else if(data[cur+1] == '/')
         {
-            token.type = TOKEN_OR;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;     
+            cur = scan_to_end_of_line(data, cur + 2, end);
         }
-
-        if(t.n[0] == '<' && t.n[1] == '=')
+        else if(data[cur+1] == '*')
         {
-            token.type = TOKEN_LEQ;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            cur = scan_past_block_comment(data, cur + 2, end);
+            *state = PRESCAN_BLOCK_COMMENT;
         }
-
-        if(t.n[0] == '>' && t.n[1] == '=')
+        else
         {
-            token.type = TOKEN_GEQ;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            ++cur;
         }
         
-        if(t.n[0] == '+' && t.n[1] == '+')
+        if(cur > limit)
         {
-            token.type = TOKEN_D_PLUS;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            return limit;
         }
-        
-        if(t.n[0] == '-' && t.n[1] == '-')
+        *state = PRESCAN_CODE;
+    }
+    return limit;
+}
+
+/*
+   Prescan of the lines [begin, limit) for every state the first line can start in. For
+   each one the run finds the first line start outside of literals and comments (boundary,
+   0 if there is none) and the state the line at limit starts in (exit). Runs that reach
+   the same line start in code go on as one, in practice they meet after a few lines.
+*/
+struct Chunk_Prescan
+{
+    u8* data;
+    msi begin;
+    msi limit;
+    msi end;
+    msi boundary[PRESCAN_STATE_COUNT];
+    Prescan_State exit[PRESCAN_STATE_COUNT];
+    b8 need_exit;
+    pthread_t thread;
+};
+
+static
+void* prescan_chunk(void* data)
+{
+    Chunk_Prescan* chunk = (Chunk_Prescan*)data;
+    u8* file = chunk->data;
+    msi cur[PRESCAN_STATE_COUNT] = {chunk->begin, chunk->begin, chunk->begin};
+    u32 same_as[PRESCAN_STATE_COUNT] = {PRESCAN_CODE, PRESCAN_STRING, PRESCAN_BLOCK_COMMENT};
+    b8 running[PRESCAN_STATE_COUNT] = {};
+    
+    for(u32 s = 0; s < PRESCAN_STATE_COUNT; ++s)
+    {
+        chunk->boundary[s] = 0;
+        chunk->exit[s] = (Prescan_State)s;
+        if(chunk->begin < chunk->limit)
         {
-            token.type = TOKEN_D_MINUS;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            if(s == PRESCAN_STRING)
+            {
+                cur[s] = scan_past_string_literal(file, chunk->begin, chunk->end);
+            }
+            else if(s == PRESCAN_BLOCK_COMMENT)
+            {
+                cur[s] = scan_past_block_comment(file, chunk->begin, chunk->end);
+            }
+            //NOTE(Michael): A literal or comment never ends at the line start limit
+            running[s] = cur[s] < chunk->limit;
+            chunk->exit[s] = running[s] ? PRESCAN_CODE : (Prescan_State)s;
         }
-        
-        if(t.n[0] == '+' && t.n[1] == '=')
+    }
+    chunk->boundary[PRESCAN_CODE] = running[PRESCAN_CODE] ? chunk->begin : 0;
+    running[PRESCAN_CODE] &= chunk->need_exit;
+    
+    for(;;)
+    {
+        //NOTE(Michael): The run that is furthest behind steps, so runs that meet are found right away
+        u32 next = PRESCAN_STATE_COUNT;
+        for(u32 s = 0; s < PRESCAN_STATE_COUNT; ++s)
         {
-            token.type = TOKEN_PLUS_EQ;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            if(running[s] && (next == PRESCAN_STATE_COUNT || cur[s] < cur[next]))
+            {
+                next = s;
+            }
         }
-        
-        if(t.n[0] == '-' && t.n[1] == '=')
+        if(next == PRESCAN_STATE_COUNT)
         {
-            token.type = TOKEN_MINUS_EQ;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            break;
         }
         
-        if(t.n[0] == '*' && t.n[1] == '=')
+        Prescan_State state;
+        cur[next] = prescan_next_line(file, cur[next], chunk->limit, chunk->end, &state);
+        if(cur[next] >= chunk->limit)
         {
-            token.type = TOKEN_MUL_EQ;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
+            running[next] = false;
+            chunk->exit[next] = state;
             continue;
         }
-        
-        if(t.n[0] == '/' && t.n[1] == '=')
+        if(!chunk->boundary[next])
         {
-            token.type = TOKEN_DIV_EQ;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            //NOTE(Michael): Without the exit states (last chunk) a run is done at its boundary
+            chunk->boundary[next] = cur[next];
+            running[next] = chunk->need_exit;
         }
-        
-        if(t.n[0] == '%' && t.n[1] == '=')
+        for(u32 s = 0; s < PRESCAN_STATE_COUNT; ++s)
         {
-            token.type = TOKEN_MOD_EQ;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            if(s != next && running[s] && cur[s] == cur[next] && chunk->boundary[next])
+            {
+                running[next] = false;
+                same_as[next] = s;
+                break;
+            }
         }
-        
-        if(t.n[0] == '<' && t.n[1] == '<' && t.n[2] == '=')
+    }
+    
+    for(u32 s = 0; s < PRESCAN_STATE_COUNT; ++s)
+    {
+        u32 run = s;
+        while(same_as[run] != run)
         {
-            token.type = TOKEN_SHIFT_L_EQ;
-            adv_chars(&t, 3);
-            token.text.length = 3;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            run = same_as[run];
         }
-        
-        if(t.n[0] == '>' && t.n[1] == '>' && t.n[2] == '=')
+        chunk->exit[s] = chunk->exit[run];
+    }
+    return nullptr;
+}
+
+/*
+   Splits the file into at most chunk_count chunks of about the same size and writes
+   chunk i as [boundaries[i], boundaries[i+1]). Every boundary is the byte after an end
+   of line char outside of string literals and comments, the tokenizer state there is
+   the same as at the start of the file. Returns the number of chunks.
+   Each part of the file is prescanned on its own thread from the line after its nominal
+   split for every state that line can start in, then the states are chained in order.
+*/
+static
+u32 find_chunk_boundaries(String file, u32 chunk_count, msi* boundaries)
+{
+    u8* data = file.data;
+    msi end = file.length;
+    boundaries[0] = 0;
+    if(chunk_count <= 1)
+    {
+        boundaries[1] = end;
+        return 1;
+    }
+    
+    Chunk_Prescan chunks[TOKENIZER_MAX_THREADS] = {};
+    for(u32 i = 0; i < chunk_count; ++i)
+    {
+        chunks[i].data = data;
+        chunks[i].end = end;
+        chunks[i].need_exit = i + 1 < chunk_count;
+        if(i > 0)
         {
-            token.type = TOKEN_SHIFT_R_EQ;
-            adv_chars(&t, 3);
-            token.text.length = 3;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            msi line = scan_to_end_of_line(data, i * (end / chunk_count), end) + 1;
+            chunks[i].begin = u64_max(u64_min(line, end), chunks[i-1].begin);
+            chunks[i-1].limit = chunks[i].begin;
         }
-        
-        if(t.n[0] == '&' && t.n[1] == '=')
+    }
+    chunks[chunk_count-1].limit = end;
+    
+    for(u32 i = 1; i < chunk_count; ++i)
+    {
+        if(pthread_create(&chunks[i].thread, nullptr, prescan_chunk, &chunks[i]))
         {
-            token.type = TOKEN_AND_EQ;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            prescan_chunk(&chunks[i]);
+            chunks[i].thread = 0;
         }
-        
-        if(t.n[0] == '^' && t.n[1] == '=')
+    }
+    prescan_chunk(&chunks[0]);
+    for(u32 i = 1; i < chunk_count; ++i)
+    {
+        if(chunks[i].thread)
         {
-            token.type = TOKEN_XOR_EQ;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            pthread_join(chunks[i].thread, nullptr);
         }
-        
-        if(t.n[0] == '|' && t.n[1] == '=')
+    }
+    
+    u32 found = 0;
+    Prescan_State state = chunks[0].exit[PRESCAN_CODE];
+    for(u32 i = 1; i < chunk_count; ++i)
+    {
+        msi boundary = chunks[i].boundary[state];
+        if(boundary > boundaries[found] && boundary < end)
         {
-            token.type = TOKEN_OR_EQ;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            boundaries[++found] = boundary;
         }
-        
-        if(t.n[0] == '<' && t.n[1] == '<')
+        state = chunks[i].exit[state];
+    }
+    
+    boundaries[++found] = end;
+    return found;
+}
+
+struct Tokenize_Chunk
+{
+    Tokenizer tokenizer;
+    msi end;
+    pthread_t thread;
+};
+
+static
+void* tokenize_chunk(void* data)
+{
+    Tokenize_Chunk* chunk = (Tokenize_Chunk*)data;
+    lex_tokens_into_stream(&chunk->tokenizer, chunk->end);
+    return nullptr;
+}
+
+/*
+   Same result as tokenize() but lexes chunks of the file on up to thread_count threads
+   (the calling thread included). The heap is switched to thread safe mode while the
+   threads run, afterwards the chunk streams are concatenated: number payloads are
+   rebased and the string literals are interned again into one table.
+   All threads intern identifiers into symbols, names that are new to it are numbered
+   in the order the threads reach them, not in source order.
+*/
+static
+Token_Stream tokenize_parallel(String file, Interner* symbols, Heap_Allocator* heap, u32 thread_count)
+{
+    IR_NOT_NULL(heap);
+    thread_count = u64_min(u64_min(thread_count, TOKENIZER_MAX_THREADS), file.length / TOKENIZER_MIN_CHUNK_SIZE);
+    if(thread_count <= 1)
+    {
+        return tokenize(file, symbols, heap);
+    }
+    
+    msi boundaries[TOKENIZER_MAX_THREADS + 1];
+    u32 chunk_count = find_chunk_boundaries(file, thread_count, boundaries);
+    Tokenize_Chunk chunks[TOKENIZER_MAX_THREADS] = {};
+    
+    for(u32 i = 0; i < chunk_count; ++i)
+    {
+        chunks[i].tokenizer = create_tokenizer(file, symbols, heap);
+        tokenizer_init_token_arrays(&chunks[i].tokenizer);
+        chunks[i].tokenizer.cur = boundaries[i];
+        chunks[i].end = boundaries[i+1];
+    }
+    
+    b8 was_thread_safe = heap->thread_safe;
+    heap->thread_safe = true;
+    for(u32 i = 1; i < chunk_count; ++i)
+    {
+        if(pthread_create(&chunks[i].thread, nullptr, tokenize_chunk, &chunks[i]))
         {
-            token.type = TOKEN_SHIFT_L;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            tokenize_chunk(&chunks[i]);
+            chunks[i].thread = 0;
         }
-        
-        if(t.n[0] == '>' && t.n[1] == '>')
+    }
+    tokenize_chunk(&chunks[0]);
+    for(u32 i = 1; i < chunk_count; ++i)
+    {
+        if(chunks[i].thread)
         {
-            token.type = TOKEN_SHIFT_R;
-            adv_chars(&t, 2);
-            token.text.length = 2;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            pthread_join(chunks[i].thread, nullptr);
+        }
+    }
+    heap->thread_safe = was_thread_safe;
+    
+    Tokenizer t = create_tokenizer(file, symbols, heap);
+    tokenizer_init_token_arrays(&t);
+    msi token_count = 1;
+    msi number_count = 0;
+    msi escaped_literal_bytes = 0;
+    for(u32 i = 0; i < chunk_count; ++i)
+    {
+        Token_Stream* c = &chunks[i].tokenizer.tokens;
+        token_count += token_stream_len(c);
+        number_count += ARR_LEN(c->numbers);
+        for(msi j = 0; j < ARR_LEN(c->str_literals); ++j)
+        {
+            if(!ptr_in_buffer(file, c->str_literals[j].data))
+            {
+                escaped_literal_bytes += c->str_literals[j].length;
+            }
         }
+    }
+    
+    ARR_SET_CAP(t.tokens.kinds, token_count);
+    ARR_SET_CAP(t.tokens.offsets, token_count);
+    ARR_SET_CAP(t.tokens.lengths, token_count);
+    ARR_SET_CAP(t.tokens.payloads, token_count);
+    ARR_SET_CAP(t.tokens.numbers, number_count);
+    if(escaped_literal_bytes)
+    {
+        tokenizer_push_literal_block(&t, escaped_literal_bytes);
+    }
+    
+    for(u32 i = 0; i < chunk_count; ++i)
+    {
+        Tokenizer* chunk = &chunks[i].tokenizer;
+        Token_Stream* c = &chunk->tokens;
         
-        switch(t.n[0])
-        {
-            case '(':
-            case ')':
-            case '[':
-            case ']':
-            case '{':
-            case '}':
-            case '<':
-            case '>':
-            case '%':
-            case '+':
-            case '-':
-            case '*':
-            case '/':
-            case '!':
-            case '=':
-            case ':':
-            case ';':
-            case ',':
-            case '.':
-            case '#':
-            case '&':
-            case '|':
-            case '^':
-            case '$':
-            case '?':
-            case '~':
+        msi literal_count = ARR_LEN(c->str_literals);
+        u32* literal_map = (u32*)DYN_ALLOC(u64_max(literal_count, 1) * sizeof(u32), heap);
+        for(msi j = 0; j < literal_count; ++j)
+        {
+            String literal = c->str_literals[j];
+            b8 is_new = false;
+            literal_map[j] = tokenizer_intern_literal(&t, literal, &is_new);
+            if(is_new && !ptr_in_buffer(file, literal.data))
             {
-                token.type = (Token_Type)t.n[0];
-                adv_chars(&t, 1);
-                
-                ARR_PUSH(t.tokens, token);
-                continue;
+                Buffer copy = create_buffer(literal.length, &t.tokens.literal_arena);
+                copy_buffer(literal, copy);
+                t.tokens.str_literals[literal_map[j]].data = copy.data;
             }
         }
         
-        if(t.n[0] == '"')
+        u32 number_base = ARR_LEN(t.tokens.numbers);
+        msi numbers = ARR_LEN(c->numbers);
+        if(numbers)
         {
-            String str_lit;
-            ARR_INIT(str_lit.data, 4, heap);
-            token.type = TOKEN_STR_LIT;
-            adv_chars(&t, 1);
-            token.line = t.cur_line;
-            token.column = t.cur_column;
+            copy_buffer(IR_WRAP_INTO_BUFFER(c->numbers, numbers * sizeof(Number_Literal)),
+                        IR_WRAP_INTO_BUFFER(ARR_ADD_N_PTR(t.tokens.numbers, numbers), numbers * sizeof(Number_Literal)));
+        }
+        
+        msi count = token_stream_len(c);
+        if(count)
+        {
+            copy_buffer(IR_WRAP_INTO_BUFFER(c->kinds, count * sizeof(u8)),
+                        IR_WRAP_INTO_BUFFER(ARR_ADD_N_PTR(t.tokens.kinds, count), count * sizeof(u8)));
+            copy_buffer(IR_WRAP_INTO_BUFFER(c->offsets, count * sizeof(u32)),
+                        IR_WRAP_INTO_BUFFER(ARR_ADD_N_PTR(t.tokens.offsets, count), count * sizeof(u32)));
+            copy_buffer(IR_WRAP_INTO_BUFFER(c->lengths, count * sizeof(u32)),
+                        IR_WRAP_INTO_BUFFER(ARR_ADD_N_PTR(t.tokens.lengths, count), count * sizeof(u32)));
             
-            while(t.n[0] != '"' && t.n[0] != 0)
+            u32* payloads = ARR_ADD_N_PTR(t.tokens.payloads, count);
+            for(msi j = 0; j < count; ++j)
             {
-                
-                if(t.n[0] == '\\' && t.n[1] == '"')
-                {
-                    adv_chars(&t, 2);
-                    ARR_PUSH(str_lit.data, t.n[0]);
-                    ARR_PUSH(str_lit.data, t.n[1]);
-                }
-                else if(t.n[0] == '\\' && t.n[1] == 'n')
+                Token_Type type = token_stream_type(c, j);
+                u32 payload = c->payloads[j];
+                if(type == TOKEN_NUM)
                 {
-                    adv_chars(&t, 2);
-                    ARR_PUSH(str_lit.data, '\n');
+                    payload += number_base;
                 }
-                else
+                else if(type == TOKEN_STR_LIT)
                 {
-                    ARR_PUSH(str_lit.data, t.n[0]);
-                    adv_chars(&t, 1);
+                    payload = literal_map[payload];
                 }
+                payloads[j] = payload;
             }
-            
-            if(t.n[0] == '"')
-                adv_chars(&t, 1);
-            
-            str_lit.length = ARR_LEN(str_lit.data);
-            token.text.length = str_lit.length;
-            token.text.data = str_lit.data;
-            ARR_PUSH(t.str_literals, str_lit); 
-            ARR_PUSH(t.tokens, token);
-            continue;
         }
         
-        if(is_alpha(t.n[0]) || t.n[0] == '_')
+        t.cur = chunk->cur;
+        
+        DYN_FREE(literal_map, heap);
+        token_stream_free(c);
+    }
+    
+    Token token = {};
+    token.offset = t.cur;
+    token.length = 0;
+    token.type = TOKEN_EOF;
+    token_stream_push(&t.tokens, token);
+    
+    return t.tokens;
+}
+
+struct Text_Edit
+{
+    msi offset;      //Where the edit starts in the old text
+    msi deleted;     //Bytes removed at offset
+    String inserted; //Bytes inserted at offset
+};
+
+//First byte the lexer consumed for t (the opening quote of string literals)
+inline
+msi token_begin(Token t)
+{
+    return t.type == TOKEN_STR_LIT ? t.offset - 1 : t.offset;
+}
+
+//One past the last byte the lexer consumed for t (the closing quote of string literals)
+inline
+msi token_end(String file, Token t)
+{
+    msi end = t.offset + t.length;
+    if(t.type == TOKEN_STR_LIT && end < file.length)
+    {
+        ++end;
+    }
+    return end;
+}
+
+//Index of the first token with token_end >= offset
+static
+msi token_stream_find(Token_Stream* s, msi offset)
+{
+    msi low = 0;
+    msi high = token_stream_len(s);
+    while(low < high)
+    {
+        msi mid = low + (high - low) / 2;
+        if(token_end(s->file, token_stream_get(s, mid)) < offset)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+//Makes room for at least n tokens in the gap of s, it grows by a part of the stream so this stays rare
+static
+void token_stream_reserve_gap(Token_Stream* s, msi n)
+{
+    if(s->gap < n)
+    {
+        msi gap_begin = token_stream_len(s) - s->tail;
+        msi grow = n - s->gap + token_stream_len(s) / 16 + 64;
+        ARR_INS_N(s->kinds, gap_begin, grow);
+        ARR_INS_N(s->offsets, gap_begin, grow);
+        ARR_INS_N(s->lengths, gap_begin, grow);
+        ARR_INS_N(s->payloads, gap_begin, grow);
+        s->gap += grow;
+    }
+}
+
+/*
+   Moves the gap of s in front of token index split. Tokens that cross the gap switch
+   between absolute offsets and offsets counted back from the end of s->file.
+*/
+static
+void token_stream_move_gap(Token_Stream* s, msi split)
+{
+    msi gap_begin = token_stream_len(s) - s->tail;
+    msi gap = s->gap;
+    u32 file_end = (u32)s->file.length;
+    for(; gap_begin > split; --gap_begin)
+    {
+        msi from = gap_begin - 1;
+        s->kinds[from + gap] = s->kinds[from];
+        s->offsets[from + gap] = file_end - s->offsets[from];
+        s->lengths[from + gap] = s->lengths[from];
+        s->payloads[from + gap] = s->payloads[from];
+    }
+    for(; gap_begin < split; ++gap_begin)
+    {
+        msi from = gap_begin + gap;
+        s->kinds[gap_begin] = s->kinds[from];
+        s->offsets[gap_begin] = file_end - s->offsets[from];
+        s->lengths[gap_begin] = s->lengths[from];
+        s->payloads[gap_begin] = s->payloads[from];
+    }
+    s->tail = token_stream_len(s) - split;
+}
+
+/*
+   Updates tokens (a result of tokenize) to new_file, which is its old text with edit
+   applied and padded like every tokenizer input. tokens->file has to be readable
+   during the call (the previous snapshot).
+   
+   Lexing only looks ahead through bytes that are not whitespace, so a token is only
+   damaged if it touches the edit or is glued to a damaged token. Lexing restarts after
+   the last undamaged token and stops as soon as a new token starts exactly where an old
+   token behind the edit started, from there on both lexers see the same bytes.
+   
+   The gap of the stream is moved to the damaged tokens and they are replaced in place.
+   Offsets behind the gap count back from the end of the file, so the rest of the stream
+   is not touched: an edit costs the relexed tokens plus the tokens the gap moves over
+   since the last edit (all tokens behind the first edit of a fresh stream).
+   
+   Zero copy string literals are moved to new_file, literals whose bytes were edited are
+   copied into the literal blocks first. Numbers of the replaced tokens are chained into
+   tokens->free_number and reused by later numbers.
+*/
+static
+void retokenize(Token_Stream* tokens, String new_file, Text_Edit edit)
+{
+    IR_ASSERT(new_file.length < 0xFFFFFFFF && "Token offsets are 32 bit!");
+    IR_ASSERT(new_file.data[new_file.length] == 0 && "The file needs TOKENIZER_PADDING zero bytes behind it!");
+    String old_file = tokens->file;
+    Heap_Allocator* heap = arr_header(tokens->kinds)->heap;
+    s64 shift = (s64)edit.inserted.length - (s64)edit.deleted;
+    msi old_edit_end = edit.offset + edit.deleted;
+    msi count = token_stream_len(tokens);
+    
+    //Walk back over tokens that are glued together, their lexing looked into the next one
+    msi first = token_stream_find(tokens, edit.offset);
+    while(first > 0 && first < count &&
+          token_end(old_file, token_stream_get(tokens, first-1)) == token_begin(token_stream_get(tokens, first)))
+    {
+        --first;
+    }
+    //NOTE(Michael): A fresh stream has no gap yet, it is cheapest to add while it is at the end
+    token_stream_reserve_gap(tokens, 64);
+    token_stream_move_gap(tokens, first);
+    
+    msi old_index = first;
+    while(old_index < count && token_begin(token_stream_get(tokens, old_index)) < old_edit_end)
+    {
+        ++old_index;
+    }
+    
+    Tokenizer t = {};
+    t.file = new_file;
+    t.range_end = new_file.length;
+    t.heap = heap;
+    t.tokens = *tokens;
+    t.tokens.file = new_file;
+    t.cur = first ? token_end(old_file, token_stream_get(tokens, first-1)) : 0;
+    
+    //Move zero copy literals over to the new text before new ones get interned
+    for(msi i = 0; i < ARR_LEN(t.tokens.str_literals); ++i)
+    {
+        String* literal = &t.tokens.str_literals[i];
+        msi at = literal->data - old_file.data;
+        if(literal->data < old_file.data || at > old_file.length)
         {
-            token.type = TOKEN_ID;
-            
-            u32 length = 1;
-            adv_chars(&t, 1);
-            while( is_alpha(t.n[0]) || is_number(t.n[0]) || t.n[0] == '_')
-            {
-                adv_chars(&t,1);
-                length++;
-            }
-            
-            token.text.length = length;
-            
-            if(cmp_string(IR_CONSTZ("fn"), token.text))
-            {
-                token.type = TOKEN_FN;   
-            }else if(cmp_string(IR_CONSTZ("return"), token.text))
-            {
-                token.type = TOKEN_RETURN;   
-            }else if(cmp_string(IR_CONSTZ("if"), token.text))
-            {
-                token.type = TOKEN_IF;   
-            }else if(cmp_string(IR_CONSTZ("else"), token.text))
-            {
-                token.type = TOKEN_ELSE;   
-            }else if(cmp_string(IR_CONSTZ("for"), token.text))
-            {
-                token.type = TOKEN_FOR;   
-            }else if(cmp_string(IR_CONSTZ("while"), token.text))
-            {
-                token.type = TOKEN_WHILE;   
-            }else if(cmp_string(IR_CONSTZ("break"), token.text))
-            {
-                token.type = TOKEN_BREAK;   
-            }else if(cmp_string(IR_CONSTZ("continue"), token.text))
-            {
-                token.type = TOKEN_CONT;   
-            }else if(cmp_string(IR_CONSTZ("struct"), token.text))
-            {
-                token.type = TOKEN_STRUCT;   
-            }else if(cmp_string(IR_CONSTZ("cast"), token.text))
-            {
-                token.type = TOKEN_CAST;   
-            }else if(cmp_string(IR_CONSTZ("s8"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE;
-                token.data_type = TYPE_S8;
-            }else if(cmp_string(IR_CONSTZ("s16"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE;
-                token.data_type = TYPE_S16;   
-            }else if(cmp_string(IR_CONSTZ("s32"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE;   
-                token.data_type = TYPE_S32;
-            }else if(cmp_string(IR_CONSTZ("s64"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE;
-                token.data_type = TYPE_S64;  
-            }else if(cmp_string(IR_CONSTZ("u8"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE;  
-                token.data_type = TYPE_U8; 
-            }else if(cmp_string(IR_CONSTZ("u16"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE;   
-                token.data_type = TYPE_U16; 
-            }else if(cmp_string(IR_CONSTZ("u32"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE;  
-                token.data_type = TYPE_U32;  
-            }else if(cmp_string(IR_CONSTZ("u64"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE;  
-                token.data_type = TYPE_U64;  
-            }else if(cmp_string(IR_CONSTZ("msi"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE;  
-                token.data_type = TYPE_MSI;  
-            }else if(cmp_string(IR_CONSTZ("f32"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE; 
-                token.data_type = TYPE_F32;   
-            }else if(cmp_string(IR_CONSTZ("f64"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE; 
-                token.data_type = TYPE_F64;   
-            }else if(cmp_string(IR_CONSTZ("b8"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE;  
-                token.data_type = TYPE_B8;  
-            }else if(cmp_string(IR_CONSTZ("void"), token.text))
-            {
-                token.type = TOKEN_BASIC_TYPE; 
-                token.data_type = TYPE_VOID;   
-            }
-            
-            ARR_PUSH(t.tokens, token);
             continue;
         }
         
-        
-        if(is_number(t.n[0]))
+        if(at + literal->length <= edit.offset)
         {
-            token.type = TOKEN_NUM;
-            u32 num_length = 0;
-            bool isFloat = false;
-            while(is_number(t.n[0]) || (!isFloat && t.n[0]=='.'))
+            literal->data = new_file.data + at;
+        }
+        else if(at >= old_edit_end)
+        {
+            literal->data = new_file.data + at + shift;
+        }
+        else
+        {
+            Memory_Arena* arena = &t.tokens.literal_arena;
+            if((msi)(arena->buffer.data + arena->buffer.length - arena->current_base) < literal->length)
             {
-                if (t.n[0]=='.'){
-                    isFloat = true;
-                }
-                num_length++;
-                adv_chars(&t, 1);
+                tokenizer_push_literal_block(&t, literal->length);
             }
-            token.text.length = num_length;
-            ARR_PUSH(t.tokens, token);
-            continue;
+            Buffer copy = create_buffer(literal->length, arena);
+            copy_buffer(*literal, copy);
+            literal->data = copy.data;
         }
+    }
+    
+    Token* relexed = nullptr;
+    ARR_INIT(relexed, 64, heap);
+    for(;;)
+    {
+        Number_Literal number;
+        Token token = lex_token(&t, &number);
+        msi begin = token_begin(token);
         
+        while(old_index < count && token_begin(token_stream_get(tokens, old_index)) + shift < begin)
+        {
+            ++old_index;
+        }
+        if(old_index < count && token_begin(token_stream_get(tokens, old_index)) + shift == begin)
+        {
+            break;
+        }
         
+        if(token.type == TOKEN_NUM && t.tokens.free_number)
+        {
+            token.payload = t.tokens.free_number - 1;
+            t.tokens.free_number = (u32)t.tokens.numbers[token.payload].s_value;
+            t.tokens.numbers[token.payload] = number;
+        }
+        else if(token.type == TOKEN_NUM)
+        {
+            token.payload = ARR_LEN(t.tokens.numbers);
+            ARR_PUSH(t.tokens.numbers, number);
+        }
+        ARR_PUSH(relexed, token);
         
-        if(token.type == TOKEN_UNKOWN)
+        if(token.type == TOKEN_EOF)
         {
-            adv_chars(&t, 1);
-            
-            //ARR_PUSH(t.tokens, token);
-            continue;
+            old_index = count;
+            break;
         }
     }
     
-    Token token = {};
-    token.text.data = &t.file.data[t.cur];
-    token.text.length = 0;
-    token.type = TOKEN_EOF;
-    token.line = t.cur_line;
-    token.column = t.cur_column;
-    ARR_PUSH(t.tokens, token);
+    //The old tokens [first, old_index) are the first ones behind the gap, drop them and fill relexed in
+    msi old_n = old_index - first;
+    msi new_n = ARR_LEN(relexed);
+    for(msi i = 0; i < old_n; ++i)
+    {
+        msi slot = first + t.tokens.gap + i;
+        if((Token_Type)(t.tokens.kinds[slot] & 0xFF) == TOKEN_NUM)
+        {
+            t.tokens.numbers[t.tokens.payloads[slot]].s_value = t.tokens.free_number;
+            t.tokens.free_number = t.tokens.payloads[slot] + 1;
+        }
+    }
+    t.tokens.gap += old_n;
+    t.tokens.tail -= old_n;
     
-    return t.tokens;
+    token_stream_reserve_gap(&t.tokens, new_n);
+    for(msi i = 0; i < new_n; ++i)
+    {
+        t.tokens.kinds[first + i] = (u8)relexed[i].type;
+        t.tokens.offsets[first + i] = relexed[i].offset;
+        t.tokens.lengths[first + i] = relexed[i].length;
+        t.tokens.payloads[first + i] = relexed[i].payload;
+    }
+    t.tokens.gap -= new_n;
+    
+    ARR_FREE(relexed);
+    *tokens = t.tokens;
 }
 
 
@@ -8,6 +8,7 @@
 #include "ir_memory.h"
 #include "ir_string.h"
 #include "ir_ds.h"
+#include "ir_intern.h"
 
 enum Token_Type
 {
@@ -17,8 +18,9 @@ enum Token_Type
     TOKEN_NUM,
     TOKEN_STR_LIT,
     TOKEN_BASIC_TYPE,
+    TOKEN_INVALID, //A character no token starts with, the parser reports it
     
-    TOKEN_FN        = 1000,
+    TOKEN_FN        = 128,
     TOKEN_RETURN,
     TOKEN_IF,
     TOKEN_ELSE,
@@ -29,7 +31,7 @@ enum Token_Type
     TOKEN_STRUCT,
     TOKEN_CAST,
     
-    TOKEN_D_EQ      = 1100, // ==
+    TOKEN_D_EQ      = 160, // ==
     TOKEN_AND, // &&
     TOKEN_OR, // ||
     TOKEN_NOTEQ, // !=
@@ -55,7 +57,7 @@ enum Token_Type
     
     /*
        All single charactars are the same value as their ASCII value so A == 'A' == 65
-
+       All values have to fit into a byte, see Token_Stream::kinds
     */
     
 };
@@ -80,33 +82,152 @@ enum Type
     TYPE_COUNT,
 };
 
+/*
+   Value type handed out by the parser, the text and the position are resolved
+   against the source file on demand (see token_text and token_location).
+   payload is the Type for TOKEN_BASIC_TYPE, the index into str_literals
+   for TOKEN_STR_LIT, the index into numbers for TOKEN_NUM and the Symbol_Id
+   of the name for TOKEN_ID.
+*/
 struct Token
 {
-    String text;
-    String line_text;
+    u32 offset;
+    u32 length;
     Token_Type type;
-    Type data_type;
-    msi line;
-    msi column;
+    u32 payload;
+};
+
+enum Number_Error
+{
+    NUMBER_OK = 0,
+    NUMBER_ERROR_NO_DIGITS,
+    NUMBER_ERROR_OVERFLOW,
+    NUMBER_ERROR_INTEGER_SUFFIX_ON_FLOAT,
 };
 
-msi count_heading_whitespace_token_line(Token* t)
+/*
+   Numeric literal decoded by the tokenizer. Without a suffix integers are TYPE_S64
+   and floats TYPE_F64. Integer values are stored in s_value (u64 bit pattern for
+   u64/msi), floating point values in f_value (already rounded to f32 for f32).
+*/
+struct Number_Literal
 {
-    msi result = 0;
-    for(msi i = 1; i < t->column; ++i)
+    Type type;
+    b8 has_suffix;
+    Number_Error error;
+    union
     {
-        if(t->line_text.data[-i] == '\n')
-        {
-            break;
-        }
-        ++result;
-        if(t->line_text.data[-i] != ' ')
+        s64 s_value;
+        f64 f_value;
+    };
+};
+
+/*
+   Structure of arrays produced by tokenize(), 13 bytes per token.
+   kinds[i] holds the Token_Type, read it through token_stream_type because u8 is signed.
+   str_literals holds every distinct literal once. Literals without escapes point into
+   file, unescaped ones live in literal_blocks (literal_arena is the last block).
+   Identifiers are interned into symbols, which can be shared with other streams.
+   After retokenize the arrays are a gap buffer: gap unused slots sit in front of the
+   last tail tokens, whose offsets count back from the end of file. Read the tokens
+   through token_stream_get, token_stream_type and token_stream_len.
+*/
+struct Token_Stream
+{
+    String file;
+    Interner* symbols;
+    u8*  kinds;
+    u32* offsets;
+    u32* lengths;
+    u32* payloads;
+    msi gap;
+    msi tail;
+    String* str_literals;
+    Memory_Arena literal_arena;
+    Buffer* literal_blocks;
+    u32* literal_slots;     //Intern table, open addressing, index into str_literals + 1, 0 == empty
+    msi literal_slot_count;
+    Number_Literal* numbers;
+    u32 free_number;        //Unused entry of numbers + 1, the next one is chained through s_value, 0 == none
+};
+
+inline
+msi token_stream_len(Token_Stream* s)
+{
+    return ARR_LEN(s->kinds) - s->gap;
+}
+
+inline
+Token_Type token_stream_type(Token_Stream* s, msi i)
+{
+    if(i >= token_stream_len(s) - s->tail)
+    {
+        i += s->gap;
+    }
+    return (Token_Type)(s->kinds[i] & 0xFF);
+}
+
+inline
+Token token_stream_get(Token_Stream* s, msi i)
+{
+    Token result;
+    if(i < token_stream_len(s) - s->tail)
+    {
+        result.offset = s->offsets[i];
+    }
+    else
+    {
+        i += s->gap;
+        result.offset = (u32)s->file.length - s->offsets[i];
+    }
+    result.length = s->lengths[i];
+    result.type = (Token_Type)(s->kinds[i] & 0xFF);
+    result.payload = s->payloads[i];
+    return result;
+}
+
+inline
+void token_stream_push(Token_Stream* s, Token t)
+{
+    ARR_PUSH(s->kinds, (u8)t.type);
+    ARR_PUSH(s->offsets, t.offset);
+    ARR_PUSH(s->lengths, t.length);
+    ARR_PUSH(s->payloads, t.payload);
+}
+
+static
+void token_stream_free(Token_Stream* s)
+{
+    Heap_Allocator* heap = arr_header(s->str_literals)->heap;
+    if(s->literal_blocks)
+    {
+        for(msi i = 0; i < ARR_LEN(s->literal_blocks); ++i)
         {
-            result = 0;   
+            DYN_FREE(s->literal_blocks[i].data, heap);
         }
+        ARR_FREE(s->literal_blocks);
     }
-    
-    return result;
+    if(s->kinds)
+    {
+        ARR_FREE(s->kinds);
+        ARR_FREE(s->offsets);
+        ARR_FREE(s->lengths);
+        ARR_FREE(s->payloads);
+    }
+    //NOTE(Michael): numbers can be set up without the kinds array
+    if(s->numbers)
+    {
+        ARR_FREE(s->numbers);
+    }
+    ARR_FREE(s->str_literals);
+    DYN_FREE(s->literal_slots, heap);
+    *s = {};
+}
+
+inline
+String token_text(String file, Token t)
+{
+    return substring(file, t.offset, t.length);
 }
 
 static
@@ -154,11 +275,13 @@ String token_type_to_str(Token_Type t)
         case TOKEN_STRUCT: return IR_CONSTZ("struct");
         case TOKEN_CAST:   return IR_CONSTZ("cast");
         case TOKEN_BASIC_TYPE:    return IR_CONSTZ("basic type");
+        case TOKEN_INVALID:       return IR_CONSTZ("invalid character");
         case TOKEN_D_EQ:   return IR_CONSTZ("==");
         case TOKEN_AND:    return IR_CONSTZ("&&");
         case TOKEN_OR:     return IR_CONSTZ("||");
+        case TOKEN_NOTEQ:  return IR_CONSTZ("!=");
         case TOKEN_LEQ:  return IR_CONSTZ("<=");
-        case TOKEN_GEQ:  return IR_CONSTZ("!=");
+        case TOKEN_GEQ:  return IR_CONSTZ(">=");
         case TOKEN_D_PLUS:  return IR_CONSTZ("++");
         case TOKEN_D_MINUS:  return IR_CONSTZ("--");
         case TOKEN_PLUS_EQ:  return IR_CONSTZ("+=");
@@ -233,6 +356,25 @@ b8 data_type_is_floating_point(Type data)
     return false;
 }
 
+inline
+b8 data_type_is_number(Type data)
+{
+    return data >= TYPE_U8 && data <= TYPE_F64;
+}
+
+static
+String number_error_to_str(Number_Error e)
+{
+    switch(e)
+    {
+        case NUMBER_OK: return IR_CONSTZ("no error");
+        case NUMBER_ERROR_NO_DIGITS: return IR_CONSTZ("Expected digits after the number prefix!");
+        case NUMBER_ERROR_OVERFLOW: return IR_CONSTZ("Number constant does not fit into its type!");
+        case NUMBER_ERROR_INTEGER_SUFFIX_ON_FLOAT: return IR_CONSTZ("Floating point constant with an integer type suffix!");
+        default: return IR_CONSTZ("NUMBER ERROR PRINT NOT IMPLEMENTED");
+    }
+}
+
 inline
 u8 data_type_size(Type data)
 {
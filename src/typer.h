@@ -5,71 +5,58 @@
 #include "typer_table.h"
 
 
-String get_text_from_token_to_token(Token* t1, Token* t2)
+//NOTE(Michael): Grows t1 to cover t2 as long as both are on the same line
+void token_combine(AST* ast, Token* t1, Token t2)
 {
-    if(t1->line != t2->line)
+    msi begin = u64_min(t1->offset, t2.offset);
+    msi end = u64_max(t1->offset + t1->length, t2.offset + t2.length);
+    if(scan_to_end_of_line(ast->file.data, begin, end) != end)
     {
-        return t1->text;
+        return;
     }
     
-    if(t2->column < t1->column)
+    if(begin != t1->offset || end != t1->offset + t1->length)
     {
-        Token* tmp = t1;
-        t1 = t2;
-        t2 = tmp;
-    }
-    return substring(t1->line_text, t1->column-1-count_heading_whitespace_token_line(t1),
-                     t2->column+t2->text.length - t1->column);
-    
-}
-
-void token_combine(Token* t1, Token* t2)
-{
-    String str = get_text_from_token_to_token(t1, t2);
-    if(!cmp_string(t1->text, str))
-    {
-        t1->text = str;
+        t1->offset = begin;
+        t1->length = end - begin;
         t1->type = TOKEN_COMBINED;
-        t1->column = s64_min(t1->column, t2->column);
     }
-    
 }
 
-void typer_error(AST* ast, Node* node, c8* f_msg, ...)
+void typer_error(AST* ast, Node_Id node_id, c8* f_msg, ...)
 {
-    Token* t = node->info.token;
     ast->has_error = true;
-    if(ast_node_has_error_in_tree(node))
+    Node* node = ast_node(ast, node_id);
+    if(ast_node_has_error_in_tree(ast, node_id))
     {
         node->info.has_error = true;
         return;
     }
     node->info.has_error = true;
-    fprintf(stderr, "ERROR(%llu:%llu):\n", t->line, t->column);
+    Token_Location loc = token_location(&ast->lines, node->info.token);
+    fprintf(stderr, "ERROR(%llu:%llu):\n", loc.line, loc.column);
     va_list valist;
     va_start(valist, f_msg);
     vfprintf(stderr, f_msg, valist);
     va_end(valist);
-    fprintf(stderr, "\n%.*s", t->line_text);
-    msi heading_whitespace = count_heading_whitespace_token_line(t);
-    for(msi i = 1 ; i < t->column - heading_whitespace; ++i)
+    fprintf(stderr, "\n%.*s", loc.line_text);
+    for(msi i = 1 ; i < loc.column - loc.heading_whitespace; ++i)
     {
         fprintf(stderr, " ");   
     }
     fprintf(stderr, "^\n");
 }
 
-void typer_warning(AST* ast, Node* node, c8* f_msg, ...)
+void typer_warning(AST* ast, Node_Id node, c8* f_msg, ...)
 {
-    Token* t = node->info.token;
-    fprintf(stderr, "WARNING(%llu:%llu):\n", t->line, t->column);
+    Token_Location loc = token_location(&ast->lines, ast_node(ast, node)->info.token);
+    fprintf(stderr, "WARNING(%llu:%llu):\n", loc.line, loc.column);
     va_list valist;
     va_start(valist, f_msg);
     vfprintf(stderr, f_msg, valist);
     va_end(valist);
-    fprintf(stderr, "\n%.*s", t->line_text);
-    msi heading_whitespace = count_heading_whitespace_token_line(t);
-    for(msi i = 1 ; i < t->column - heading_whitespace; ++i)
+    fprintf(stderr, "\n%.*s", loc.line_text);
+    for(msi i = 1 ; i < loc.column - loc.heading_whitespace; ++i)
     {
         fprintf(stderr, " ");   
     }
@@ -77,8 +64,13 @@ void typer_warning(AST* ast, Node* node, c8* f_msg, ...)
 }
 
 #define T_CON_VAL(constant) (data_type_is_floating_point((constant).type) ? (constant).f_value : (constant).s_value)
-void typer_cast_const(Node* const_node, Type new_type, AST* ast)
+void typer_cast_const(Node_Id const_id, Type new_type, AST* ast)
 {
+    Node* const_node = ast_node(ast, const_id);
+    if(const_node->con.type == new_type)
+    {
+        return;
+    }
     
     switch(new_type)
     {
@@ -96,12 +88,12 @@ void typer_cast_const(Node* const_node, Type new_type, AST* ast)
         case TYPE_B8:{const_node->con.s_value = s64_abs((u8)T_CON_VAL(const_node->con));}break;
         case TYPE_VOID:
         {
-            typer_error(ast, const_node, "Cannot cast to void!");
+            typer_error(ast, const_id, "Cannot cast to void!");
             return;
         }
         default:
         {
-            typer_error(ast, const_node, "Cannot cast a literal to non number type!");
+            typer_error(ast, const_id, "Cannot cast a literal to non number type!");
             return;
         }
     }
@@ -109,9 +101,14 @@ void typer_cast_const(Node* const_node, Type new_type, AST* ast)
     const_node->con.type = new_type;
 }
 
-void typer_const_expr(Node* node, AST* ast)
+void typer_const_expr(Node_Id node_id, AST* ast)
 {
-    IR_ASSERT(node->children && node->children[0]->type == N_CONSTANT);
+    Node* node = ast_node(ast, node_id);
+    Node_Id first_id = node->first_child;
+    Node_Id second_id = first_id ? ast_next_sibling(ast, first_id) : AST_NO_NODE;
+    IR_ASSERT(first_id && ast_node(ast, first_id)->type == N_CONSTANT);
+    Node* first = ast_node(ast, first_id);
+    Node* second = second_id ? ast_node(ast, second_id) : nullptr;
     
     
     Expr_Op_Type optype = node->exp.type;
@@ -119,21 +116,22 @@ void typer_const_expr(Node* node, AST* ast)
     if(optype == EX_U_CAST)
     {
         Type cast_type = node->exp.result_type;
-        typer_cast_const(node->children[0], cast_type, ast);
+        typer_cast_const(first_id, cast_type, ast);
         
         node->type = N_CONSTANT;
         node->con.type = cast_type;
-        node->con.s_value = node->children[0]->con.s_value;
+        node->con.has_suffix = false;
+        node->con.s_value = first->con.s_value;
     }
     else
     {
-        if(data_type_is_floating_point(node->children[0]->con.type) ||
-           (ARR_LEN(node->children) == 2 && data_type_is_floating_point(node->children[1]->con.type)))
+        if(data_type_is_floating_point(first->con.type) ||
+           (second && data_type_is_floating_point(second->con.type)))
         {
             node->con.type = TYPE_F64;
             if((optype >= EX_B_MOD && optype <= EX_B_OR ) || optype == EX_U_BIN_INV)
             {
-                typer_error(ast, node, "'%.*s' Operation is invalid for floating point operants!", node->info.token->text);
+                typer_error(ast, node_id, "'%.*s' Operation is invalid for floating point operants!", token_text(ast, node->info.token));
                 return;
             }
         }
@@ -143,127 +141,128 @@ void typer_const_expr(Node* node, AST* ast)
         }
         
         node->type = N_CONSTANT;
+        node->con.has_suffix = false;
     }
     
     switch(optype)
     {
         case EX_B_ADD:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con)+T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)+T_CON_VAL(second->con);
         }else {
-            node->con.f_value = T_CON_VAL(node->children[0]->con)+T_CON_VAL(node->children[1]->con);
+            node->con.f_value = T_CON_VAL(first->con)+T_CON_VAL(second->con);
         }break;
         case EX_B_SUB:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con)-T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)-T_CON_VAL(second->con);
         }else {
-            node->con.f_value = T_CON_VAL(node->children[0]->con)-T_CON_VAL(node->children[1]->con);
+            node->con.f_value = T_CON_VAL(first->con)-T_CON_VAL(second->con);
         }break;
         case EX_B_MUL:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con)*T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)*T_CON_VAL(second->con);
         }else {
-            node->con.f_value = T_CON_VAL(node->children[0]->con)*T_CON_VAL(node->children[1]->con);
+            node->con.f_value = T_CON_VAL(first->con)*T_CON_VAL(second->con);
         }break;
         case EX_B_DIV:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con)/T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)/T_CON_VAL(second->con);
         }else {
-            node->con.f_value = T_CON_VAL(node->children[0]->con)/T_CON_VAL(node->children[1]->con);
+            node->con.f_value = T_CON_VAL(first->con)/T_CON_VAL(second->con);
         }break;
-        case EX_B_MOD:{node->con.s_value = node->children[0]->con.s_value % node->children[1]->con.s_value;}break;
-        case EX_B_SHIFTL:{node->con.s_value = node->children[0]->con.s_value << node->children[1]->con.s_value;}break;
-        case EX_B_SHIFTR:{node->con.s_value = node->children[0]->con.s_value >> node->children[1]->con.s_value;}break;
-        case EX_B_AND:{node->con.s_value = node->children[0]->con.s_value & node->children[1]->con.s_value;}break;
-        case EX_B_XOR:{node->con.s_value = node->children[0]->con.s_value ^ node->children[1]->con.s_value;}break;
-        case EX_B_OR:{node->con.s_value = node->children[0]->con.s_value | node->children[1]->con.s_value;}break;
+        case EX_B_MOD:{node->con.s_value = first->con.s_value % second->con.s_value;}break;
+        case EX_B_SHIFTL:{node->con.s_value = first->con.s_value << second->con.s_value;}break;
+        case EX_B_SHIFTR:{node->con.s_value = first->con.s_value >> second->con.s_value;}break;
+        case EX_B_AND:{node->con.s_value = first->con.s_value & second->con.s_value;}break;
+        case EX_B_XOR:{node->con.s_value = first->con.s_value ^ second->con.s_value;}break;
+        case EX_B_OR:{node->con.s_value = first->con.s_value | second->con.s_value;}break;
         case EX_C_OR:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con)||T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)||T_CON_VAL(second->con);
         }else {
-            node->con.s_value = T_CON_VAL(node->children[0]->con)||T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)||T_CON_VAL(second->con);
             node->con.type = TYPE_S64;
         }break;
         case EX_C_AND:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con)&&T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)&&T_CON_VAL(second->con);
         }else {
-            node->con.s_value = T_CON_VAL(node->children[0]->con)&&T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)&&T_CON_VAL(second->con);
             node->con.type = TYPE_S64;
         }break;;
         case EX_C_EQ:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con)==T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)==T_CON_VAL(second->con);
         }else {
-            node->con.s_value = T_CON_VAL(node->children[0]->con)==T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)==T_CON_VAL(second->con);
             node->con.type = TYPE_S64;
         }break;
         case EX_C_NEQ:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con)!=T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)!=T_CON_VAL(second->con);
         }else {
-            node->con.s_value = T_CON_VAL(node->children[0]->con)!=T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)!=T_CON_VAL(second->con);
             node->con.type = TYPE_S64;
         }break;
         case EX_C_LT:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con)<T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)<T_CON_VAL(second->con);
         }else {
-            node->con.s_value = T_CON_VAL(node->children[0]->con)<T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)<T_CON_VAL(second->con);
             node->con.type = TYPE_S64;
         }break;
         case EX_C_LTEQ:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con)<=T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)<=T_CON_VAL(second->con);
         }else {
-            node->con.s_value = T_CON_VAL(node->children[0]->con)<=T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)<=T_CON_VAL(second->con);
             node->con.type = TYPE_S64;
         }break;
         case EX_C_GT:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con)>T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)>T_CON_VAL(second->con);
         }else {
-            node->con.s_value = T_CON_VAL(node->children[0]->con)>T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)>T_CON_VAL(second->con);
             node->con.type = TYPE_S64;
         }break;
         case EX_C_GTEQ:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con)>=T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)>=T_CON_VAL(second->con);
         }else {
-            node->con.s_value = T_CON_VAL(node->children[0]->con)>=T_CON_VAL(node->children[1]->con);
+            node->con.s_value = T_CON_VAL(first->con)>=T_CON_VAL(second->con);
             node->con.type = TYPE_S64;
         }break;
         case EX_U_ADD:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = T_CON_VAL(node->children[0]->con);
+            node->con.s_value = T_CON_VAL(first->con);
         }else {
-            node->con.f_value = T_CON_VAL(node->children[0]->con);
+            node->con.f_value = T_CON_VAL(first->con);
         }break;
         case EX_U_SUB:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = -T_CON_VAL(node->children[0]->con);
+            node->con.s_value = -T_CON_VAL(first->con);
         }else {
-            node->con.f_value = -T_CON_VAL(node->children[0]->con);
+            node->con.f_value = -T_CON_VAL(first->con);
         }break;
         case EX_U_PREINC:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = ++node->children[0]->con.s_value;
+            node->con.s_value = ++first->con.s_value;
         }else {
-            node->con.f_value = ++node->children[0]->con.f_value;
+            node->con.f_value = ++first->con.f_value;
         }break;
         case EX_U_PREDEC:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = --node->children[0]->con.s_value;
+            node->con.s_value = --first->con.s_value;
         }else {
-            node->con.f_value = --node->children[0]->con.f_value;
+            node->con.f_value = --first->con.f_value;
         }break;
         case EX_U_LOGIC_INV:
         if(node->con.type == TYPE_S64){   
-            node->con.s_value = !node->children[0]->con.s_value;
+            node->con.s_value = !first->con.s_value;
         }else {
-            node->con.f_value = !node->children[0]->con.f_value;
+            node->con.f_value = !first->con.f_value;
         }break;
-        case EX_U_BIN_INV:{ node->con.s_value = ~node->children[0]->con.s_value;}break;
+        case EX_U_BIN_INV:{ node->con.s_value = ~first->con.s_value;}break;
         
         case EX_U_CAST:
         {
@@ -273,21 +272,24 @@ void typer_const_expr(Node* node, AST* ast)
         case EX_UNKNOWN:
         default:
         {     
-            typer_error(ast, node, "Unknown Subexpression type in typing stage found!");
+            typer_error(ast, node_id, "Unknown Subexpression type in typing stage found!");
             break;   
         }
     }
     
-    while(Node* child = (ARR_LEN(node->children) ? ARR_LAST(node->children) : nullptr))
+    //NOTE(Michael): Last child first, the order they were always combined in
+    if(second)
     {
-        token_combine(node->info.token, child->info.token);
-        ast_remove_node(child, ast);
+        token_combine(ast, &node->info.token, second->info.token);
     }
+    token_combine(ast, &node->info.token, first->info.token);
+    ast_remove_children(node_id, ast);
 }
 #undef T_CON_VAL
 
-void typer_expr(Node* node, AST* ast)
+void typer_expr(Node_Id node_id, AST* ast)
 {
+    Node* node = ast_node(ast, node_id);
     switch(node->exp.type)
     {
         
@@ -310,19 +312,20 @@ void typer_expr(Node* node, AST* ast)
         case EX_C_GT:
         case EX_C_GTEQ:
         {
-            if(ARR_LEN(node->children) != 2)
+            msi child_count = ast_child_count(ast, node_id);
+            if(child_count != 2)
             {
-                typer_error(ast, node, "Binary operator has != 2 operants!: %llu", ARR_LEN(node->children));
+                typer_error(ast, node_id, "Binary operator has != 2 operants!: %llu", child_count);
                 return;
             }
             
             u8 promote_side = 0;
-            Node* left_node = node->children[0];
-            Node* right_node = node->children[1];
+            Node* left_node = ast_node(ast, ast_child(ast, node_id, 0));
+            Node* right_node = ast_node(ast, ast_child(ast, node_id, 1));
             
             if(left_node->type == N_CONSTANT && right_node->type == N_CONSTANT)
             {
-                typer_const_expr(node, ast);
+                typer_const_expr(node_id, ast);
                 break;   
             }
             
@@ -357,26 +360,26 @@ void typer_expr(Node* node, AST* ast)
             }
             
             node->exp.result_type =
-                typer_binary_operation_result(ast, node, node->exp.type, left_type, right_type, &promote_side);
+                typer_binary_operation_result(ast, node_id, node->exp.type, left_type, right_type, &promote_side);
             
             
             if(promote_side == 1)
             {
-                Node* cast_node = ast_create_node(left_node->scope, left_node->info.token, ast);
-                cast_node->type = N_EXPR;
+                Node_Id cast_id = ast_create_node(N_EXPR, left_node->info.token, ast);
+                Node* cast_node = ast_node(ast, cast_id);
                 cast_node->exp.result_type = right_type;
                 cast_node->exp.type = EX_U_CAST;
                 cast_node->info.implicit =true;
-                ast_insert_between(node, 0, cast_node, ast);
+                ast_insert_between(node_id, 0, cast_id, ast);
             }
             else if(promote_side == 2)
             {
-                Node* cast_node = ast_create_node(right_node->scope, right_node->info.token, ast);
-                cast_node->type = N_EXPR;
+                Node_Id cast_id = ast_create_node(N_EXPR, right_node->info.token, ast);
+                Node* cast_node = ast_node(ast, cast_id);
                 cast_node->exp.result_type = left_type;
                 cast_node->exp.type = EX_U_CAST;
                 cast_node->info.implicit =true;
-                ast_insert_between(node, 1, cast_node, ast);
+                ast_insert_between(node_id, 1, cast_id, ast);
             }     
             
             break;   
@@ -388,24 +391,25 @@ void typer_expr(Node* node, AST* ast)
         case EX_U_LOGIC_INV:
         case EX_U_BIN_INV:
         {
-            if(ARR_LEN(node->children) != 1)
+            msi child_count = ast_child_count(ast, node_id);
+            if(child_count != 1)
             {
-                typer_error(ast, node, "Unary operator has != 1 operants!: %llu", ARR_LEN(node->children));
+                typer_error(ast, node_id, "Unary operator has != 1 operants!: %llu", child_count);
                 return;
             }
             
-            Node* operant_node = node->children[0];
+            Node* operant_node = ast_node(ast, node->first_child);
             
             if(operant_node->type == N_CONSTANT)
             {
-                typer_const_expr(node, ast);
+                typer_const_expr(node_id, ast);
                 break;
             }
             
             if(operant_node->type == N_VAR)
             {
                 node->exp.result_type = operant_node->var->type;
-                token_combine(node->info.token, operant_node->info.token);
+                token_combine(ast, &node->info.token, operant_node->info.token);
             }
             else
             {
@@ -416,16 +420,17 @@ void typer_expr(Node* node, AST* ast)
         }
         case EX_U_CAST:
         {
-            if(ARR_LEN(node->children) != 1)
+            msi child_count = ast_child_count(ast, node_id);
+            if(child_count != 1)
             {
-                typer_error(ast, node, "Cast operator has != 1 operants!: %llu", ARR_LEN(node->children));
+                typer_error(ast, node_id, "Cast operator has != 1 operants!: %llu", child_count);
                 return;
             }
             
-            Node* operant_node = node->children[0];
+            Node* operant_node = ast_node(ast, node->first_child);
             if(operant_node->type == N_CONSTANT)
             {
-                typer_const_expr(node, ast);
+                typer_const_expr(node_id, ast);
                 break;
             }
             
@@ -436,34 +441,29 @@ void typer_expr(Node* node, AST* ast)
         case EX_UNKNOWN:
         default:
         {     
-            typer_error(ast, node, "Unknown Subexpression type in typing stage found!");
+            typer_error(ast, node_id, "Unknown Subexpression type in typing stage found!");
             break;   
         }
     }
 }
 
-void typer_depth_first(Node* node, AST* ast)
+//Types one node, its children are typed already
+void typer_node(Node_Id node_id, AST* ast)
 {
-    if(node->children)
-    {
-        for(msi i = 0; i < ARR_LEN(node->children); ++i)
-        {
-            typer_depth_first(node->children[i], ast);
-        }
-    }
-    
+    Node* node = ast_node(ast, node_id);
     switch(node->type)
     {
         case N_EXPR:
         {
-            typer_expr(node, ast);
+            typer_expr(node_id, ast);
             break;   
         }
         case N_ASSIGN:
         {
-            IR_ASSERT(ARR_LEN(node->children) == 2);
-            Node* left = node->children[0];
-            Node* right = node->children[1];
+            IR_ASSERT(ast_child_count(ast, node_id) == 2);
+            Node_Id right_id = ast_child(ast, node_id, 1);
+            Node* left = ast_node(ast, node->first_child);
+            Node* right = ast_node(ast, right_id);
             IR_ASSERT(left->type == N_VAR || left->type == N_VAR_DECL);
             Type lt = left->var->type;
             Type rt = TYPE_UNKNOWN;
@@ -474,9 +474,9 @@ void typer_depth_first(Node* node, AST* ast)
                 case N_CONSTANT: 
                 { 
                     rt = right->con.type;
-                    if(left->var->type != rt)
+                    if(left->var->type != rt && !right->con.has_suffix)
                     {
-                        typer_cast_const(right, left->var->type, ast);
+                        typer_cast_const(right_id, left->var->type, ast);
                         rt = right->con.type;
                     }
                 } break;
@@ -512,32 +512,32 @@ void typer_depth_first(Node* node, AST* ast)
                 
                 if((lt_is_signed || lt_is_unsigned) && rt_is_floating_point)
                 {
-                    typer_error(ast, node, 
+                    typer_error(ast, node_id, 
                                 "Trying to implicitly cast a floating point type to an integer type is not allowed!\n"
                                 "Try casting it explictly with cast(%.*s)%.*s",
                                 IR_EXP_STR(data_type_to_str(lt)),
-                                IR_EXP_STR(node->children[1]->info.token->text));
+                                IR_EXP_STR(token_text(ast, right->info.token)));
                     break;
                 }
                 else if((rt_is_signed || rt_is_unsigned) && lt_is_floating_point)
                 {
-                    typer_error(ast, node, 
+                    typer_error(ast, node_id, 
                                 "Trying to implicitly cast an integer type to a floating point type is not allowed!\n"
                                 "Try casting it explictly with cast(%.*s)%.*s",
                                 IR_EXP_STR(data_type_to_str(lt)),
-                                IR_EXP_STR(node->children[1]->info.token->text));
+                                IR_EXP_STR(token_text(ast, right->info.token)));
                     break;
                 }
                 else if((lt_is_signed && rt_is_signed) ||
                         (lt_is_unsigned && rt_is_unsigned) ||
                         (lt_is_floating_point && rt_is_floating_point))
                 {
-                    Node* cast_node = ast_create_node(node->scope, node->info.token, ast);
-                    cast_node->type = N_EXPR;
+                    Node_Id cast_id = ast_create_node(N_EXPR, node->info.token, ast);
+                    Node* cast_node = ast_node(ast, cast_id);
                     cast_node->exp.result_type = lt;
                     cast_node->exp.type = EX_U_CAST;
                     cast_node->info.implicit =true;
-                    ast_insert_between(node, 1, cast_node, ast);
+                    ast_insert_between(node_id, 1, cast_id, ast);
                     break;
                 }  
             }
@@ -552,6 +552,16 @@ void typer_depth_first(Node* node, AST* ast)
     };   
 }
 
+void typer_depth_first(Node_Id node_id, AST* ast)
+{
+    AST_Walk walk = ast_walk_begin(ast, node_id, AST_WALK_POST);
+    while(ast_walk_next(&walk))
+    {
+        typer_node(walk.node, ast);
+    }
+    ast_walk_end(&walk);
+}
+
 void typer(AST* ast)
 {
     typer_depth_first(ast->root, ast);
@@ -3,9 +3,9 @@
 
 #include "ast.h"
 
-void typer_error(AST* ast, Node* node, c8* f_msg, ...);
-void typer_warning(AST* ast, Node* node, c8* f_msg, ...);
-Type typer_binary_operation_result(AST* ast, Node* node, Expr_Op_Type op_type, Type o1, Type o2, u8* promote_side)
+void typer_error(AST* ast, Node_Id node, c8* f_msg, ...);
+void typer_warning(AST* ast, Node_Id node, c8* f_msg, ...);
+Type typer_binary_operation_result(AST* ast, Node_Id node, Expr_Op_Type op_type, Type o1, Type o2, u8* promote_side)
 {   
     if(!(o1 != TYPE_UNKNOWN && o1 < TYPE_VOID && o2 != TYPE_UNKNOWN && o2 < TYPE_VOID))
     {
@@ -56,7 +56,7 @@ Type typer_binary_operation_result(AST* ast, Node* node, Expr_Op_Type op_type, T
                     "Trying to implicitly cast an integer type to a floating point type is not allowed!\n"
                     "Try casting it explictly with cast(%.*s)%.*s",
                     IR_EXP_STR(data_type_to_str(o2)),
-                    IR_EXP_STR(node->children[0]->info.token->text));
+                    IR_EXP_STR(token_text(ast, ast_node(ast, ast_child(ast, node, 0))->info.token)));
         return TYPE_UNKNOWN;
             
     }
@@ -66,7 +66,7 @@ Type typer_binary_operation_result(AST* ast, Node* node, Expr_Op_Type op_type, T
                     "Trying to implicitly cast an integer type to a floating point type is not allowed!\n"
                     "Try casting it explictly with cast(%.*s)%.*s",
                     IR_EXP_STR(data_type_to_str(o1)),
-                    IR_EXP_STR(node->children[1]->info.token->text));
+                    IR_EXP_STR(token_text(ast, ast_node(ast, ast_child(ast, node, 1))->info.token)));
         return TYPE_UNKNOWN;
     }
     
@@ -117,7 +117,7 @@ Type typer_binary_operation_result(AST* ast, Node* node, Expr_Op_Type op_type, T
                             *promote_side = 2;
                         typer_warning(ast, node, "Signed type is smaller in size than the unsigned type in operation!\n"
                                       "cast '%.*s' to '%.*s' to supress this warning.",
-                                      node->children[1]->info.token->text, data_type_to_str(o1));
+                                      token_text(ast, ast_node(ast, ast_child(ast, node, 1))->info.token), data_type_to_str(o1));
                         return o1;
                     }
                 }
@@ -135,7 +135,7 @@ Type typer_binary_operation_result(AST* ast, Node* node, Expr_Op_Type op_type, T
                             *promote_side = 1;
                         typer_warning(ast, node, "Signed type is smaller in size than the unsigned type in operation!\n"
                                       "cast '%.*s' to '%.*s' to supress this warning.",
-                                      node->children[0]->info.token->text, data_type_to_str(o2));
+                                      token_text(ast, ast_node(ast, ast_child(ast, node, 0))->info.token), data_type_to_str(o2));
                         return o2;
                     }
                 }
@@ -187,7 +187,7 @@ Type typer_binary_operation_result(AST* ast, Node* node, Expr_Op_Type op_type, T
                             *promote_side = 2;
                         typer_warning(ast, node, "Signed type is smaller in size than the unsigned type in operation!\n"
                                       "cast '%.*s' to '%.*s' to supress this warning.",
-                                      node->children[1]->info.token->text, data_type_to_str(o1));
+                                      token_text(ast, ast_node(ast, ast_child(ast, node, 1))->info.token), data_type_to_str(o1));
                         return TYPE_B8;
                     }
                 }
@@ -205,7 +205,7 @@ Type typer_binary_operation_result(AST* ast, Node* node, Expr_Op_Type op_type, T
                             *promote_side = 1;
                         typer_warning(ast, node, "Signed type is smaller in size than the unsigned type in operation!\n"
                                       "cast '%.*s' to '%.*s' to supress this warning.",
-                                      node->children[0]->info.token->text, data_type_to_str(o2));
+                                      token_text(ast, ast_node(ast, ast_child(ast, node, 0))->info.token), data_type_to_str(o2));
                         return TYPE_B8;
                     }
                 }